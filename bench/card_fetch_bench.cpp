@@ -0,0 +1,193 @@
+// Compares the bytes per card and the parse time of the card FETCH shapes:
+// the former ENVELOPE + BODY[HEADER] fetch parsed with regular expressions,
+// ENVELOPE only, and BODY.PEEK[HEADER.FIELDS (FROM TO SUBJECT DATE)].
+//
+// Usage: bench-card-fetch [messages]
+
+#include "core/imap_client.h"
+#include "core/imap_response_parser.h"
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+enum class Shape {
+    LegacyHeaders,
+    Envelope,
+    HeaderFields
+};
+
+QByteArray envelope(int i) {
+    const QByteArray sender = "sender" + QByteArray::number(i % 50);
+    return "ENVELOPE (\"Mon, 01 Jan 2024 12:00:00 +0000\" \"Card number " + QByteArray::number(i)
+         + " (with {braces} and \\\"quotes\\\")\" ((\"Sender " + QByteArray::number(i % 50) + "\" NIL \""
+         + sender + "\" \"example.com\")) ((\"Sender " + QByteArray::number(i % 50) + "\" NIL \"" + sender
+         + "\" \"example.com\")) ((\"Sender " + QByteArray::number(i % 50) + "\" NIL \"" + sender
+         + "\" \"example.com\")) ((NIL NIL \"board\" \"example.com\")) NIL NIL NIL \"<"
+         + QByteArray::number(i) + "@example.com>\")";
+}
+
+// A typical header block of delivered mail: routing, authentication and
+// list headers dominate; the four fields a card shows are a small part
+QByteArray fullHeaders(int i) {
+    const QByteArray n = QByteArray::number(i);
+    const QByteArray sender = "sender" + QByteArray::number(i % 50);
+    return "Return-Path: <" + sender + "@example.com>\r\n"
+           "Delivered-To: board@example.com\r\n"
+           "Received: from mx1.example.com (mx1.example.com [192.0.2.10])\r\n"
+           "\tby mail.example.com (Postfix) with ESMTPS id 4T1" + n + "\r\n"
+           "\tfor <board@example.com>; Mon, 01 Jan 2024 12:00:01 +0000 (UTC)\r\n"
+           "Received: from outbound.example.org (outbound.example.org [198.51.100.7])\r\n"
+           "\tby mx1.example.com with ESMTPS id 9a" + n + "\r\n"
+           "\tfor <board@example.com>; Mon, 01 Jan 2024 12:00:00 +0000\r\n"
+           "DKIM-Signature: v=1; a=rsa-sha256; c=relaxed/relaxed; d=example.com; s=mail;\r\n"
+           "\tt=1704110400; bh=47DEQpj8HBSa+/TImW+5JCeuQeRkm5NMpJWZG3hSuFU=;\r\n"
+           "\th=From:To:Subject:Date:Message-ID;\r\n"
+           "\tb=dGhpcyBpcyBub3QgYSByZWFsIHNpZ25hdHVyZSBidXQgaXQgaGFzIHRoZSByaWdodCBzaXpl\r\n"
+           "\t IGZvciBhIGJlbmNobWFyayBvZiBoZWFkZXIgdHJhbnNmZXIgY29zdHMgaW4gSU1BUCBjbGllbnRz\r\n"
+           "Authentication-Results: mx1.example.com; dkim=pass header.d=example.com;\r\n"
+           "\tspf=pass smtp.mailfrom=" + sender + "@example.com; dmarc=pass\r\n"
+           "From: Sender " + QByteArray::number(i % 50) + " <" + sender + "@example.com>\r\n"
+           "To: board@example.com\r\n"
+           "Subject: Card number " + n + " (with {braces} and \"quotes\")\r\n"
+           "Date: Mon, 01 Jan 2024 12:00:00 +0000\r\n"
+           "Message-ID: <" + n + "@example.com>\r\n"
+           "MIME-Version: 1.0\r\n"
+           "Content-Type: text/plain; charset=utf-8\r\n"
+           "Content-Transfer-Encoding: quoted-printable\r\n"
+           "List-Id: Board notifications <board.example.com>\r\n"
+           "List-Unsubscribe: <mailto:unsubscribe@example.com>\r\n"
+           "\r\n";
+}
+
+QByteArray headerFields(int i) {
+    const QByteArray sender = "sender" + QByteArray::number(i % 50);
+    return "From: Sender " + QByteArray::number(i % 50) + " <" + sender + "@example.com>\r\n"
+           "To: board@example.com\r\n"
+           "Subject: Card number " + QByteArray::number(i) + " (with {braces} and \"quotes\")\r\n"
+           "Date: Mon, 01 Jan 2024 12:00:00 +0000\r\n"
+           "\r\n";
+}
+
+QByteArray buildFetchResponse(Shape shape, int messages) {
+    QByteArray data;
+    for (int i = 1; i <= messages; ++i) {
+        data += "* " + QByteArray::number(i) + " FETCH (UID " + QByteArray::number(i + 1000)
+              + " FLAGS (\\Seen $Label1) ";
+        if (shape == Shape::LegacyHeaders) {
+            const QByteArray headers = fullHeaders(i);
+            data += envelope(i) + " BODY[HEADER] {" + QByteArray::number(headers.size()) + "}\r\n" + headers;
+        } else if (shape == Shape::Envelope) {
+            data += "INTERNALDATE \"01-Jan-2024 12:00:00 +0000\" RFC822.SIZE 4096 " + envelope(i);
+        } else {
+            const QByteArray headers = headerFields(i);
+            data += "INTERNALDATE \"01-Jan-2024 12:00:00 +0000\" RFC822.SIZE 4096 "
+                    "BODY[HEADER.FIELDS (FROM TO SUBJECT DATE)] {" + QByteArray::number(headers.size())
+                  + "}\r\n" + headers;
+        }
+        data += ")\r\n";
+    }
+    data += "A0001 OK Fetch completed.\r\n";
+    return data;
+}
+
+// The card parsing that ENVELOPE replaced, kept here as the baseline
+QString extractHeaderValue(const QString& headers, const QString& headerName) {
+    QRegularExpression re(QString("^%1:\\s*(.+)$").arg(headerName),
+                          QRegularExpression::MultilineOption | QRegularExpression::CaseInsensitiveOption);
+    QRegularExpressionMatch match = re.match(headers);
+    return match.hasMatch() ? match.captured(1).trimmed() : QString();
+}
+
+QList<EmailCard> parseLegacy(const QList<ImapResponse>& responses) {
+    QList<EmailCard> cards;
+    for (const ImapResponse& response : responses) {
+        const ImapValue& data = response.fields.at(0);
+        const QString headers = data.value("BODY[HEADER]").toString();
+        EmailCard card;
+        card.setUid(data.value("UID").toString());
+        card.setSubject(extractHeaderValue(headers, "Subject"));
+        card.setFrom(extractHeaderValue(headers, "From"));
+        card.setTo(extractHeaderValue(headers, "To"));
+        card.setDate(QDateTime::fromString(extractHeaderValue(headers, "Date"), Qt::RFC2822Date));
+        cards.append(card);
+    }
+    return cards;
+}
+
+struct RunResult {
+    qint64 bytes = 0;
+    double tokenizeMs = 0;
+    double cardsMs = 0;
+    int cards = 0;
+};
+
+RunResult run(Shape shape, int messages) {
+    RunResult result;
+    const QByteArray data = buildFetchResponse(shape, messages);
+    result.bytes = data.size();
+
+    ImapResponseParser parser;
+    ImapResponse response;
+    QList<ImapResponse> responses;
+
+    QElapsedTimer timer;
+    timer.start();
+    parser.feed(data);
+    while (parser.next(response)) {
+        if (response.name == "FETCH") {
+            responses.append(response);
+        }
+    }
+    result.tokenizeMs = timer.nsecsElapsed() / 1e6;
+
+    timer.restart();
+    const QList<EmailCard> cards = shape == Shape::LegacyHeaders ? parseLegacy(responses)
+                                                                 : ImapClient::parseFetchResponses(responses);
+    result.cardsMs = timer.nsecsElapsed() / 1e6;
+    for (const EmailCard& card : cards) {
+        if (!card.subject().isEmpty() && !card.from().isEmpty()) {
+            ++result.cards;
+        }
+    }
+    return result;
+}
+
+void printRun(const char* label, const RunResult& result, int messages) {
+    std::cout << std::left << std::setw(34) << label << std::right
+              << std::setw(8) << result.bytes / messages << " B/card"
+              << std::setw(10) << std::fixed << std::setprecision(1) << result.tokenizeMs << " ms tokenize"
+              << std::setw(10) << result.cardsMs << " ms cards"
+              << std::setw(9) << std::setprecision(2) << (result.tokenizeMs + result.cardsMs) * 1000.0 / messages
+              << " us/card"
+              << (result.cards == messages ? "" : " [INCOMPLETE]") << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int messages = argc > 1 ? QByteArray(argv[1]).toInt() : 20000;
+    if (messages <= 0) {
+        std::cerr << "Usage: bench-card-fetch [messages]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Messages:       " << messages << std::endl;
+
+    RunResult legacy = run(Shape::LegacyHeaders, messages);
+    RunResult envelopeOnly = run(Shape::Envelope, messages);
+    RunResult fields = run(Shape::HeaderFields, messages);
+
+    printRun("ENVELOPE + BODY[HEADER] (regex)", legacy, messages);
+    printRun("ENVELOPE", envelopeOnly, messages);
+    printRun("BODY.PEEK[HEADER.FIELDS (...)]", fields, messages);
+
+    std::cout << "Bytes saved:    " << std::setprecision(0)
+              << 100.0 * (legacy.bytes - envelopeOnly.bytes) / legacy.bytes << "% with ENVELOPE" << std::endl;
+
+    bool complete = legacy.cards == messages && envelopeOnly.cards == messages && fields.cards == messages;
+    return complete ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+// Measures the memory a board needs per card: the former EmailCard layout
+// (QString UID, QStringList flags, QDateTime and two bools) against the
+// compact one. Heap usage is read from glibc's allocator statistics.
+//
+// Usage: bench-card-memory [cards]
+
+#include "core/email_card.h"
+#include <QByteArray>
+#include <QList>
+#include <QTimeZone>
+#include <iomanip>
+#include <iostream>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAVE_MALLINFO2 1
+#endif
+
+namespace {
+
+// The card layout the compact EmailCard replaced, kept here as the baseline
+struct LegacyCard {
+    QString uid;
+    QString subject;
+    QString from;
+    QString to;
+    QDateTime date;
+    QString body;
+    qint64 size = 0;
+    QStringList flags;
+    bool read = false;
+    bool flagged = false;
+};
+
+qint64 heapInUse() {
+#ifdef HAVE_MALLINFO2
+    return qint64(mallinfo2().uordblks);
+#else
+    return -1;
+#endif
+}
+
+// The values a FETCH parse produces for card i: every string is a fresh
+// allocation, as it is when decoded from a server response
+struct CardData {
+    QString uid;
+    QString subject;
+    QString from;
+    QString to;
+    QDateTime date;
+    QStringList flags;
+};
+
+CardData cardData(int i) {
+    CardData data;
+    data.uid = QString::number(i + 1000);
+    data.subject = QString("Card number %1").arg(i);
+    data.from = QString("Sender %1 <sender%1@example.com>").arg(i % 50);
+    data.to = QString("board@example.com");
+    data.date = QDateTime(QDate(2024, 1, 1), QTime(12, 0), QTimeZone(3600)).addSecs(i);
+    data.flags << QString("\\Seen") << QString("$Label%1").arg(i % 4);
+    if (i % 10 == 0) {
+        data.flags << QString("\\Flagged");
+    }
+    return data;
+}
+
+template <typename Card, typename Fill>
+qint64 measure(int count, Fill fill) {
+    QList<Card> cards;
+    qint64 before = heapInUse();
+    cards.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        Card card;
+        fill(card, cardData(i));
+        cards.append(card);
+    }
+    qint64 after = heapInUse();
+    return before < 0 ? -1 : after - before;
+}
+
+void printRun(const char* label, size_t inlineBytes, qint64 heapBytes, int count) {
+    std::cout << std::left << std::setw(10) << label << std::right
+              << std::setw(6) << inlineBytes << " B inline";
+    if (heapBytes >= 0) {
+        std::cout << std::setw(8) << heapBytes / count << " B/card total"
+                  << std::setw(10) << std::fixed << std::setprecision(1) << heapBytes / (1024.0 * 1024.0)
+                  << " MiB";
+    } else {
+        std::cout << "  (heap statistics unavailable)";
+    }
+    std::cout << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? QByteArray(argv[1]).toInt() : 100000;
+    if (count <= 0) {
+        std::cerr << "Usage: bench-card-memory [cards]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Cards:          " << count << std::endl;
+
+    qint64 legacy = measure<LegacyCard>(count, [](LegacyCard& card, const CardData& data) {
+        card.uid = data.uid;
+        card.subject = data.subject;
+        card.from = data.from;
+        card.to = data.to;
+        card.date = data.date;
+        card.size = 4096;
+        card.flags = data.flags;
+        card.read = data.flags.contains("\\Seen");
+        card.flagged = data.flags.contains("\\Flagged");
+    });
+    qint64 compact = measure<EmailCard>(count, [](EmailCard& card, const CardData& data) {
+        card.setUid(data.uid);
+        card.setSubject(data.subject);
+        card.setFrom(data.from);
+        card.setTo(data.to);
+        card.setDate(data.date);
+        card.setSize(4096);
+        card.setFlags(data.flags);
+    });
+
+    printRun("legacy", sizeof(LegacyCard), legacy, count);
+    printRun("compact", sizeof(EmailCard), compact, count);
+
+    if (legacy > 0 && compact >= 0) {
+        std::cout << "Memory saved:   " << std::setprecision(0)
+                  << 100.0 * (legacy - compact) / legacy << "%" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,173 @@
+// Measures how long the event loop of the calling (GUI) thread is held up
+// while every column is refreshed, with the IMAP connections on that thread
+// and on the worker thread. The local server runs on a thread of its own.
+//
+// Usage: bench-event-loop [mailboxes] [messages-per-mailbox] [latency-ms]
+
+#include "core/event_loop_monitor.h"
+#include "core/imap_worker.h"
+#include "core/mailbox_list.h"
+#include "core/settings.h"
+#include "fake_imap_server.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+#include <atomic>
+#include <functional>
+#include <iostream>
+
+namespace {
+
+// Spin the event loop until done() returns true or the deadline passes
+bool waitFor(const std::function<bool()>& done, int timeoutMs = 120000) {
+    QElapsedTimer timer;
+    timer.start();
+    while (!done()) {
+        if (timer.elapsed() > timeoutMs) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    return true;
+}
+
+struct RunResult {
+    bool ok = false;
+    qint64 elapsedMs = 0;
+    int cards = 0;
+    double averageLagMs = 0;
+    double p99LagMs = 0;
+    double maxLagMs = 0;
+};
+
+RunResult runRefresh(quint16 port, const QStringList& mailboxes, int messages, bool threaded) {
+    RunResult run;
+
+    Settings settings;
+    settings.setImapServer("127.0.0.1");
+    settings.setImapPort(port);
+    settings.setUseSSL(false);
+    settings.setCardWindow(messages);
+
+    // A fresh pool each run, so every mailbox gets a full sync
+    ImapWorker worker(threaded);
+    std::atomic<bool> authenticated(false);
+    std::atomic<bool> failed(false);
+    ImapClient* client = worker.pool()->interactive();
+    QObject::connect(client, &ImapClient::authenticated, client, [&authenticated]() { authenticated = true; },
+                     Qt::DirectConnection);
+    QObject::connect(client, &ImapClient::error, client, [&failed]() { failed = true; }, Qt::DirectConnection);
+    QObject::connect(client, &ImapClient::connected, client, [client]() { client->authenticate("user", "pass"); },
+                     Qt::DirectConnection);
+    worker.post([settings](ImapConnectionPool* pool) {
+        pool->open(settings);
+    });
+    if (!waitFor([&]() { return authenticated || failed; }) || !authenticated) {
+        std::cerr << "Failed to connect" << std::endl;
+        return run;
+    }
+
+    // Results are applied here, as KanbanModel does on the GUI thread
+    QHash<QString, MailboxList> lists;
+    int pending = mailboxes.size();
+    run.ok = true;
+
+    EventLoopMonitor monitor;
+    monitor.start();
+    QElapsedTimer timer;
+    timer.start();
+    for (const QString& mailbox : mailboxes) {
+        auto finished = worker.reply<bool, MailboxChanges>([&, mailbox](bool ok, const MailboxChanges& changes) {
+            MailboxList list(mailbox);
+            list.setCards(changes.cards);
+            lists.insert(mailbox, list);
+            run.ok = run.ok && ok;
+            run.cards += list.cardCount();
+            --pending;
+        });
+        worker.post([mailbox, finished](ImapConnectionPool* pool) {
+            pool->acquire(mailbox, [mailbox, finished](ImapClient* client) {
+                if (client) {
+                    client->syncCards(mailbox, finished);
+                } else {
+                    finished(false, MailboxChanges());
+                }
+            });
+        });
+    }
+    run.ok = waitFor([&pending]() { return pending == 0; }) && run.ok;
+    run.elapsedMs = timer.elapsed();
+    monitor.stop();
+
+    run.averageLagMs = monitor.averageLagMs();
+    run.p99LagMs = monitor.percentileLagMs(0.99);
+    run.maxLagMs = monitor.maxLagMs();
+
+    worker.post([](ImapConnectionPool* pool) {
+        pool->close();
+    });
+    return run;
+}
+
+void printRun(const char* label, const RunResult& run) {
+    std::cout << label << run.elapsedMs << " ms, " << run.cards << " cards, event loop lag avg "
+              << run.averageLagMs << " ms, p99 " << run.p99LagMs << " ms, max " << run.maxLagMs << " ms"
+              << (run.ok ? "" : " [FAILED]") << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    int mailboxCount = args.size() > 1 ? args.at(1).toInt() : 8;
+    int messages = args.size() > 2 ? args.at(2).toInt() : 2000;
+    int latencyMs = args.size() > 3 ? args.at(3).toInt() : 0;
+    if (mailboxCount <= 0 || messages <= 0 || latencyMs < 0) {
+        std::cerr << "Usage: bench-event-loop [mailboxes] [messages-per-mailbox] [latency-ms]" << std::endl;
+        return 1;
+    }
+
+    QStringList mailboxes;
+    for (int i = 0; i < mailboxCount; ++i) {
+        mailboxes.append(QString("List%1").arg(i + 1));
+    }
+
+    // The server gets a thread of its own, so that only the client side
+    // competes with the monitored event loop
+    std::atomic<int> port(-1);
+    QThread* serverThread = QThread::create([&]() {
+        FakeImapServer server(latencyMs);
+        for (const QString& mailbox : mailboxes) {
+            server.addMailbox(mailbox, messages);
+        }
+        port = server.listen() ? server.port() : 0;
+        QEventLoop loop;
+        loop.exec();
+    });
+    serverThread->start();
+    while (port < 0) {
+        QThread::msleep(1);
+    }
+    if (port == 0) {
+        std::cerr << "Failed to start fake IMAP server" << std::endl;
+        serverThread->quit();
+        serverThread->wait();
+        return 1;
+    }
+
+    std::cout << "Mailboxes:      " << mailboxCount << " x " << messages << " messages" << std::endl;
+
+    RunResult sameThread = runRefresh(quint16(port), mailboxes, messages, false);
+    printRun("GUI thread:     ", sameThread);
+
+    RunResult threaded = runRefresh(quint16(port), mailboxes, messages, true);
+    printRun("Worker thread:  ", threaded);
+
+    serverThread->quit();
+    serverThread->wait();
+    delete serverThread;
+
+    return sameThread.ok && threaded.ok ? 0 : 1;
+}
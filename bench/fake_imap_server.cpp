@@ -0,0 +1,214 @@
+#include "fake_imap_server.h"
+#include <QTimer>
+
+namespace {
+
+QList<int> resolveRange(const QByteArray& range, int messages) {
+    QList<int> result;
+    for (const QByteArray& part : range.split(',')) {
+        QList<QByteArray> bounds = part.split(':');
+        int first = bounds.first() == "*" ? messages : bounds.first().toInt();
+        int last = first;
+        if (bounds.size() > 1) {
+            last = bounds.last() == "*" ? messages : bounds.last().toInt();
+        }
+        if (first > last) {
+            qSwap(first, last);
+        }
+        for (int i = qMax(1, first); i <= qMin(last, messages); ++i) {
+            result.append(i);
+        }
+    }
+    return result;
+}
+
+QByteArray unquote(const QByteArray& value) {
+    if (value.size() >= 2 && value.startsWith('"') && value.endsWith('"')) {
+        return value.mid(1, value.size() - 2);
+    }
+    return value;
+}
+
+} // namespace
+
+FakeImapServer::FakeImapServer(int latencyMs)
+    : m_latencyMs(latencyMs)
+    , m_commandCount(0)
+    , m_bytesSent(0)
+{
+    QObject::connect(&m_server, &QTcpServer::newConnection, [this]() { onNewConnection(); });
+}
+
+FakeImapServer::~FakeImapServer() {
+    m_server.close();
+}
+
+bool FakeImapServer::listen() {
+    return m_server.listen(QHostAddress::LocalHost, 0);
+}
+
+quint16 FakeImapServer::port() const {
+    return m_server.serverPort();
+}
+
+void FakeImapServer::setLatency(int latencyMs) {
+    m_latencyMs = latencyMs;
+}
+
+void FakeImapServer::addMailbox(const QString& name, int messages) {
+    m_mailboxes[name] = messages;
+}
+
+int FakeImapServer::commandCount() const {
+    return m_commandCount;
+}
+
+QMap<QString, int> FakeImapServer::commandCounts() const {
+    return m_commandCounts;
+}
+
+qint64 FakeImapServer::bytesSent() const {
+    return m_bytesSent;
+}
+
+void FakeImapServer::resetCounters() {
+    m_commandCount = 0;
+    m_commandCounts.clear();
+    m_bytesSent = 0;
+}
+
+void FakeImapServer::onNewConnection() {
+    while (QTcpSocket* socket = m_server.nextPendingConnection()) {
+        m_connections.insert(socket, Connection());
+        QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() { onReadyRead(socket); });
+        QObject::connect(socket, &QTcpSocket::disconnected, socket, [this, socket]() {
+            m_connections.remove(socket);
+            socket->deleteLater();
+        });
+        send(socket, "* OK [CAPABILITY IMAP4rev1 UIDPLUS MOVE] Fake server ready\r\n");
+    }
+}
+
+void FakeImapServer::onReadyRead(QTcpSocket* socket) {
+    Connection& connection = m_connections[socket];
+    connection.buffer += socket->readAll();
+
+    int lineEnd;
+    while ((lineEnd = connection.buffer.indexOf("\r\n")) >= 0) {
+        QByteArray line = connection.buffer.left(lineEnd);
+        connection.buffer.remove(0, lineEnd + 2);
+        send(socket, respond(connection, line));
+    }
+}
+
+QByteArray FakeImapServer::respond(Connection& connection, const QByteArray& line) {
+    QList<QByteArray> words = line.split(' ');
+    if (words.size() < 2) {
+        return "* BAD Missing command\r\n";
+    }
+
+    const QByteArray tag = words.takeFirst();
+    QByteArray verb = words.takeFirst().toUpper();
+    if (verb == "UID" && !words.isEmpty()) {
+        verb += ' ' + words.takeFirst().toUpper();
+    }
+
+    ++m_commandCount;
+    ++m_commandCounts[QString::fromLatin1(verb)];
+
+    if (verb == "LOGIN" || verb == "NOOP" || verb == "UID STORE" || verb == "UID MOVE"
+        || verb == "EXPUNGE" || verb == "UID EXPUNGE" || verb == "CLOSE" || verb == "UNSELECT") {
+        if (verb == "CLOSE" || verb == "UNSELECT") {
+            connection.selected.clear();
+        }
+        return tag + " OK " + verb + " completed\r\n";
+    }
+    if (verb == "CAPABILITY") {
+        return "* CAPABILITY IMAP4rev1 UIDPLUS MOVE\r\n" + tag + " OK CAPABILITY completed\r\n";
+    }
+    if (verb == "LOGOUT") {
+        return "* BYE Logging out\r\n" + tag + " OK LOGOUT completed\r\n";
+    }
+    if (verb == "LIST") {
+        QByteArray reply;
+        // Only the top-level listing returns mailboxes; there is no hierarchy
+        if (!words.isEmpty() && words.first() == "\"\"") {
+            for (auto it = m_mailboxes.constBegin(); it != m_mailboxes.constEnd(); ++it) {
+                reply += "* LIST (\\HasNoChildren) \".\" \"" + it.key().toUtf8() + "\"\r\n";
+            }
+        }
+        return reply + tag + " OK LIST completed\r\n";
+    }
+    if (verb == "SELECT" || verb == "EXAMINE") {
+        QString mailbox = QString::fromUtf8(unquote(words.value(0)));
+        if (!m_mailboxes.contains(mailbox)) {
+            connection.selected.clear();
+            return tag + " NO Mailbox does not exist\r\n";
+        }
+        connection.selected = mailbox;
+        int messages = m_mailboxes.value(mailbox);
+        return "* " + QByteArray::number(messages) + " EXISTS\r\n"
+               "* OK [UIDVALIDITY 1] UIDs valid\r\n"
+               "* OK [UIDNEXT " + QByteArray::number(messages + 1) + "] Predicted next UID\r\n"
+               + tag + (verb == "SELECT" ? " OK [READ-WRITE] " : " OK [READ-ONLY] ") + verb + " completed\r\n";
+    }
+    if (verb == "FETCH" || verb == "UID FETCH") {
+        if (connection.selected.isEmpty()) {
+            return tag + " BAD No mailbox selected\r\n";
+        }
+        QByteArray range = words.value(0);
+        QByteArray items = words.mid(1).join(' ');
+        return fetchResponse(connection.selected, range, items) + tag + " OK FETCH completed\r\n";
+    }
+
+    return tag + " BAD Unknown command\r\n";
+}
+
+QByteArray FakeImapServer::fetchResponse(const QString& mailbox, const QByteArray& range,
+                                         const QByteArray& items) const {
+    QByteArray reply;
+    const bool withEnvelope = items.contains("ENVELOPE");
+    const bool withHeaders = items.contains("BODY[HEADER]") || items.contains("BODY.PEEK[HEADER]");
+    const bool withHeaderFields = items.contains("HEADER.FIELDS");
+    const QList<int> messages = resolveRange(range, m_mailboxes.value(mailbox));
+
+    for (int i : messages) {
+        const QByteArray number = QByteArray::number(i);
+        const QByteArray sender = "sender" + QByteArray::number(i % 20);
+        const QByteArray subject = mailbox.toUtf8() + " card " + number;
+
+        // UIDs equal message sequence numbers in this server
+        reply += "* " + number + " FETCH (UID " + number + " FLAGS (\\Seen) RFC822.SIZE 1024"
+                 " INTERNALDATE \"01-Jan-2024 12:00:00 +0000\"";
+        if (withEnvelope) {
+            reply += " ENVELOPE (\"Mon, 01 Jan 2024 12:00:00 +0000\" \"" + subject + "\" ((\"Sender\" NIL \""
+                     + sender + "\" \"example.com\")) NIL NIL ((NIL NIL \"board\" \"example.com\")) NIL NIL NIL \"<"
+                     + number + "@example.com>\")";
+        }
+        if (withHeaders || withHeaderFields) {
+            QByteArray headers = "From: Sender <" + sender + "@example.com>\r\n"
+                                 "To: board@example.com\r\n"
+                                 "Subject: " + subject + "\r\n"
+                                 "Date: Mon, 01 Jan 2024 12:00:00 +0000\r\n";
+            if (withHeaders) {
+                headers += "Message-ID: <" + number + "@example.com>\r\n";
+            }
+            headers += "\r\n";
+            const QByteArray section = withHeaders ? "BODY[HEADER]" : "BODY[HEADER.FIELDS (FROM TO SUBJECT DATE)]";
+            reply += ' ' + section + " {" + QByteArray::number(headers.size()) + "}\r\n" + headers;
+        }
+        reply += ")\r\n";
+    }
+    return reply;
+}
+
+void FakeImapServer::send(QTcpSocket* socket, const QByteArray& data) {
+    m_bytesSent += data.size();
+    if (m_latencyMs <= 0) {
+        socket->write(data);
+        return;
+    }
+    QTimer::singleShot(m_latencyMs, socket, [socket, data]() {
+        socket->write(data);
+    });
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+// Minimal in-process IMAP server for benchmarks. It answers the subset of
+// commands ImapClient issues, serves synthetic messages and delays every
+// reply by a fixed latency to emulate a remote link.
+class FakeImapServer {
+public:
+    explicit FakeImapServer(int latencyMs = 0);
+    ~FakeImapServer();
+
+    bool listen();
+    quint16 port() const;
+
+    void setLatency(int latencyMs);
+    void addMailbox(const QString& name, int messages);
+
+    // Traffic counters
+    int commandCount() const;
+    QMap<QString, int> commandCounts() const;
+    qint64 bytesSent() const;
+    void resetCounters();
+
+private:
+    struct Connection {
+        QByteArray buffer;
+        QString selected;
+    };
+
+    void onNewConnection();
+    void onReadyRead(QTcpSocket* socket);
+    QByteArray respond(Connection& connection, const QByteArray& line);
+    QByteArray fetchResponse(const QString& mailbox, const QByteArray& range, const QByteArray& items) const;
+    void send(QTcpSocket* socket, const QByteArray& data);
+
+    QTcpServer m_server;
+    QHash<QTcpSocket*, Connection> m_connections;
+    QMap<QString, int> m_mailboxes;
+    QMap<QString, int> m_commandCounts;
+    int m_latencyMs;
+    int m_commandCount;
+    qint64 m_bytesSent;
+};
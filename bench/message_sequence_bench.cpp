@@ -0,0 +1,83 @@
+// Applies a stream of EXPUNGE and unsolicited FETCH responses to the
+// sequence-number map of a large mailbox: a plain UID list, where every
+// expunge shifts the messages after it, against MessageSequence, where it
+// is O(log n). Both must report the same UIDs.
+//
+// Usage: bench-message-sequence [messages] [responses]
+
+#include "core/message_sequence.h"
+#include <QElapsedTimer>
+#include <QList>
+#include <QRandomGenerator>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+struct Response {
+    bool expunge;
+    quint32 msn;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int messages = argc > 1 ? atoi(argv[1]) : 200000;
+    int count = argc > 2 ? atoi(argv[2]) : 50000;
+    if (messages <= 0 || count <= 0 || count > messages) {
+        std::cerr << "Usage: bench-message-sequence [messages] [responses (up to messages)]" << std::endl;
+        return 1;
+    }
+
+    QList<quint32> uids;
+    uids.reserve(messages);
+    for (int i = 0; i < messages; ++i) {
+        uids.append(quint32(i) * 2 + 1);
+    }
+
+    // Half expunges, half flag changes, anywhere in the mailbox
+    QRandomGenerator random(42);
+    QList<Response> responses;
+    quint32 remaining = quint32(messages);
+    for (int i = 0; i < count; ++i) {
+        const bool expunge = i % 2 == 0;
+        responses.append({ expunge, quint32(random.bounded(remaining)) + 1 });
+        if (expunge) {
+            --remaining;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QList<quint32> list = uids;
+    quint64 listSum = 0;
+    for (const Response& response : responses) {
+        listSum += list.at(int(response.msn) - 1);
+        if (response.expunge) {
+            list.removeAt(int(response.msn) - 1);
+        }
+    }
+    const double listMs = timer.nsecsElapsed() / 1e6;
+
+    timer.restart();
+    MessageSequence sequence;
+    sequence.reset(quint32(messages));
+    sequence.setUnknownUids(uids);
+    const double loadMs = timer.nsecsElapsed() / 1e6;
+
+    timer.restart();
+    quint64 mapSum = 0;
+    for (const Response& response : responses) {
+        mapSum += response.expunge ? sequence.expunge(response.msn) : sequence.uid(response.msn);
+    }
+    const double mapMs = timer.nsecsElapsed() / 1e6;
+
+    std::cout << "Mailbox:        " << messages << " messages, " << count << " responses" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "UID list:       " << listMs << " ms" << std::endl;
+    std::cout << "Sequence map:   " << mapMs << " ms (+" << loadMs << " ms to load)" << std::endl;
+    std::cout << "Speedup:        " << (mapMs > 0 ? listMs / mapMs : 0.0) << "x"
+              << (listSum == mapSum ? "" : " [MISMATCH]") << std::endl;
+
+    return listSum == mapSum ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+// Compares serial (depth 1) and pipelined command submission against a local
+// IMAP server that delays every reply to emulate network latency.
+//
+// Usage: bench-pipeline [latency-ms] [mailboxes] [messages-per-mailbox] [depth]
+
+#include "core/imap_client.h"
+#include "core/settings.h"
+#include "fake_imap_server.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <functional>
+#include <iostream>
+
+namespace {
+
+// Spin the event loop until done() returns true or the deadline passes
+bool waitFor(const std::function<bool()>& done, int timeoutMs = 120000) {
+    QElapsedTimer timer;
+    timer.start();
+    while (!done()) {
+        if (timer.elapsed() > timeoutMs) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    return true;
+}
+
+struct RunResult {
+    bool ok = false;
+    qint64 elapsedMs = 0;
+    int cards = 0;
+    int commands = 0;
+};
+
+RunResult runRefresh(FakeImapServer& server, const QStringList& mailboxes, int depth) {
+    RunResult run;
+
+    Settings settings;
+    settings.setImapServer("127.0.0.1");
+    settings.setImapPort(server.port());
+    settings.setUseSSL(false);
+    settings.setPipelineDepth(depth);
+
+    ImapClient client;
+    bool authenticated = false;
+    QObject::connect(&client, &ImapClient::authenticated, [&authenticated]() { authenticated = true; });
+    QObject::connect(&client, &ImapClient::connected, [&client]() { client.authenticate("user", "pass"); });
+    client.connectToServer(settings);
+    if (!waitFor([&]() { return authenticated || client.state() == ImapClient::Error; }) || !authenticated) {
+        std::cerr << "Failed to connect: " << client.lastError().toStdString() << std::endl;
+        return run;
+    }
+
+    server.resetCounters();
+    int pending = mailboxes.size();
+    run.ok = true;
+
+    QElapsedTimer timer;
+    timer.start();
+    // Queue every mailbox at once, as KanbanModel::refreshAll() does
+    for (const QString& mailbox : mailboxes) {
+        client.fetchCards(mailbox, [&run, &pending](bool ok, const QList<EmailCard>& cards) {
+            run.ok = run.ok && ok;
+            run.cards += cards.size();
+            --pending;
+        });
+    }
+    run.ok = waitFor([&pending]() { return pending == 0; }) && run.ok;
+    run.elapsedMs = timer.elapsed();
+    run.commands = server.commandCount();
+
+    client.disconnectFromServer();
+    return run;
+}
+
+void printRun(int depth, const RunResult& run, int latencyMs) {
+    std::cout << "Depth " << depth << ":\t" << run.elapsedMs << " ms, " << run.cards << " cards, "
+              << run.commands << " commands";
+    if (latencyMs > 0) {
+        std::cout << " (~" << run.elapsedMs / latencyMs << " round trips)";
+    }
+    std::cout << (run.ok ? "" : " [FAILED]") << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    int latencyMs = args.size() > 1 ? args.at(1).toInt() : 50;
+    int mailboxCount = args.size() > 2 ? args.at(2).toInt() : 8;
+    int messages = args.size() > 3 ? args.at(3).toInt() : 50;
+    int depth = args.size() > 4 ? args.at(4).toInt() : 8;
+    if (latencyMs < 0 || mailboxCount <= 0 || messages < 0 || depth <= 0) {
+        std::cerr << "Usage: bench-pipeline [latency-ms] [mailboxes] [messages-per-mailbox] [depth]" << std::endl;
+        return 1;
+    }
+
+    FakeImapServer server(latencyMs);
+    QStringList mailboxes;
+    for (int i = 0; i < mailboxCount; ++i) {
+        QString name = QString("List%1").arg(i + 1);
+        server.addMailbox(name, messages);
+        mailboxes.append(name);
+    }
+    if (!server.listen()) {
+        std::cerr << "Failed to start fake IMAP server" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Latency:        " << latencyMs << " ms per reply" << std::endl;
+    std::cout << "Mailboxes:      " << mailboxCount << " x " << messages << " messages" << std::endl;
+
+    RunResult serial = runRefresh(server, mailboxes, 1);
+    printRun(1, serial, latencyMs);
+
+    RunResult pipelined = runRefresh(server, mailboxes, depth);
+    printRun(depth, pipelined, latencyMs);
+
+    if (serial.ok && pipelined.ok && pipelined.elapsedMs > 0) {
+        std::cout << "Speedup:        " << double(serial.elapsedMs) / pipelined.elapsedMs << "x" << std::endl;
+    }
+
+    return serial.ok && pipelined.ok ? 0 : 1;
+}
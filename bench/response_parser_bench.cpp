@@ -0,0 +1,79 @@
+// Measures ImapResponseParser throughput on a synthetic "FETCH 1:*" reply.
+//
+// Usage: bench-response-parser [messages] [chunk-size]
+
+#include "core/imap_response_parser.h"
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <iostream>
+
+namespace {
+
+QByteArray buildFetchResponse(int messages) {
+    QByteArray data;
+    data.reserve(messages * 700);
+
+    for (int i = 1; i <= messages; ++i) {
+        QByteArray headers =
+            "Return-Path: <sender" + QByteArray::number(i % 50) + "@example.com>\r\n"
+            "From: Sender " + QByteArray::number(i % 50) + " <sender" + QByteArray::number(i % 50) + "@example.com>\r\n"
+            "To: board@example.com\r\n"
+            "Subject: Card number " + QByteArray::number(i) + " (with {braces} and \"quotes\")\r\n"
+            "Date: Mon, 01 Jan 2024 12:00:00 +0000\r\n"
+            "Message-ID: <" + QByteArray::number(i) + "@example.com>\r\n"
+            "\r\n";
+
+        data += "* " + QByteArray::number(i) + " FETCH (UID " + QByteArray::number(i + 1000)
+              + " FLAGS (\\Seen $Label1) ENVELOPE (\"Mon, 01 Jan 2024 12:00:00 +0000\" \"Card number "
+              + QByteArray::number(i) + "\" ((\"Sender\" NIL \"sender\" \"example.com\")) NIL NIL "
+              "((NIL NIL \"board\" \"example.com\")) NIL NIL NIL \"<" + QByteArray::number(i)
+              + "@example.com>\") BODY[HEADER] {" + QByteArray::number(headers.size()) + "}\r\n"
+              + headers + ")\r\n";
+    }
+    data += "A0001 OK Fetch completed.\r\n";
+    return data;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int messages = argc > 1 ? QByteArray(argv[1]).toInt() : 50000;
+    int chunkSize = argc > 2 ? QByteArray(argv[2]).toInt() : 16384;
+    if (messages <= 0 || chunkSize <= 0) {
+        std::cerr << "Usage: bench-response-parser [messages] [chunk-size]" << std::endl;
+        return 1;
+    }
+
+    const QByteArray data = buildFetchResponse(messages);
+
+    ImapResponseParser parser;
+    ImapResponse response;
+    int responses = 0;
+    int fetches = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int offset = 0; offset < data.size(); offset += chunkSize) {
+        parser.feed(data.mid(offset, chunkSize));
+        while (parser.next(response)) {
+            ++responses;
+            if (response.name == "FETCH" && response.fields.at(0).value("BODY[HEADER]").isString()) {
+                ++fetches;
+            }
+        }
+    }
+
+    qint64 elapsedNs = timer.nsecsElapsed();
+    double seconds = elapsedNs / 1e9;
+    double megabytes = data.size() / (1024.0 * 1024.0);
+
+    std::cout << "Messages:       " << messages << std::endl;
+    std::cout << "Chunk size:     " << chunkSize << " bytes" << std::endl;
+    std::cout << "Input:          " << megabytes << " MB" << std::endl;
+    std::cout << "Responses:      " << responses << " (" << fetches << " FETCH with literal)" << std::endl;
+    std::cout << "Elapsed:        " << seconds * 1000.0 << " ms" << std::endl;
+    std::cout << "Throughput:     " << (seconds > 0 ? megabytes / seconds : 0.0) << " MB/s" << std::endl;
+
+    return fetches == messages ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// Counts the commands a sequence of typical user actions sends, and how many
+// of them are SELECT or EXAMINE, now that the client only selects a mailbox
+// when the mailbox or the access it needs changes. Before, every action
+// began with a SELECT of its mailbox. "re-refresh" is a refresh of the
+// column that is selected already, whose window follows from the EXISTS
+// count the client tracks.
+//
+// Usage: bench-select [rounds] [messages-per-mailbox]
+
+#include "core/imap_client.h"
+#include "core/settings.h"
+#include "fake_imap_server.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMap>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+// Spin the event loop until done() returns true or the deadline passes
+bool waitFor(const std::function<bool()>& done, int timeoutMs = 120000) {
+    QElapsedTimer timer;
+    timer.start();
+    while (!done()) {
+        if (timer.elapsed() > timeoutMs) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    return true;
+}
+
+struct ActionCounts {
+    int runs = 0;
+    int commands = 0;
+    int selections = 0;
+};
+
+// A user action: sends its commands and calls done(ok) when answered
+using Action = std::function<void(ImapClient& client, const std::function<void(bool ok)>& done)>;
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    int rounds = args.size() > 1 ? args.at(1).toInt() : 20;
+    int messages = args.size() > 2 ? args.at(2).toInt() : 200;
+    if (rounds <= 0 || messages < 8) {
+        std::cerr << "Usage: bench-select [rounds] [messages-per-mailbox (8 or more)]" << std::endl;
+        return 1;
+    }
+
+    FakeImapServer server;
+    server.addMailbox("TODO", messages);
+    server.addMailbox("DONE", messages);
+    if (!server.listen()) {
+        std::cerr << "Failed to start fake IMAP server" << std::endl;
+        return 1;
+    }
+
+    Settings settings;
+    settings.setImapServer("127.0.0.1");
+    settings.setImapPort(server.port());
+    settings.setUseSSL(false);
+
+    ImapClient client;
+    client.setCardWindow(50);
+    bool authenticated = false;
+    QObject::connect(&client, &ImapClient::authenticated, [&authenticated]() { authenticated = true; });
+    QObject::connect(&client, &ImapClient::connected, [&client]() { client.authenticate("user", "pass"); });
+    client.connectToServer(settings);
+    if (!waitFor([&]() { return authenticated || client.state() == ImapClient::Error; }) || !authenticated) {
+        std::cerr << "Failed to connect: " << client.lastError().toStdString() << std::endl;
+        return 1;
+    }
+
+    // A session on two columns: refreshes in between card actions
+    auto refresh = [](const QString& mailbox) -> Action {
+        return [mailbox](ImapClient& client, const std::function<void(bool)>& done) {
+            client.syncCards(mailbox, [done](bool ok, const MailboxChanges&) { done(ok); });
+        };
+    };
+    const QList<QPair<QString, Action>> session = {
+        {"refresh", refresh("TODO")},
+        {"mark read", [](ImapClient& client, const std::function<void(bool)>& done) {
+            client.markAsRead("1", true, "TODO", done);
+        }},
+        {"flag", [](ImapClient& client, const std::function<void(bool)>& done) {
+            client.markAsFlagged("2", true, "TODO", done);
+        }},
+        {"move", [](ImapClient& client, const std::function<void(bool)>& done) {
+            client.moveCard("3", "TODO", "DONE", [done](bool ok, const QHash<quint32, quint32>&) { done(ok); });
+        }},
+        {"refresh", refresh("DONE")},
+        {"mark read", [](ImapClient& client, const std::function<void(bool)>& done) {
+            client.markAsRead("4", true, "DONE", done);
+        }},
+        {"delete", [](ImapClient& client, const std::function<void(bool)>& done) {
+            client.deleteCard("5", "DONE", done);
+        }},
+        {"re-refresh", refresh("DONE")},
+    };
+
+    QMap<QString, ActionCounts> counts;
+    bool ok = true;
+    for (int round = 0; round < rounds && ok; ++round) {
+        for (const auto& action : session) {
+            server.resetCounters();
+            bool finished = false;
+            action.second(client, [&finished, &ok](bool actionOk) {
+                ok = ok && actionOk;
+                finished = true;
+            });
+            ok = waitFor([&finished]() { return finished; }) && ok;
+
+            const QMap<QString, int> sent = server.commandCounts();
+            ActionCounts& count = counts[action.first];
+            ++count.runs;
+            count.commands += server.commandCount();
+            count.selections += sent.value("SELECT") + sent.value("EXAMINE");
+        }
+    }
+    client.disconnectFromServer();
+
+    std::cout << "Rounds:         " << rounds << " x " << session.size() << " actions" << std::endl;
+    std::cout << std::left << std::setw(12) << "Action" << std::right << std::setw(12) << "commands"
+              << std::setw(12) << "selections" << std::setw(12) << "saved" << std::endl;
+    ActionCounts total;
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        const ActionCounts& count = it.value();
+        // Previously one SELECT per action
+        std::cout << std::left << std::setw(12) << it.key().toStdString() << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(12) << double(count.commands) / count.runs
+                  << std::setw(12) << double(count.selections) / count.runs
+                  << std::setw(12) << double(count.runs - count.selections) / count.runs << std::endl;
+        total.runs += count.runs;
+        total.commands += count.commands;
+        total.selections += count.selections;
+    }
+    std::cout << "Selections:     " << total.selections << " of " << total.runs << " actions ("
+              << total.runs - total.selections << " commands saved)" << (ok ? "" : " [FAILED]") << std::endl;
+
+    return ok ? 0 : 1;
+}
@@ -1,14 +1,18 @@
 #include "cli_application.h"
+#include "../core/sequence_set.h"
 #include <QTextStream>
 #include <QEventLoop>
 #include <QTimer>
 #include <QLoggingCategory>
+#include <QDate>
+#include <algorithm>
 #include <iostream>
 
 CliApplication::CliApplication(int argc, char* argv[])
     : QCoreApplication(argc, argv)
     , m_model(nullptr)
     , m_connected(false)
+    , m_operationQueued(false)
     , m_verbose(false)
     , m_argc(argc)
     , m_argv(argv)
@@ -64,7 +68,7 @@ void CliApplication::setupCommandLineParser() {
     
     // Commands
     m_parser.addPositionalArgument("command", "Command to execute", 
-        "list-mailboxes|show-cards|move-card|delete-card|mark-read|mark-unread|mark-flag|mark-unflag|configure|status");
+        "list-mailboxes|show-cards|move-card|move-cards|delete-card|mark-read|mark-unread|mark-flag|mark-unflag|configure|status");
     
     // Options
     QCommandLineOption mailboxOption(QStringList() << "m" << "mailbox",
@@ -80,9 +84,21 @@ void CliApplication::setupCommandLineParser() {
     m_parser.addOption(toOption);
     
     QCommandLineOption uidOption(QStringList() << "u" << "uid",
-        "Email UID", "uid");
+        "Email UID (a list such as 1,2,5-9 for move-cards)", "uid");
     m_parser.addOption(uidOption);
     
+    QCommandLineOption limitOption(QStringList() << "l" << "limit",
+        "Show at most this many cards (show-cards)", "count");
+    m_parser.addOption(limitOption);
+    
+    QCommandLineOption offsetOption("offset",
+        "Skip this many of the newest cards (show-cards)", "count");
+    m_parser.addOption(offsetOption);
+    
+    QCommandLineOption sinceOption("since",
+        "Only show cards dated on or after this day, YYYY-MM-DD (show-cards)", "date");
+    m_parser.addOption(sinceOption);
+    
     QCommandLineOption detailedOption(QStringList() << "d" << "detailed",
         "Show detailed information");
     m_parser.addOption(detailedOption);
@@ -204,6 +220,23 @@ int CliApplication::executeCommand() {
             return 1;
         }
         return moveCard(uid, from, to);
+    } else if (command == "move-cards") {
+        // -u takes a list such as 1,2,5-9
+        bool ok = false;
+        QList<quint32> uids = SequenceSet::parse(m_parser.value("uid").replace('-', ':').toLatin1(), &ok);
+        QString from = m_parser.value("from");
+        QString to = m_parser.value("to");
+
+        if (!ok) {
+            std::cerr << "Too many UIDs for move-cards (at most " << SequenceSet::kMaxNumbers << ")" << std::endl;
+            return 1;
+        }
+
+        if (uids.isEmpty() || from.isEmpty() || to.isEmpty()) {
+            std::cerr << "UIDs, from, and to mailboxes required for move-cards command" << std::endl;
+            return 1;
+        }
+        return moveCards(uids, from, to);
     } else if (command == "delete-card") {
         QString uid = m_parser.value("uid");
         QString mailbox = m_parser.value("mailbox");
@@ -266,6 +299,10 @@ int CliApplication::listMailboxes() {
         if (visible.contains(mailbox)) {
             std::cout << " (visible)";
         }
+        const MailboxInfo info = m_model->mailboxInfo(mailbox);
+        if (info.hasStatus) {
+            std::cout << " - " << info.messages << " messages, " << info.unseen << " unread";
+        }
         std::cout << std::endl;
     }
     
@@ -273,14 +310,59 @@ int CliApplication::listMailboxes() {
 }
 
 int CliApplication::showCards(const QString& mailbox) {
+    if (!waitForRefresh()) {
+        std::cerr << "Timed out loading cards" << std::endl;
+        return 1;
+    }
+    
+    const int limit = m_parser.isSet("limit") ? m_parser.value("limit").toInt() : -1;
+    const int offset = qMax(0, m_parser.value("offset").toInt());
+    QDate since;
+    if (m_parser.isSet("since")) {
+        since = QDate::fromString(m_parser.value("since"), Qt::ISODate);
+        if (!since.isValid()) {
+            std::cerr << "Invalid --since date, expected YYYY-MM-DD" << std::endl;
+            return 1;
+        }
+    }
+    
+    // Only the newest cards are loaded by a refresh; fetch older pages
+    // until the requested range is covered
+    while (m_model->hasOlderCards(mailbox)) {
+        const MailboxList loaded = m_model->mailboxList(mailbox);
+        int missing = 0;
+        if (limit >= 0) {
+            missing = offset + limit - loaded.cardCount();
+        }
+        if (since.isValid() && !loaded.cards().isEmpty() && loaded.cards().last().date().date() >= since) {
+            missing = qMax(missing, m_model->settings().cardWindow());
+        }
+        if (missing <= 0 || !m_model->fetchOlderCards(mailbox, missing) || !waitForOlderCards(mailbox)) {
+            break;
+        }
+    }
+    
     MailboxList list = m_model->mailboxList(mailbox);
+    QList<EmailCard> cards = list.cards();
+    if (since.isValid()) {
+        cards.erase(std::remove_if(cards.begin(), cards.end(), [&since](const EmailCard& card) {
+            return card.date().date() < since;
+        }), cards.end());
+    }
+    cards = cards.mid(offset, limit);
     
     std::cout << "Cards in mailbox '" << mailbox.toStdString() << "':" << std::endl;
-    std::cout << "Total: " << list.cardCount() << " cards" << std::endl;
+    std::cout << "Total: " << list.cardCount() << " cards";
+    if (list.hasOlderCards()) {
+        std::cout << " loaded, more on the server";
+    }
+    std::cout << std::endl;
+    if (cards.size() != list.cardCount()) {
+        std::cout << "Showing: " << cards.size() << " cards" << std::endl;
+    }
     std::cout << std::endl;
     
     bool detailed = m_parser.isSet("detailed");
-    const QList<EmailCard> cards = list.cards();
     
     for (const EmailCard& card : cards) {
         printCard(card, detailed);
@@ -291,7 +373,12 @@ int CliApplication::showCards(const QString& mailbox) {
 }
 
 int CliApplication::moveCard(const QString& uid, const QString& fromMailbox, const QString& toMailbox) {
-    if (m_model->moveCard(uid, fromMailbox, toMailbox)) {
+    // Cards are acted on as the model has them, so they must be loaded first
+    waitForRefresh();
+    if (m_model->moveCard(uid, fromMailbox, toMailbox) && waitForOperation()) {
+        if (reportQueued()) {
+            return 0;
+        }
         std::cout << "Card " << uid.toStdString() 
                   << " moved from '" << fromMailbox.toStdString() 
                   << "' to '" << toMailbox.toStdString() << "'" << std::endl;
@@ -302,8 +389,36 @@ int CliApplication::moveCard(const QString& uid, const QString& fromMailbox, con
     }
 }
 
+int CliApplication::moveCards(const QList<quint32>& uids, const QString& fromMailbox, const QString& toMailbox) {
+    waitForRefresh();
+    QStringList moved;
+    for (quint32 uid : uids) {
+        moved.append(QString::number(uid));
+    }
+
+    // One UID MOVE for all of them, loaded or not. The server skips UIDs it
+    // does not have, so the set is reported rather than a count.
+    QHash<QString, QStringList> cards;
+    cards.insert(fromMailbox, moved);
+    if (m_model->moveCards(cards, toMailbox) && waitForOperation()) {
+        if (reportQueued()) {
+            return 0;
+        }
+        std::cout << "Cards " << SequenceSet::format(uids).constData() << " moved from '"
+                  << fromMailbox.toStdString() << "' to '" << toMailbox.toStdString() << "'" << std::endl;
+        return 0;
+    } else {
+        std::cerr << "Failed to move cards: " << m_model->lastError().toStdString() << std::endl;
+        return 1;
+    }
+}
+
 int CliApplication::deleteCard(const QString& uid, const QString& mailbox) {
-    if (m_model->deleteCard(uid, mailbox)) {
+    waitForRefresh();
+    if (m_model->deleteCard(uid, mailbox) && waitForOperation()) {
+        if (reportQueued()) {
+            return 0;
+        }
         std::cout << "Card " << uid.toStdString() 
                   << " deleted from '" << mailbox.toStdString() << "'" << std::endl;
         return 0;
@@ -314,18 +429,22 @@ int CliApplication::deleteCard(const QString& uid, const QString& mailbox) {
 }
 
 int CliApplication::markCard(const QString& uid, const QString& mailbox, const QString& flag, bool set) {
+    waitForRefresh();
     bool success = false;
     QString action;
     
     if (flag == "read") {
-        success = m_model->markCardAsRead(uid, mailbox, set);
+        success = m_model->markCardAsRead(uid, mailbox, set) && waitForOperation();
         action = set ? "marked as read" : "marked as unread";
     } else if (flag == "flag") {
-        success = m_model->markCardAsFlagged(uid, mailbox, set);
+        success = m_model->markCardAsFlagged(uid, mailbox, set) && waitForOperation();
         action = set ? "flagged" : "unflagged";
     }
     
     if (success) {
+        if (reportQueued()) {
+            return 0;
+        }
         std::cout << "Card " << uid.toStdString() 
                   << " " << action.toStdString() << std::endl;
         return 0;
@@ -446,6 +565,80 @@ bool CliApplication::waitForConnection(int timeoutMs) {
     return m_connected;
 }
 
+bool CliApplication::waitForRefresh(int timeoutMs) {
+    if (!m_model->isRefreshing()) {
+        return true;
+    }
+    
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    
+    connect(&timer, &QTimer::timeout, &loop, &QEventLoop::quit);
+    connect(m_model, &KanbanModel::refreshFinished, &loop, &QEventLoop::quit);
+    
+    timer.start(timeoutMs);
+    loop.exec();
+    
+    return !m_model->isRefreshing();
+}
+
+bool CliApplication::waitForOlderCards(const QString& mailbox, int timeoutMs) {
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    bool success = false;
+    
+    connect(&timer, &QTimer::timeout, &loop, &QEventLoop::quit);
+    connect(m_model, &KanbanModel::olderCardsFetched, &loop,
+            [&loop, &success, &mailbox](const QString& fetched, bool ok) {
+        if (fetched == mailbox) {
+            success = ok;
+            loop.quit();
+        }
+    });
+    
+    timer.start(timeoutMs);
+    loop.exec();
+    
+    return success;
+}
+
+bool CliApplication::waitForOperation(int timeoutMs) {
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    bool success = false;
+    m_operationQueued = false;
+    
+    connect(&timer, &QTimer::timeout, &loop, &QEventLoop::quit);
+    connect(m_model, &KanbanModel::operationFinished, &loop, [&loop, &success](bool ok) {
+        success = ok;
+        loop.quit();
+    });
+    connect(m_model, &KanbanModel::operationQueued, &loop, [this, &loop, &success]() {
+        success = true;
+        m_operationQueued = true;
+        loop.quit();
+    });
+    
+    timer.start(timeoutMs);
+    loop.exec();
+    
+    return success;
+}
+
+bool CliApplication::reportQueued() {
+    if (!m_operationQueued) {
+        return false;
+    }
+    // Operations made offline go to the server in order, once the ones
+    // before them have been replayed
+    std::cout << "Change journaled, not yet applied on the server ("
+              << m_model->pendingOperations() << " offline changes pending)" << std::endl;
+    return true;
+}
+
 QString CliApplication::promptForInput(const QString& prompt, bool hidden) {
     std::cout << prompt.toStdString();
     std::cout.flush();
@@ -26,6 +26,7 @@ private:
     int listMailboxes();
     int showCards(const QString& mailbox);
     int moveCard(const QString& uid, const QString& fromMailbox, const QString& toMailbox);
+    int moveCards(const QList<quint32>& uids, const QString& fromMailbox, const QString& toMailbox);
     int deleteCard(const QString& uid, const QString& mailbox);
     int markCard(const QString& uid, const QString& mailbox, const QString& flag, bool set);
     int configure();
@@ -35,11 +36,18 @@ private:
     void printCard(const EmailCard& card, bool detailed = false);
     void printMailboxList(const MailboxList& list);
     bool waitForConnection(int timeoutMs = 10000);
+    bool waitForRefresh(int timeoutMs = 30000);
+    bool waitForOlderCards(const QString& mailbox, int timeoutMs = 30000);
+    // True once the server confirmed the operation, or it was journaled
+    bool waitForOperation(int timeoutMs = 30000);
+    // Says so if the last operation was only journaled; true if it was
+    bool reportQueued();
     QString promptForInput(const QString& prompt, bool hidden = false);
     
     QCommandLineParser m_parser;
     KanbanModel* m_model;
     bool m_connected;
+    bool m_operationQueued;
     QString m_lastError;
     bool m_verbose;
     int m_argc;
@@ -0,0 +1,121 @@
+#include "card_cache.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+const quint32 kCacheMagic = 0x494b4343;   // "IKCC"
+const quint32 kCacheVersion = 2;            // 2: placeholders above the UID range
+
+} // namespace
+
+CardCache::CardCache(const QString& directory)
+    : m_directory(directory)
+{
+    if (m_directory.isEmpty()) {
+        // Settings live in <config>/IMAPKanban (see Settings), the cache beside them
+        m_directory = QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation)
+            + "/IMAPKanban/cache";
+    }
+}
+
+QString CardCache::directory() const {
+    return m_directory;
+}
+
+void CardCache::setAccount(const QString& server, const QString& username) {
+    QByteArray account = (username + '@' + server).toUtf8();
+    m_account = QCryptographicHash::hash(account, QCryptographicHash::Sha1).toHex().left(16);
+}
+
+bool CardCache::load(const QString& mailbox, MailboxList& list, MailboxSyncState& state) const {
+    QFile file(filePath(mailbox));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != kCacheMagic || version != kCacheVersion) {
+        return false;
+    }
+
+    MailboxSyncState cached;
+    bool hasOlder = false;
+    qint32 count = 0;
+    in >> cached.uidValidity >> cached.highestModSeq >> cached.uidNext >> hasOlder >> count;
+
+    QList<EmailCard> cards;
+    cards.reserve(qMax(0, count));
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString uid, subject, from, to;
+        QDateTime date;
+        qint64 size = 0;
+        QStringList flags;
+        in >> uid >> subject >> from >> to >> date >> size >> flags;
+
+        EmailCard card(uid, subject, from, date);
+        card.setTo(to);
+        card.setSize(size);
+        card.setFlags(flags);
+        cards.append(card);
+    }
+
+    if (in.status() != QDataStream::Ok || cached.uidValidity == 0) {
+        qDebug() << "CACHE: discarding unreadable cache for" << mailbox;
+        return false;
+    }
+
+    list.setName(mailbox);
+    list.setCards(cards);
+    list.setHasOlderCards(hasOlder);
+    state = cached;
+    return true;
+}
+
+bool CardCache::store(const QString& mailbox, const QList<EmailCard>& cards, bool hasOlder,
+                      const MailboxSyncState& state) {
+    // Cards without a UIDVALIDITY to qualify their UIDs cannot be reused
+    if (state.uidValidity == 0) {
+        invalidate(mailbox);
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(filePath(mailbox)).absolutePath());
+    QSaveFile file(filePath(mailbox));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+
+    out << kCacheMagic << kCacheVersion;
+    out << state.uidValidity << state.highestModSeq << state.uidNext << hasOlder
+        << qint32(cards.size());
+    for (const EmailCard& card : cards) {
+        out << card.uid() << card.subject() << card.from() << card.to() << card.date() << card.size()
+            << card.flags();
+    }
+
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+void CardCache::invalidate(const QString& mailbox) {
+    QFile::remove(filePath(mailbox));
+}
+
+QString CardCache::filePath(const QString& mailbox) const {
+    // Mailbox names may contain any character, so the file name is hex-encoded
+    return QString("%1/%2/%3.cards").arg(m_directory, m_account, QString::fromLatin1(mailbox.toUtf8().toHex()));
+}
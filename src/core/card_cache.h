@@ -0,0 +1,33 @@
+#pragma once
+
+#include "mailbox_list.h"
+#include "mailbox_sync_state.h"
+#include <QString>
+
+// On-disk copy of the card metadata and sync state of each mailbox, so a
+// board can be shown before the server answers and then brought up to date
+// with a delta sync. There is one file per mailbox, rewritten atomically;
+// its cards are only valid for the UIDVALIDITY stored with them.
+class CardCache {
+public:
+    // Defaults to a "cache" directory next to the application settings
+    explicit CardCache(const QString& directory = QString());
+
+    QString directory() const;
+
+    // Caches of different accounts are kept apart
+    void setAccount(const QString& server, const QString& username);
+
+    bool load(const QString& mailbox, MailboxList& list, MailboxSyncState& state) const;
+    // Takes a snapshot of the cards rather than a MailboxList, so that it
+    // can be written away from the GUI thread
+    bool store(const QString& mailbox, const QList<EmailCard>& cards, bool hasOlder,
+               const MailboxSyncState& state);
+    void invalidate(const QString& mailbox);
+
+private:
+    QString filePath(const QString& mailbox) const;
+
+    QString m_directory;
+    QString m_account;
+};
@@ -0,0 +1,142 @@
+#include "command_scheduler.h"
+#include "imap_connection_pool.h"
+#include <memory>
+
+CommandScheduler::CommandScheduler(ImapConnectionPool* pool)
+    : m_pool(pool)
+    , m_running(0)
+{
+}
+
+void CommandScheduler::submit(Priority priority, const QString& mailbox, const QString& key, Job job,
+                              const std::function<void()>& merged) {
+    if (!key.isEmpty()) {
+        for (int queue = 0; queue < PriorityCount; ++queue) {
+            for (int i = 0; i < m_queues[queue].size(); ++i) {
+                if (m_queues[queue].at(i).key != key) {
+                    continue;
+                }
+                ++m_metrics.coalesced;
+                if (merged) {
+                    m_queues[queue][i].merged.append(merged);
+                }
+                if (priority < queue) {
+                    Pending raised = m_queues[queue].takeAt(i);
+                    raised.priority = priority;
+                    if (priority == Interactive) {
+                        // Never queued: dispatch() only drains the others
+                        start(raised);
+                    } else {
+                        m_queues[priority].append(raised);
+                    }
+                }
+                dispatch();
+                return;
+            }
+        }
+    }
+
+    Pending pending{priority, mailbox, key, job, QElapsedTimer(), QList<std::function<void()>>()};
+    pending.queued.start();
+    if (priority == Interactive) {
+        start(pending);
+        return;
+    }
+
+    m_queues[priority].append(pending);
+    m_metrics.maxQueueDepth[priority] = qMax(m_metrics.maxQueueDepth[priority], int(m_queues[priority].size()));
+    dispatch();
+}
+
+void CommandScheduler::cancelAll() {
+    for (int queue = 0; queue < PriorityCount; ++queue) {
+        const QList<Pending> cancelled = m_queues[queue];
+        m_queues[queue].clear();
+        for (const Pending& pending : cancelled) {
+            pending.job(nullptr, std::function<void()>());
+            for (const std::function<void()>& merged : pending.merged) {
+                merged();
+            }
+        }
+    }
+}
+
+int CommandScheduler::queueDepth() const {
+    int depth = 0;
+    for (int queue = 0; queue < PriorityCount; ++queue) {
+        depth += m_queues[queue].size();
+    }
+    return depth;
+}
+
+CommandScheduler::Metrics CommandScheduler::metrics() const {
+    Metrics metrics = m_metrics;
+    for (int queue = 0; queue < PriorityCount; ++queue) {
+        metrics.queueDepth[queue] = m_queues[queue].size();
+    }
+    return metrics;
+}
+
+void CommandScheduler::dispatch() {
+    while (m_running < backgroundCapacity()) {
+        int queue = VisibleRefresh;
+        while (queue < PriorityCount && m_queues[queue].isEmpty()) {
+            ++queue;
+        }
+        if (queue == PriorityCount) {
+            return;
+        }
+        ++m_running;
+        start(m_queues[queue].takeFirst());
+    }
+}
+
+void CommandScheduler::start(const Pending& pending) {
+    const Priority priority = pending.priority;
+    m_metrics.waitTime[priority].record(pending.queued.nsecsElapsed());
+
+    QElapsedTimer running;
+    running.start();
+    auto finished = std::make_shared<bool>(false);
+    const QList<std::function<void()>> merged = pending.merged;
+    const std::function<void()> done = [this, priority, running, finished, merged]() {
+        if (*finished) {
+            return;
+        }
+        *finished = true;
+        m_metrics.runTime[priority].record(running.nsecsElapsed());
+        ++m_metrics.completed[priority];
+        for (const std::function<void()>& callback : merged) {
+            callback();
+        }
+        if (priority != Interactive) {
+            --m_running;
+            dispatch();
+        }
+    };
+
+    const Job job = pending.job;
+    if (priority == Interactive) {
+        ImapClient* client = m_pool->interactive();
+        if (!client->isAuthenticated()) {
+            job(nullptr, done);
+            done();
+            return;
+        }
+        job(client, done);
+        return;
+    }
+
+    m_pool->acquire(pending.mailbox, [job, done](ImapClient* client) {
+        job(client, done);
+        if (!client) {
+            done();
+        }
+    });
+}
+
+int CommandScheduler::backgroundCapacity() const {
+    // One job per background connection; with none, the interactive
+    // connection takes one at a time
+    return qMax(1, m_pool->maxConnections() - 1);
+}
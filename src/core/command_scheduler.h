@@ -0,0 +1,78 @@
+#pragma once
+
+#include "imap_client.h"
+#include "latency_stats.h"
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+#include <functional>
+
+class ImapConnectionPool;
+
+// Orders the work handed to a connection pool. Interactive jobs (user
+// actions) go to the interactive connection at once. Refreshes and
+// prefetches wait here, higher priority first, and no more of them run at a
+// time than there are background connections, so a user action never
+// queues behind more than the job in progress on a connection, however
+// many columns are due for a refresh.
+//
+// A job is a short run of commands that belong together, such as the
+// SELECT and FETCHes of one mailbox sync. Work is preempted between jobs,
+// never inside one: the commands of a job depend on the mailbox it selected.
+class CommandScheduler {
+public:
+    // Highest first
+    enum Priority {
+        Interactive,
+        VisibleRefresh,
+        BackgroundPrefetch
+    };
+    static const int PriorityCount = 3;
+
+    // Sends the job's commands on the client and calls done() once the last
+    // of them has been answered. A null client means the job will not run
+    // because there is no connection; done() need not be called then.
+    using Job = std::function<void(ImapClient* client, const std::function<void()>& done)>;
+
+    struct Metrics {
+        int queueDepth[PriorityCount] = {};     // Waiting now
+        int maxQueueDepth[PriorityCount] = {};
+        int completed[PriorityCount] = {};
+        int coalesced = 0;
+        LatencyStats waitTime[PriorityCount];   // From submission until started
+        LatencyStats runTime[PriorityCount];
+    };
+
+    explicit CommandScheduler(ImapConnectionPool* pool);
+
+    // A job with a non-empty key is merged into a waiting job with the same
+    // key, which takes the higher of the two priorities. The merged job is
+    // never called; merged is, once the job it was merged into is over.
+    // Background jobs are run on a connection chosen for the mailbox.
+    void submit(Priority priority, const QString& mailbox, const QString& key, Job job,
+                const std::function<void()>& merged = std::function<void()>());
+    // Drops every waiting job, e.g. when the session ends
+    void cancelAll();
+
+    int queueDepth() const;
+    Metrics metrics() const;
+
+private:
+    struct Pending {
+        Priority priority;
+        QString mailbox;
+        QString key;
+        Job job;
+        QElapsedTimer queued;
+        QList<std::function<void()>> merged;    // Of the jobs merged into it
+    };
+
+    void dispatch();
+    void start(const Pending& pending);
+    int backgroundCapacity() const;
+
+    ImapConnectionPool* m_pool;
+    QList<Pending> m_queues[PriorityCount];
+    int m_running;      // Background jobs in progress
+    Metrics m_metrics;
+};
@@ -1,25 +1,169 @@
 #include "email_card.h"
+#include <QHash>
+#include <QReadWriteLock>
+#include <QTimeZone>
+#include <limits>
+
+namespace {
+
+const qint64 kInvalidDate = std::numeric_limits<qint64>::min();
+// Placeholder keys start above the largest UID (RFC 3501 nz-number)
+const quint64 kPlaceholderKeys = quint64(std::numeric_limits<quint32>::max()) + 1;
+
+struct SystemFlagName {
+    EmailCard::SystemFlag flag;
+    const char* name;
+};
+
+const SystemFlagName kSystemFlags[] = {
+    { EmailCard::Seen, "\\Seen" },
+    { EmailCard::Answered, "\\Answered" },
+    { EmailCard::Flagged, "\\Flagged" },
+    { EmailCard::Deleted, "\\Deleted" },
+    { EmailCard::Draft, "\\Draft" },
+    { EmailCard::Recent, "\\Recent" }
+};
+
+int systemFlag(const QString& flag) {
+    if (!flag.startsWith(QLatin1Char('\\'))) {
+        return 0;
+    }
+    for (const SystemFlagName& entry : kSystemFlags) {
+        if (flag.compare(QLatin1String(entry.name), Qt::CaseInsensitive) == 0) {
+            return entry.flag;
+        }
+    }
+    return 0;
+}
+
+// Process-wide table of keyword sets. Cards of one board share a handful of
+// keyword combinations, so each card stores the ID of its set instead of a
+// list of strings. IDs are never released; ID 0 is the empty set.
+class KeywordSets {
+public:
+    static KeywordSets& instance() {
+        static KeywordSets sets;
+        return sets;
+    }
+
+    quint32 intern(QStringList keywords) {
+        if (keywords.isEmpty()) {
+            return 0;
+        }
+        keywords.sort();
+        keywords.removeDuplicates();
+        keywords = StringPool::internStrings(keywords);
+
+        {
+            QReadLocker locker(&m_lock);
+            auto it = m_ids.constFind(keywords);
+            if (it != m_ids.constEnd()) {
+                return it.value();
+            }
+        }
+
+        QWriteLocker locker(&m_lock);
+        auto it = m_ids.constFind(keywords);
+        if (it != m_ids.constEnd()) {
+            return it.value();
+        }
+        quint32 id = quint32(m_sets.size());
+        m_sets.append(keywords);
+        m_ids.insert(keywords, id);
+        return id;
+    }
+
+    // The ID of a set interned before, without adding it; false if none
+    bool find(QStringList keywords, quint32& id) const {
+        id = 0;
+        if (keywords.isEmpty()) {
+            return true;
+        }
+        keywords.sort();
+        keywords.removeDuplicates();
+
+        QReadLocker locker(&m_lock);
+        auto it = m_ids.constFind(keywords);
+        if (it == m_ids.constEnd()) {
+            return false;
+        }
+        id = it.value();
+        return true;
+    }
+
+    QStringList keywords(quint32 id) const {
+        QReadLocker locker(&m_lock);
+        return id < quint32(m_sets.size()) ? m_sets.at(id) : QStringList();
+    }
+
+private:
+    KeywordSets() {
+        m_sets.append(QStringList());
+    }
+
+    mutable QReadWriteLock m_lock;
+    QList<QStringList> m_sets;          // Indexed by ID
+    QHash<QStringList, quint32> m_ids;
+};
+
+// Splits an IMAP flag list into system flag bits and keywords
+int splitFlags(const QStringList& flags, QStringList& keywords) {
+    int systemFlags = 0;
+    for (const QString& flag : flags) {
+        int bit = systemFlag(flag);
+        if (bit != 0) {
+            systemFlags |= bit;
+        } else if (!flag.isEmpty()) {
+            keywords.append(flag);
+        }
+    }
+    return systemFlags;
+}
+
+} // namespace
 
 EmailCard::EmailCard() 
-    : m_read(false)
-    , m_flagged(false)
+    : m_dateMSecs(kInvalidDate)
+    , m_uid(0)
+    , m_size(0)
+    , m_keywords(0)
+    , m_systemFlags(0)
+    , m_placeholder(false)
+    , m_utcOffsetMinutes(0)
 {
 }
 
 EmailCard::EmailCard(const QString& uid, const QString& subject, const QString& from, 
                      const QDateTime& date, const QString& body)
-    : m_uid(uid)
-    , m_subject(subject)
-    , m_from(from)
-    , m_date(date)
+    : m_subject(subject)
+    , m_from(StringPool::intern(from))
     , m_body(body)
-    , m_read(false)
-    , m_flagged(false)
+    , m_dateMSecs(kInvalidDate)
+    , m_uid(0)
+    , m_size(0)
+    , m_keywords(0)
+    , m_systemFlags(0)
+    , m_placeholder(false)
+    , m_utcOffsetMinutes(0)
 {
+    setUid(uid);
+    setDate(date);
 }
 
 QString EmailCard::uid() const {
-    return m_uid;
+    return m_uid != 0 ? QString::number(key()) : QString();
+}
+
+quint32 EmailCard::uidNumber() const {
+    return m_placeholder ? 0 : m_uid;
+}
+
+quint64 EmailCard::key() const {
+    return m_placeholder ? placeholderKey(m_uid) : m_uid;
+}
+
+bool EmailCard::isPlaceholder() const {
+    return m_placeholder;
 }
 
 QString EmailCard::subject() const {
@@ -27,35 +171,95 @@ QString EmailCard::subject() const {
 }
 
 QString EmailCard::from() const {
-    return m_from;
+    return m_from.toString();
 }
 
 QString EmailCard::to() const {
+    return m_to.toString();
+}
+
+InternedString EmailCard::fromInterned() const {
+    return m_from;
+}
+
+InternedString EmailCard::toInterned() const {
     return m_to;
 }
 
 QDateTime EmailCard::date() const {
-    return m_date;
+    if (m_dateMSecs == kInvalidDate) {
+        return QDateTime();
+    }
+    return QDateTime::fromMSecsSinceEpoch(m_dateMSecs, QTimeZone(m_utcOffsetMinutes * 60));
+}
+
+qint64 EmailCard::dateMSecs() const {
+    return m_dateMSecs;
 }
 
 QString EmailCard::body() const {
     return m_body;
 }
 
+qint64 EmailCard::size() const {
+    return m_size;
+}
+
 QStringList EmailCard::flags() const {
-    return m_flags;
+    QStringList flags;
+    for (const SystemFlagName& entry : kSystemFlags) {
+        if (m_systemFlags & entry.flag) {
+            flags.append(QLatin1String(entry.name));
+        }
+    }
+    if (m_keywords != 0) {
+        flags += KeywordSets::instance().keywords(m_keywords);
+    }
+    return flags;
+}
+
+int EmailCard::systemFlags() const {
+    return m_systemFlags;
+}
+
+bool EmailCard::hasFlag(const QString& flag) const {
+    int bit = systemFlag(flag);
+    if (bit != 0) {
+        return (m_systemFlags & bit) != 0;
+    }
+    return m_keywords != 0 && KeywordSets::instance().keywords(m_keywords).contains(flag);
+}
+
+bool EmailCard::hasSameFlags(const QStringList& flags) const {
+    QStringList keywords;
+    if (splitFlags(flags, keywords) != m_systemFlags) {
+        return false;
+    }
+    // A keyword set that was never interned is not the card's
+    quint32 id = 0;
+    return KeywordSets::instance().find(keywords, id) && id == m_keywords;
 }
 
 bool EmailCard::isRead() const {
-    return m_read;
+    return (m_systemFlags & Seen) != 0;
 }
 
 bool EmailCard::isFlagged() const {
-    return m_flagged;
+    return (m_systemFlags & Flagged) != 0;
 }
 
 void EmailCard::setUid(const QString& uid) {
+    setKey(uid.toULongLong());
+}
+
+void EmailCard::setUid(quint32 uid) {
     m_uid = uid;
+    m_placeholder = false;
+}
+
+void EmailCard::setKey(quint64 key) {
+    m_placeholder = isPlaceholderKey(key);
+    m_uid = quint32(m_placeholder ? key - kPlaceholderKeys + 1 : key);
 }
 
 void EmailCard::setSubject(const QString& subject) {
@@ -63,43 +267,43 @@ void EmailCard::setSubject(const QString& subject) {
 }
 
 void EmailCard::setFrom(const QString& from) {
-    m_from = from;
+    m_from = StringPool::intern(from);
 }
 
 void EmailCard::setTo(const QString& to) {
-    m_to = to;
+    m_to = StringPool::intern(to);
 }
 
 void EmailCard::setDate(const QDateTime& date) {
-    m_date = date;
+    if (!date.isValid()) {
+        m_dateMSecs = kInvalidDate;
+        m_utcOffsetMinutes = 0;
+        return;
+    }
+    m_dateMSecs = date.toMSecsSinceEpoch();
+    m_utcOffsetMinutes = qint16(date.offsetFromUtc() / 60);
 }
 
 void EmailCard::setBody(const QString& body) {
     m_body = body;
 }
 
+void EmailCard::setSize(qint64 size) {
+    m_size = quint32(qBound<qint64>(0, size, std::numeric_limits<quint32>::max()));
+}
+
 void EmailCard::setFlags(const QStringList& flags) {
-    m_flags = flags;
-    m_read = flags.contains("\\Seen");
-    m_flagged = flags.contains("\\Flagged");
+    QStringList keywords;
+    m_systemFlags = quint8(splitFlags(flags, keywords));
+    m_keywords = KeywordSets::instance().intern(keywords);
 }
 
 void EmailCard::setRead(bool read) {
-    m_read = read;
-    if (read && !m_flags.contains("\\Seen")) {
-        m_flags.append("\\Seen");
-    } else if (!read) {
-        m_flags.removeAll("\\Seen");
-    }
+    setSystemFlag(Seen, read);
 }
 
 void EmailCard::setFlagged(bool flagged) {
-    m_flagged = flagged;
-    if (flagged && !m_flags.contains("\\Flagged")) {
-        m_flags.append("\\Flagged");
-    } else if (!flagged) {
-        m_flags.removeAll("\\Flagged");
-    }
+    setSystemFlag(Flagged, flagged);
 }
 
 QString EmailCard::summary() const {
@@ -109,12 +313,46 @@ QString EmailCard::summary() const {
     }
     
     if (!m_from.isEmpty()) {
-        summary += QString(" - %1").arg(m_from);
+        summary += QString(" - %1").arg(m_from.toString());
     }
     
     return summary;
 }
 
 bool EmailCard::isValid() const {
-    return !m_uid.isEmpty();
-}
\ No newline at end of file
+    return m_uid != 0;
+}
+
+bool EmailCard::operator==(const EmailCard& other) const {
+    return m_uid == other.m_uid
+        && m_placeholder == other.m_placeholder
+        && m_dateMSecs == other.m_dateMSecs
+        && m_utcOffsetMinutes == other.m_utcOffsetMinutes
+        && m_systemFlags == other.m_systemFlags
+        && m_keywords == other.m_keywords
+        && m_size == other.m_size
+        && m_from == other.m_from
+        && m_to == other.m_to
+        && m_subject == other.m_subject
+        && m_body == other.m_body;
+}
+
+bool EmailCard::operator!=(const EmailCard& other) const {
+    return !(*this == other);
+}
+
+quint64 EmailCard::placeholderKey(quint32 number) {
+    return kPlaceholderKeys + number - 1;
+}
+
+bool EmailCard::isPlaceholderKey(quint64 key) {
+    return key >= kPlaceholderKeys;
+}
+
+void EmailCard::setSystemFlag(SystemFlag flag, bool set) {
+    if (set) {
+        m_systemFlags |= flag;
+    } else {
+        m_systemFlags &= ~flag;
+    }
+}
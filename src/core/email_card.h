@@ -1,33 +1,67 @@
 #pragma once
 
+#include "string_pool.h"
 #include <QString>
 #include <QDateTime>
 #include <QStringList>
 
+// One message on the board. Boards hold tens of thousands of cards, so the
+// layout is compact: the UID is numeric, system flags are a bitmask, custom
+// keywords are an interned set shared between cards, sender and recipients
+// are interned strings and the date is packed into milliseconds plus a UTC
+// offset.
+//
+// A card is identified by key(): its UID, or for a placeholder (a card
+// shown where it was moved before the server has given it a UID there) a
+// number above the 32-bit UID range, so the two never collide. uid() is the
+// key as text.
 class EmailCard {
 public:
+    // IMAP system flags (RFC 3501 section 2.3.2)
+    enum SystemFlag {
+        Seen = 0x01,
+        Answered = 0x02,
+        Flagged = 0x04,
+        Deleted = 0x08,
+        Draft = 0x10,
+        Recent = 0x20
+    };
+
     EmailCard();
     EmailCard(const QString& uid, const QString& subject, const QString& from, 
               const QDateTime& date, const QString& body = QString());
     
     // Getters
     QString uid() const;
+    quint32 uidNumber() const;  // 0 for a placeholder
+    quint64 key() const;
+    bool isPlaceholder() const;
     QString subject() const;
     QString from() const;
     QString to() const;
+    InternedString fromInterned() const;    // For comparisons by identity
+    InternedString toInterned() const;
     QDateTime date() const;
+    qint64 dateMSecs() const;   // Milliseconds since the epoch, for sorting
     QString body() const;
-    QStringList flags() const;
+    qint64 size() const;    // RFC822.SIZE in bytes
+    QStringList flags() const;  // System flags first, then keywords
+    int systemFlags() const;
+    bool hasFlag(const QString& flag) const;
+    bool hasSameFlags(const QStringList& flags) const;
     bool isRead() const;
     bool isFlagged() const;
     
     // Setters
-    void setUid(const QString& uid);
+    void setUid(const QString& uid);    // A key as text
+    void setUid(quint32 uid);
+    void setKey(quint64 key);
     void setSubject(const QString& subject);
     void setFrom(const QString& from);
     void setTo(const QString& to);
     void setDate(const QDateTime& date);
     void setBody(const QString& body);
+    void setSize(qint64 size);
     void setFlags(const QStringList& flags);
     void setRead(bool read);
     void setFlagged(bool flagged);
@@ -35,15 +69,25 @@ public:
     // Utility
     QString summary() const;
     bool isValid() const;
+    bool operator==(const EmailCard& other) const;
+    bool operator!=(const EmailCard& other) const;
+
+    // The key of the placeholder with this number (from 1), and back
+    static quint64 placeholderKey(quint32 number);
+    static bool isPlaceholderKey(quint64 key);
     
 private:
-    QString m_uid;
+    void setSystemFlag(SystemFlag flag, bool set);
+
     QString m_subject;
-    QString m_from;
-    QString m_to;
-    QDateTime m_date;
+    InternedString m_from;
+    InternedString m_to;
     QString m_body;
-    QStringList m_flags;
-    bool m_read;
-    bool m_flagged;
-};
\ No newline at end of file
+    qint64 m_dateMSecs;         // kInvalidDate when unset
+    quint32 m_uid;              // 0 when unset; the number of a placeholder
+    quint32 m_size;
+    quint32 m_keywords;         // Interned keyword set, 0 when empty
+    quint8 m_systemFlags;
+    bool m_placeholder;
+    qint16 m_utcOffsetMinutes;
+};
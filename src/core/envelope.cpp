@@ -0,0 +1,71 @@
+#include "envelope.h"
+#include <QStringList>
+
+namespace {
+
+QList<EnvelopeAddress> parseAddresses(const ImapValue& list) {
+    QList<EnvelopeAddress> addresses;
+    if (!list.isList()) {
+        return addresses;
+    }
+
+    for (const ImapValue& entry : list.values()) {
+        if (!entry.isList() || entry.size() != 4) {
+            continue;
+        }
+        // RFC 822 group syntax shows up as a NIL host: the group name opens
+        // the group and an all-NIL entry closes it. Only members are kept.
+        if (entry.at(3).isNil()) {
+            continue;
+        }
+        EnvelopeAddress address;
+        address.name = entry.at(0).toString();
+        address.mailbox = entry.at(2).toString();
+        address.host = entry.at(3).toString();
+        addresses.append(address);
+    }
+    return addresses;
+}
+
+} // namespace
+
+QString EnvelopeAddress::address() const {
+    if (host.isEmpty()) {
+        return mailbox;
+    }
+    return mailbox + '@' + host;
+}
+
+QString EnvelopeAddress::toString() const {
+    if (name.isEmpty()) {
+        return address();
+    }
+    return QString("%1 <%2>").arg(name, address());
+}
+
+bool Envelope::parse(const ImapValue& value, Envelope& envelope) {
+    // (date subject from sender reply-to to cc bcc in-reply-to message-id)
+    if (!value.isList() || value.size() != 10) {
+        return false;
+    }
+
+    envelope.date = value.at(0).toString();
+    envelope.subject = value.at(1).toString();
+    envelope.from = parseAddresses(value.at(2));
+    envelope.sender = parseAddresses(value.at(3));
+    envelope.replyTo = parseAddresses(value.at(4));
+    envelope.to = parseAddresses(value.at(5));
+    envelope.cc = parseAddresses(value.at(6));
+    envelope.bcc = parseAddresses(value.at(7));
+    envelope.inReplyTo = value.at(8).toString();
+    envelope.messageId = value.at(9).toString();
+    return true;
+}
+
+QString Envelope::formatAddresses(const QList<EnvelopeAddress>& addresses) {
+    QStringList formatted;
+    for (const EnvelopeAddress& address : addresses) {
+        formatted.append(address.toString());
+    }
+    return formatted.join(", ");
+}
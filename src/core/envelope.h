@@ -0,0 +1,36 @@
+#pragma once
+
+#include "imap_response_parser.h"
+#include <QList>
+#include <QString>
+
+// One entry of an ENVELOPE address list: ("Name" NIL "mailbox" "host")
+struct EnvelopeAddress {
+    QString name;
+    QString mailbox;
+    QString host;
+
+    QString address() const;   // mailbox@host
+    QString toString() const;  // "Name <mailbox@host>", or just the address
+};
+
+// The FETCH ENVELOPE item (RFC 3501 section 7.4.2) in structured form.
+// Strings are kept as the server sent them; NIL becomes an empty string.
+struct Envelope {
+    QString date;
+    QString subject;
+    QList<EnvelopeAddress> from;
+    QList<EnvelopeAddress> sender;
+    QList<EnvelopeAddress> replyTo;
+    QList<EnvelopeAddress> to;
+    QList<EnvelopeAddress> cc;
+    QList<EnvelopeAddress> bcc;
+    QString inReplyTo;
+    QString messageId;
+
+    // Returns false if the value is not a ten-field ENVELOPE list
+    static bool parse(const ImapValue& value, Envelope& envelope);
+
+    // Comma-separated display form of an address list
+    static QString formatAddresses(const QList<EnvelopeAddress>& addresses);
+};
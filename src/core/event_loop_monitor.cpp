@@ -0,0 +1,67 @@
+#include "event_loop_monitor.h"
+#include <algorithm>
+
+EventLoopMonitor::EventLoopMonitor(int intervalMs, QObject* parent)
+    : QObject(parent)
+    , m_timer(new QTimer(this))
+    , m_lastTickNs(0)
+{
+    m_timer->setInterval(qMax(1, intervalMs));
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &EventLoopMonitor::onTick);
+}
+
+void EventLoopMonitor::start() {
+    m_clock.start();
+    m_lastTickNs = 0;
+    m_timer->start();
+}
+
+void EventLoopMonitor::stop() {
+    m_timer->stop();
+}
+
+void EventLoopMonitor::reset() {
+    m_lagNs.clear();
+    if (m_clock.isValid()) {
+        m_lastTickNs = m_clock.nsecsElapsed();
+    }
+}
+
+int EventLoopMonitor::sampleCount() const {
+    return m_lagNs.size();
+}
+
+double EventLoopMonitor::averageLagMs() const {
+    if (m_lagNs.isEmpty()) {
+        return 0;
+    }
+    qint64 total = 0;
+    for (qint64 lag : m_lagNs) {
+        total += lag;
+    }
+    return total / 1e6 / m_lagNs.size();
+}
+
+double EventLoopMonitor::maxLagMs() const {
+    return m_lagNs.isEmpty() ? 0 : *std::max_element(m_lagNs.begin(), m_lagNs.end()) / 1e6;
+}
+
+double EventLoopMonitor::percentileLagMs(double fraction) const {
+    if (m_lagNs.isEmpty()) {
+        return 0;
+    }
+    QList<qint64> sorted = m_lagNs;
+    std::sort(sorted.begin(), sorted.end());
+    int index = qBound(0, int(fraction * sorted.size()), int(sorted.size()) - 1);
+    return sorted.at(index) / 1e6;
+}
+
+void EventLoopMonitor::onTick() {
+    const qint64 now = m_clock.nsecsElapsed();
+    const qint64 expected = qint64(m_timer->interval()) * 1000000;
+    if (m_lastTickNs > 0 || !m_lagNs.isEmpty()) {
+        m_lagNs.append(qMax<qint64>(0, now - m_lastTickNs - expected));
+    }
+    m_lastTickNs = now;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QTimer>
+
+// Measures how responsive the event loop of the current thread is: a timer
+// fires at a short interval and records how late each tick arrives. On the
+// GUI thread the lag is the delay a click or a repaint would have seen.
+class EventLoopMonitor : public QObject {
+    Q_OBJECT
+
+public:
+    explicit EventLoopMonitor(int intervalMs = 5, QObject* parent = nullptr);
+
+    void start();
+    void stop();
+    void reset();
+
+    int sampleCount() const;
+    double averageLagMs() const;
+    double maxLagMs() const;
+    // Lag that the given share of ticks stayed under, e.g. 0.99
+    double percentileLagMs(double fraction) const;
+
+private slots:
+    void onTick();
+
+private:
+    QTimer* m_timer;
+    QElapsedTimer m_clock;
+    qint64 m_lastTickNs;
+    QList<qint64> m_lagNs;
+};
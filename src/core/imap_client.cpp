@@ -1,16 +1,120 @@
 #include "imap_client.h"
+#include "envelope.h"
+#include "sequence_set.h"
+#include "string_pool.h"
 #include <QDebug>
-#include <QRegularExpression>
-#include <QEventLoop>
 #include <QTimer>
+#include <algorithm>
+
+namespace {
+
+const int kResponseTimeoutMs = 30000;
+// Servers may drop an IDLE connection after 30 minutes (RFC 2177)
+const int kIdleRenewMs = 28 * 60 * 1000;
+// Everything a card shows, without downloading the full header block.
+// BODY.PEEK leaves \Seen alone.
+const char* const kEnvelopeFetchItems = "(UID FLAGS INTERNALDATE RFC822.SIZE ENVELOPE)";
+const char* const kHeaderFieldsFetchItems =
+    "(UID FLAGS INTERNALDATE RFC822.SIZE BODY.PEEK[HEADER.FIELDS (FROM TO SUBJECT DATE)])";
+
+// Raise UIDNEXT and HIGHESTMODSEQ to cover one FETCH response. Returns the
+// message UID, or 0 if the response carries none.
+quint32 advanceSyncState(const ImapValue& data, MailboxSyncState& state) {
+    quint32 uid = quint32(data.value("UID").toNumber());
+    if (uid == 0) {
+        return 0;
+    }
+
+    // MODSEQ (9071)
+    const ImapValue& modSeq = data.value("MODSEQ");
+    if (modSeq.size() > 0) {
+        state.highestModSeq = qMax(state.highestModSeq, modSeq.at(0).toNumber());
+    }
+    state.uidNext = qMax(state.uidNext, uid + 1);
+    return uid;
+}
+
+QByteArray describeResponse(const ImapResponse& response) {
+    if (response.kind == ImapResponse::Continuation) {
+        return "+ " + response.text;
+    }
+    QByteArray line = response.kind == ImapResponse::Tagged ? response.tag : QByteArray("*");
+    if (response.number >= 0) {
+        line += ' ' + QByteArray::number(response.number);
+    }
+    line += ' ' + response.name;
+    if (!response.code.isEmpty()) {
+        line += " [" + response.code + ']';
+    }
+    if (!response.text.isEmpty()) {
+        line += ' ' + response.text;
+    }
+    if (response.fields.size() > 0) {
+        line += " (" + QByteArray::number(response.fields.size()) + " fields)";
+    }
+    return line;
+}
+
+// Value following a result option in ESEARCH data:
+// (TAG "A5") UID COUNT 12 PARTIAL (-1:-50 3:7)
+const ImapValue& searchResult(const ImapValue& fields, const QByteArray& name) {
+    for (int i = 0; i + 1 < fields.size(); ++i) {
+        const ImapValue& option = fields.at(i);
+        if (option.isAtom() && qstricmp(option.data().constData(), name.constData()) == 0) {
+            return fields.at(i + 1);
+        }
+    }
+    static const ImapValue nil;
+    return nil;
+}
+
+// The UIDs of a THREAD branch, depth first: (3 6 (4 23)(44 7 96))
+void collectThread(const ImapValue& branch, QList<quint32>& uids) {
+    if (!branch.isList()) {
+        uids.append(quint32(branch.toNumber()));
+        return;
+    }
+    for (const ImapValue& node : branch.values()) {
+        collectThread(node, uids);
+    }
+}
+
+// A parenthesized flag list, e.g. (\Seen $Label1). The same few flags recur
+// on every message, so they come from the string pool.
+QStringList parseFlagList(const ImapValue& flags) {
+    QStringList parsed;
+    parsed.reserve(flags.size());
+    for (const ImapValue& flag : flags.values()) {
+        parsed.append(StringPool::internString(flag.toString()));
+    }
+    return parsed;
+}
+
+} // namespace
 
 ImapClient::ImapClient(QObject* parent)
     : QObject(parent)
     , m_socket(new QSslSocket(this))
+    , m_responseTimer(new QTimer(this))
     , m_state(Disconnected)
+    , m_readOnly(false)
+    , m_queuedReadOnly(false)
     , m_tagCounter(0)
+    , m_pipelineDepth(8)
+    , m_cardWindow(0)
+    , m_awaitingGreeting(false)
+    , m_qresyncEnabled(false)
+    , m_syncStates(std::make_shared<MailboxSyncStates>())
+    , m_sequenceLoaded(false)
+    , m_pushedRefresh(false)
+    , m_notifyActive(false)
+    , m_idleTimer(new QTimer(this))
+    , m_idling(false)
+    , m_idleRefreshRequested(false)
     , m_port(993)
     , m_useSSL(true)
+    , m_fetchHeaderFields(false)
+    , m_expungeAll(false)
 {
     // Defensive: ensure m_socket is valid
 #ifdef QT_DEBUG
@@ -24,6 +128,16 @@ ImapClient::ImapClient(QObject* parent)
             this, &ImapClient::onSocketError);
     connect(m_socket, &QSslSocket::sslErrors, this, &ImapClient::onSslErrors);
     connect(m_socket, &QSslSocket::readyRead, this, &ImapClient::onReadyRead);
+
+    m_responseTimer->setSingleShot(true);
+    m_responseTimer->setInterval(kResponseTimeoutMs);
+    connect(m_responseTimer, &QTimer::timeout, this, &ImapClient::onResponseTimeout);
+
+    m_idleTimer->setSingleShot(true);
+    m_idleTimer->setInterval(kIdleRenewMs);
+    connect(m_idleTimer, &QTimer::timeout, this, &ImapClient::onIdleRenewTimeout);
+
+    m_pushedChanges.fullResync = false;
 }
 
 ImapClient::~ImapClient() {
@@ -38,6 +152,10 @@ void ImapClient::connectToServer(const Settings& settings) {
     m_server = settings.imapServer();
     m_port = settings.imapPort();
     m_useSSL = settings.useSSL();
+    m_pipelineDepth = settings.pipelineDepth();
+    m_fetchHeaderFields = settings.fetchHeaderFields();
+    m_expungeAll = settings.expungeAll();
+    m_cardWindow = settings.cardWindow();
     
     if (m_server.isEmpty()) {
         m_lastError = "No IMAP server configured";
@@ -48,6 +166,10 @@ void ImapClient::connectToServer(const Settings& settings) {
 
     m_state = Connecting;
     m_lastError.clear();
+    m_parser.clear();
+    m_capabilities.clear();
+    m_qresyncEnabled = false;
+    m_notifyActive = false;
     
     if (m_useSSL) {
         m_socket->connectToHostEncrypted(m_server, m_port);
@@ -58,14 +180,21 @@ void ImapClient::connectToServer(const Settings& settings) {
 
 void ImapClient::disconnectFromServer() {
     if (m_socket->state() != QAbstractSocket::UnconnectedState) {
-        sendCommand("LOGOUT");
+        if (m_state != Connecting) {
+            leaveIdle();
+            sendCommand(generateTag() + " LOGOUT");
+        }
         m_socket->disconnectFromHost();
         if (m_socket->state() != QAbstractSocket::UnconnectedState) {
             m_socket->waitForDisconnected(3000);
         }
     }
+    failAllCommands("Disconnected from server");
     m_state = Disconnected;
     m_currentMailbox.clear();
+    m_queuedMailbox.clear();
+    m_sequence.reset();
+    m_mailboxStatus.clear();
 }
 
 ImapClient::State ImapClient::state() const {
@@ -83,145 +212,523 @@ void ImapClient::authenticate(const QString& username, const QString& password)
         return;
     }
 
-    if (loginCommand(username, password)) {
-        m_state = Authenticated;
-        emit authenticated();
-    } else {
-        m_state = Error;
-        emit error(m_lastError);
-    }
+    loginCommand(username, password, [this](bool ok) {
+        if (ok) {
+            m_state = Authenticated;
+            enableExtensions([this]() {
+                emit authenticated();
+            });
+        } else {
+            m_state = Error;
+            emit error(m_lastError);
+        }
+    });
 }
 
-QStringList ImapClient::listMailboxes() {
-    if (m_state != Authenticated && m_state != Selected) {
-        qDebug() << "IMAP LIST: Not authenticated or selected.";
-        return QStringList();
-    }
-    QStringList mailboxes = listCommand();
-    qDebug() << "IMAP LIST: Top-level mailboxes:" << mailboxes;
-    // Recursively traverse mailboxes
-    QSet<QString> allMailboxes;
-    std::function<void(const QString&)> traverse;
-    traverse = [&](const QString& parent) {
-        QString tag = generateTag();
-        QString command = QString("%1 LIST \"%2\" \"*\"").arg(tag, parent);
-        sendCommand(command);
-        QStringList responses = readMultilineResponse();
-        for (const QString& response : responses) {
-            if (response.startsWith("*") && response.contains("LIST")) {
-                QRegularExpression re("\\* LIST \\([^)]*\\) \"[^\"]*\" \"([^\"]+)\"");
-                QRegularExpressionMatch match = re.match(response);
-                if (match.hasMatch()) {
-                    QString mailbox = match.captured(1);
-                    if (!allMailboxes.contains(mailbox)) {
-                        allMailboxes.insert(mailbox);
-                        qDebug() << "IMAP RECURSIVE MAILBOX:" << mailbox;
-                        // Traverse children if not already traversed
-                        traverse(mailbox);
-                    }
-                }
+bool ImapClient::hasCapability(const QString& capability) const {
+    return m_capabilities.contains(capability.toUpper().toLatin1());
+}
+
+bool ImapClient::qresyncEnabled() const {
+    return m_qresyncEnabled;
+}
+
+QString ImapClient::execute(const QString& command, CommandCallback callback) {
+    PendingCommand pending;
+    pending.tag = generateTag();
+    pending.command = command;
+    pending.kind = classifyCommand(command);
+    pending.callback = callback;
+    m_queue.append(pending);
+
+    // IDLE occupies the connection until DONE is sent
+    leaveIdle();
+    processQueue();
+    return pending.tag;
+}
+
+int ImapClient::pipelineDepth() const {
+    return m_pipelineDepth;
+}
+
+void ImapClient::setPipelineDepth(int depth) {
+    m_pipelineDepth = qMax(1, depth);
+    processQueue();
+}
+
+int ImapClient::cardWindow() const {
+    return m_cardWindow;
+}
+
+void ImapClient::setCardWindow(int cards) {
+    m_cardWindow = qMax(0, cards);
+}
+
+void ImapClient::listMailboxes(MailboxesCallback callback) {
+    listMailboxInfo([callback](bool ok, const QList<MailboxInfo>& mailboxes) {
+        QStringList names;
+        for (const MailboxInfo& info : mailboxes) {
+            if (info.isSelectable()) {
+                names.append(info.name);
             }
         }
-    };
-    for (const QString& mailbox : mailboxes) {
-        allMailboxes.insert(mailbox);
-        traverse(mailbox);
+        if (callback) {
+            callback(ok, names);
+        }
+    });
+}
+
+void ImapClient::listMailboxInfo(MailboxInfoCallback callback) {
+    if (!isAuthenticated()) {
+        qDebug() << "IMAP LIST: Not authenticated or selected.";
+        if (callback) {
+            callback(false, QList<MailboxInfo>());
+        }
+        return;
+    }
+
+    // "*" matches every level of the hierarchy, so one LIST finds everything
+    if (hasCapability("LIST-STATUS")) {
+        listCommand(QString("RETURN (STATUS %1)").arg(statusItems(true)), callback);
+        return;
     }
-    qDebug() << "IMAP ALL MAILBOXES:" << allMailboxes.values();
-    return allMailboxes.values();
+
+    listCommand(QString(), [this, callback](bool ok, const QList<MailboxInfo>& mailboxes) {
+        if (!ok) {
+            if (callback) {
+                callback(false, mailboxes);
+            }
+            return;
+        }
+        statusBatch(mailboxes, callback);
+    });
 }
 
-bool ImapClient::selectMailbox(const QString& mailbox) {
-    if (m_state != Authenticated && m_state != Selected) {
-        return false;
+void ImapClient::selectMailbox(const QString& mailbox, ResultCallback callback) {
+    if (!isAuthenticated()) {
+        if (callback) {
+            callback(false);
+        }
+        return;
     }
-    
-    if (selectCommand(mailbox)) {
-        m_currentMailbox = mailbox;
-        m_state = Selected;
-        emit mailboxSelected(mailbox);
-        return true;
+
+    // Nothing to send if it is selected read-write and stays so
+    if (m_currentMailbox == mailbox && !m_readOnly && m_queuedMailbox == mailbox && !m_queuedReadOnly) {
+        if (callback) {
+            callback(true);
+        }
+        return;
     }
-    return false;
+    selectCommand(mailbox, false, callback);
 }
 
 QString ImapClient::currentMailbox() const {
     return m_currentMailbox;
 }
 
-QList<EmailCard> ImapClient::fetchCards(const QString& mailbox) {
-    QString targetMailbox = mailbox.isEmpty() ? m_currentMailbox : mailbox;
+bool ImapClient::isReadOnly() const {
+    return m_readOnly;
+}
+
+bool ImapClient::unselectMailbox(ResultCallback callback) {
+    if (!isAuthenticated() || m_queuedMailbox.isEmpty()) {
+        return false;
+    }
+
+    // CLOSE expunges a mailbox selected read-write, so it is only a
+    // substitute after EXAMINE
+    QString command;
+    if (hasCapability("UNSELECT")) {
+        command = "UNSELECT";
+    } else if (m_queuedReadOnly) {
+        command = "CLOSE";
+    } else {
+        return false;
+    }
+
+    m_queuedMailbox.clear();
+    execute(command, [this, callback](const ImapCommandResult& result) {
+        if (result.ok) {
+            m_currentMailbox.clear();
+            m_selectedState = MailboxSyncState();
+            m_sequence.reset();
+            if (m_state == Selected) {
+                m_state = Authenticated;
+            }
+        } else if (m_queuedMailbox.isEmpty()) {
+            // Still selected, unless a later command selected another
+            m_queuedMailbox = m_currentMailbox;
+            m_queuedReadOnly = m_readOnly;
+        }
+        if (callback) {
+            callback(result.ok);
+        }
+    });
+    return true;
+}
+
+void ImapClient::fetchCards(const QString& mailbox, CardsCallback callback) {
+    QString targetMailbox = mailbox.isEmpty() ? m_queuedMailbox : mailbox;
     
-    if (!targetMailbox.isEmpty() && targetMailbox != m_currentMailbox) {
-        if (!selectMailbox(targetMailbox)) {
-            return QList<EmailCard>();
+    if (!isAuthenticated() || targetMailbox.isEmpty()) {
+        if (callback) {
+            callback(false, QList<EmailCard>());
         }
+        return;
     }
     
-    if (m_state != Selected) {
-        return QList<EmailCard>();
-    }
+    // Commands run in order, so the FETCH can be pipelined right behind the
+    // EXAMINE. It is a UID FETCH because sequence-number commands may not be
+    // sent while the EXAMINE is still outstanding.
+    ensureSelected(targetMailbox, true);
     
-    return fetchCommand();
+    fetchCommand("1:*", true, callback);
 }
 
-EmailCard ImapClient::fetchCard(const QString& uid, const QString& mailbox) {
-    QString targetMailbox = mailbox.isEmpty() ? m_currentMailbox : mailbox;
-    
-    if (!targetMailbox.isEmpty() && targetMailbox != m_currentMailbox) {
-        if (!selectMailbox(targetMailbox)) {
-            return EmailCard();
+void ImapClient::syncCards(const QString& mailbox, ChangesCallback callback) {
+    if (!isAuthenticated() || mailbox.isEmpty()) {
+        if (callback) {
+            callback(false, MailboxChanges());
+        }
+        return;
+    }
+
+    MailboxSyncState known = m_syncStates->value(mailbox);
+    if (m_qresyncEnabled && known.canResync()) {
+        deltaSync(mailbox, known, callback);
+    } else {
+        fullSync(mailbox, callback);
+    }
+}
+
+MailboxSyncState ImapClient::syncState(const QString& mailbox) const {
+    return m_syncStates->value(mailbox);
+}
+
+void ImapClient::setSyncStates(std::shared_ptr<MailboxSyncStates> states) {
+    m_syncStates = states ? states : std::make_shared<MailboxSyncStates>();
+}
+
+void ImapClient::startIdle(const QString& mailbox) {
+    m_idleMailbox = mailbox;
+    if (m_idling) {
+        // Restart on the new mailbox once the server has ended the old IDLE
+        if (m_currentMailbox != mailbox) {
+            leaveIdle();
+        }
+    } else if (!isBusy()) {
+        enterIdle();
+    }
+}
+
+void ImapClient::stopIdle() {
+    m_idleMailbox.clear();
+    leaveIdle();
+}
+
+QString ImapClient::idleMailbox() const {
+    return m_idleMailbox;
+}
+
+bool ImapClient::isIdling() const {
+    return m_idling;
+}
+
+bool ImapClient::watchMailboxes(const QStringList& mailboxes) {
+    if (!isAuthenticated() || !hasCapability("NOTIFY")) {
+        return false;
+    }
+
+    if (mailboxes.isEmpty()) {
+        if (m_notifyActive) {
+            execute("NOTIFY NONE");
+        }
+        m_notifyActive = false;
+        return true;
+    }
+
+    QStringList quoted;
+    for (const QString& mailbox : mailboxes) {
+        quoted.append(QString("\"%1\"").arg(mailbox));
+    }
+    // STATUS makes the server report the current state of each mailbox first
+    QString command = QString("NOTIFY SET STATUS (selected (MessageNew MessageExpunge FlagChange))"
+                              " (mailboxes (%1) (MessageNew MessageExpunge FlagChange))")
+        .arg(quoted.join(' '));
+
+    m_notifyActive = true;
+    execute(command, [this](const ImapCommandResult& result) {
+        if (!result.ok) {
+            qDebug() << "IMAP NOTIFY failed:" << result.errorMessage;
+            m_notifyActive = false;
         }
+    });
+    return true;
+}
+
+bool ImapClient::isWatching() const {
+    return m_notifyActive;
+}
+
+void ImapClient::pollStatus(const QStringList& mailboxes) {
+    if (!isAuthenticated()) {
+        return;
+    }
+
+    if (m_notifyActive) {
+        // Events are already on their way; give the server a chance to send
+        // them unless an IDLE is receiving them anyway
+        if (!m_idling && !isBusy()) {
+            execute("NOOP");
+        }
+        return;
+    }
+
+    const QString items = statusItems(false);
+    for (const QString& mailbox : mailboxes) {
+        execute(QString("STATUS \"%1\" %2").arg(mailbox, items));
     }
+}
+
+void ImapClient::fetchCard(const QString& uid, const QString& mailbox, CardsCallback callback) {
+    QString targetMailbox = mailbox.isEmpty() ? m_queuedMailbox : mailbox;
     
-    if (m_state != Selected) {
-        return EmailCard();
+    if (!isAuthenticated() || targetMailbox.isEmpty()) {
+        if (callback) {
+            callback(false, QList<EmailCard>());
+        }
+        return;
     }
     
-    QList<EmailCard> cards = fetchCommand(uid);
-    return cards.isEmpty() ? EmailCard() : cards.first();
+    ensureSelected(targetMailbox, true);
+    fetchCommand(uid, true, callback);
 }
 
-bool ImapClient::moveCard(const QString& uid, const QString& fromMailbox, const QString& toMailbox) {
-    if (!selectMailbox(fromMailbox)) {
-        return false;
+void ImapClient::fetchOlderCards(const QString& mailbox, quint32 beforeUid, int loaded, int count,
+                                 CardsCallback callback) {
+    const bool sorted = hasCapability("SORT");
+    if (!isAuthenticated() || mailbox.isEmpty() || count <= 0 || (!sorted && beforeUid <= 1)) {
+        if (callback) {
+            callback(isAuthenticated(), QList<EmailCard>());
+        }
+        return;
+    }
+
+    ensureSelected(mailbox, true);
+
+    if (sorted) {
+        // The window was taken the same way (see fullSync())
+        sortCommand(qMax(0, loaded), count, [this, mailbox, callback](bool ok, const QList<quint32>& uids) {
+            fetchPage(mailbox, ok, uids, callback);
+        });
+        return;
+    }
+
+    // Messages are numbered in UID order, so "older than the oldest loaded
+    // card" is a UID range whose last count members make up the page
+    const QString older = QString("UID 1:%1").arg(beforeUid - 1);
+
+    if (hasCapability("PARTIAL")) {
+        // * ESEARCH (TAG "A5") UID PARTIAL (-1:-50 2001:2050)
+        QString command = QString("UID SEARCH RETURN (PARTIAL -1:-%1) %2").arg(count).arg(older);
+        execute(command, [this, mailbox, callback](const ImapCommandResult& result) {
+            QList<quint32> uids;
+            for (const ImapResponse& response : result.untagged) {
+                if (response.name == "ESEARCH") {
+                    uids = SequenceSet::parse(searchResult(response.fields, "PARTIAL").at(1).data());
+                }
+            }
+            fetchPage(mailbox, result.ok, uids, callback);
+        });
+    } else if (hasCapability("ESEARCH")) {
+        // * ESEARCH (TAG "A5") UID COUNT 2050: the page is messages 2001:2050
+        QString command = QString("UID SEARCH RETURN (COUNT) %1").arg(older);
+        execute(command, [this, mailbox, count, callback](const ImapCommandResult& result) {
+            quint32 older = 0;
+            for (const ImapResponse& response : result.untagged) {
+                if (response.name == "ESEARCH") {
+                    older = quint32(searchResult(response.fields, "COUNT").toNumber());
+                }
+            }
+            if (!result.ok || older == 0) {
+                if (callback) {
+                    callback(result.ok, QList<EmailCard>());
+                }
+                return;
+            }
+            ensureSelected(mailbox, true);
+            quint32 first = older > quint32(count) ? older - quint32(count) + 1 : 1;
+            fetchCommand(QString("%1:%2").arg(first).arg(older), false, callback);
+        });
+    } else {
+        // * SEARCH 2 5 9 ...: every older UID, of which the last count are kept
+        execute(QString("UID SEARCH %1").arg(older), [this, mailbox, count, callback](const ImapCommandResult& result) {
+            QList<quint32> uids;
+            for (const ImapResponse& response : result.untagged) {
+                if (response.name == "SEARCH") {
+                    for (const ImapValue& uid : response.fields.values()) {
+                        uids.append(quint32(uid.toNumber()));
+                    }
+                }
+            }
+            std::sort(uids.begin(), uids.end());
+            fetchPage(mailbox, result.ok, uids.mid(qMax(0, uids.size() - count)), callback);
+        });
+    }
+}
+
+void ImapClient::findUids(const QString& mailbox, const QString& uids, UidsCallback callback) {
+    if (!isAuthenticated() || mailbox.isEmpty() || uids.isEmpty()) {
+        if (callback) {
+            callback(false, 0, QList<quint32>());
+        }
+        return;
+    }
+
+    // Selected read-write, as the cards found are acted on next. The search
+    // completes after the selection it depends on, so the selected state
+    // then has the mailbox's UIDVALIDITY.
+    ensureSelected(mailbox, false);
+    execute(QString("UID SEARCH UID %1").arg(uids), [this, mailbox, callback](const ImapCommandResult& result) {
+        const quint32 uidValidity = m_currentMailbox == mailbox ? m_selectedState.uidValidity : 0;
+        QList<quint32> found;
+        for (const ImapResponse& response : result.untagged) {
+            if (response.name == "SEARCH") {
+                for (const ImapValue& uid : response.fields.values()) {
+                    found.append(quint32(uid.toNumber()));
+                }
+            }
+        }
+        if (callback) {
+            callback(result.ok && uidValidity != 0, uidValidity, found);
+        }
+    });
+}
+
+void ImapClient::fetchThreads(const QString& mailbox, ThreadsCallback callback) {
+    QString algorithm;
+    if (hasCapability("THREAD=REFERENCES")) {
+        algorithm = "REFERENCES";
+    } else if (hasCapability("THREAD=ORDEREDSUBJECT")) {
+        algorithm = "ORDEREDSUBJECT";
+    }
+    if (!isAuthenticated() || mailbox.isEmpty() || algorithm.isEmpty()) {
+        if (callback) {
+            callback(false, QList<QList<quint32>>());
+        }
+        return;
+    }
+
+    ensureSelected(mailbox, true);
+    execute(QString("UID THREAD %1 UTF-8 ALL").arg(algorithm), [callback](const ImapCommandResult& result) {
+        // * THREAD (2)(3 6 (4 23)(44 7 96)): a list per conversation, with
+        // the replies as nested branches
+        QList<QList<quint32>> threads;
+        for (const ImapResponse& response : result.untagged) {
+            if (response.name != "THREAD") {
+                continue;
+            }
+            for (const ImapValue& thread : response.fields.values()) {
+                QList<quint32> uids;
+                collectThread(thread, uids);
+                threads.append(uids);
+            }
+        }
+        if (callback) {
+            callback(result.ok, threads);
+        }
+    });
+}
+
+void ImapClient::fetchPage(const QString& mailbox, bool ok, const QList<quint32>& uids, CardsCallback callback) {
+    if (!ok || uids.isEmpty()) {
+        if (callback) {
+            callback(ok, QList<EmailCard>());
+        }
+        return;
+    }
+
+    QStringList set;
+    for (quint32 uid : uids) {
+        set.append(QString::number(uid));
+    }
+    ensureSelected(mailbox, true);
+    fetchCommand(set.join(','), true, callback);
+}
+
+void ImapClient::moveCard(const QString& uid, const QString& fromMailbox, const QString& toMailbox,
+                          MoveCallback callback) {
+    if (!isAuthenticated()) {
+        if (callback) {
+            callback(false, QHash<quint32, quint32>());
+        }
+        return;
     }
     
-    return moveCommand(uid, toMailbox);
+    ensureSelected(fromMailbox, false);
+    moveCommand(uid, toMailbox, callback);
 }
 
-bool ImapClient::deleteCard(const QString& uid, const QString& mailbox) {
-    QString targetMailbox = mailbox.isEmpty() ? m_currentMailbox : mailbox;
+void ImapClient::deleteCard(const QString& uid, const QString& mailbox, ResultCallback callback) {
+    QString targetMailbox = mailbox.isEmpty() ? m_queuedMailbox : mailbox;
     
-    if (!selectMailbox(targetMailbox)) {
-        return false;
+    if (!isAuthenticated() || targetMailbox.isEmpty()) {
+        if (callback) {
+            callback(false);
+        }
+        return;
     }
     
-    // Mark as deleted and expunge
-    if (storeCommand(uid, "\\Deleted", true)) {
-        return expungeCommand();
+    ensureSelected(targetMailbox, false);
+    
+    // Mark as deleted and expunge. Without UIDPLUS only a plain EXPUNGE
+    // would do, which takes every message flagged \Deleted with it: unless
+    // the user opted in, the message stays flagged instead.
+    const bool expunge = hasCapability("UIDPLUS") || m_expungeAll;
+    auto stored = std::make_shared<bool>(false);
+    storeCommand(uid, "\\Deleted", true, [stored, expunge, callback](bool ok) {
+        *stored = ok;
+        if (!expunge && callback) {
+            callback(ok);
+        }
+    });
+    if (!expunge) {
+        return;
     }
-    return false;
+    expungeCommand(uid, [stored, callback](bool ok) {
+        if (callback) {
+            callback(*stored && ok);
+        }
+    });
 }
 
-bool ImapClient::markAsRead(const QString& uid, bool read, const QString& mailbox) {
-    QString targetMailbox = mailbox.isEmpty() ? m_currentMailbox : mailbox;
+void ImapClient::markAsRead(const QString& uid, bool read, const QString& mailbox, ResultCallback callback) {
+    QString targetMailbox = mailbox.isEmpty() ? m_queuedMailbox : mailbox;
     
-    if (!selectMailbox(targetMailbox)) {
-        return false;
+    if (!isAuthenticated() || targetMailbox.isEmpty()) {
+        if (callback) {
+            callback(false);
+        }
+        return;
     }
     
-    return storeCommand(uid, "\\Seen", read);
+    ensureSelected(targetMailbox, false);
+    storeCommand(uid, "\\Seen", read, callback);
 }
 
-bool ImapClient::markAsFlagged(const QString& uid, bool flagged, const QString& mailbox) {
-    QString targetMailbox = mailbox.isEmpty() ? m_currentMailbox : mailbox;
+void ImapClient::markAsFlagged(const QString& uid, bool flagged, const QString& mailbox,
+                               ResultCallback callback) {
+    QString targetMailbox = mailbox.isEmpty() ? m_queuedMailbox : mailbox;
     
-    if (!selectMailbox(targetMailbox)) {
-        return false;
+    if (!isAuthenticated() || targetMailbox.isEmpty()) {
+        if (callback) {
+            callback(false);
+        }
+        return;
     }
     
-    return storeCommand(uid, "\\Flagged", flagged);
+    ensureSelected(targetMailbox, false);
+    storeCommand(uid, "\\Flagged", flagged, callback);
 }
 
 bool ImapClient::isConnected() const {
@@ -232,25 +739,35 @@ bool ImapClient::isAuthenticated() const {
     return m_state == Authenticated || m_state == Selected;
 }
 
+int ImapClient::pendingCommands() const {
+    int count = m_queue.size() + m_inFlight.size();
+    if (!m_inFlight.isEmpty() && m_inFlight.first().tag == m_idleTag) {
+        --count;
+    }
+    return count;
+}
+
+bool ImapClient::isBusy() const {
+    // An IDLE waiting for pushed data does not count as work
+    return !m_queue.isEmpty() || (!m_inFlight.isEmpty() && m_inFlight.first().tag != m_idleTag);
+}
+
 void ImapClient::onSocketConnected() {
     m_state = Connected;
     
-    // Read server greeting
-    if (waitForResponse()) {
-        QString response = readResponse();
-        if (response.startsWith("* OK")) {
-            emit connected();
-        } else {
-            m_lastError = "Server greeting failed: " + response;
-            m_state = Error;
-            emit error(m_lastError);
-        }
-    }
+    // The server greeting arrives as the first untagged response
+    m_awaitingGreeting = true;
+    m_responseTimer->start();
 }
 
 void ImapClient::onSocketDisconnected() {
+    failAllCommands("Connection closed");
     m_state = Disconnected;
+    m_awaitingGreeting = false;
     m_currentMailbox.clear();
+    m_queuedMailbox.clear();
+    m_sequence.reset();
+    m_mailboxStatus.clear();
     emit disconnected();
 }
 
@@ -259,6 +776,7 @@ void ImapClient::onSocketError(QAbstractSocket::SocketError error) {
     m_lastError = m_socket->errorString();
     qDebug() << "IMAP SOCKET ERROR:" << m_lastError;
     m_state = Error;
+    failAllCommands(m_lastError);
     emit this->error(m_lastError);
 }
 
@@ -275,7 +793,31 @@ void ImapClient::onSslErrors(const QList<QSslError>& errors) {
 }
 
 void ImapClient::onReadyRead() {
-    m_responseBuffer += m_socket->readAll();
+    m_parser.feed(m_socket->readAll());
+
+    if ((!m_inFlight.isEmpty() && !m_idling) || m_awaitingGreeting) {
+        m_responseTimer->start();
+    }
+
+    ImapResponse response;
+    while (m_parser.next(response)) {
+        qDebug() << "IMAP RECV:" << describeResponse(response);
+        handleResponse(response);
+    }
+    flushPushedChanges();
+}
+
+void ImapClient::onResponseTimeout() {
+    m_lastError = "Timed out waiting for server response";
+    qDebug() << "IMAP ERROR:" << m_lastError;
+    failAllCommands(m_lastError);
+    emit error(m_lastError);
+    m_socket->abort();
+}
+
+void ImapClient::onIdleRenewTimeout() {
+    // Ending the IDLE makes processQueue() issue a fresh one
+    leaveIdle();
 }
 
 void ImapClient::sendCommand(const QString& command) {
@@ -285,261 +827,1043 @@ void ImapClient::sendCommand(const QString& command) {
     m_socket->flush();
 }
 
-QString ImapClient::readResponse() {
-    if (!waitForResponse()) {
-        qDebug() << "IMAP ERROR: No response received.";
-        return QString();
+void ImapClient::processQueue() {
+    if (m_awaitingGreeting || m_socket->state() != QAbstractSocket::ConnectedState) {
+        return;
+    }
+
+    // Write queued commands back to back while the pipeline has room; the
+    // server answers them in order and tagged replies are matched by tag
+    while (!m_queue.isEmpty() && canSend(m_queue.first())) {
+        PendingCommand command = m_queue.takeFirst();
+        sendCommand(command.tag + ' ' + command.command);
+        m_inFlight.append(command);
+        m_responseTimer->start();
     }
-    int endIndex = m_responseBuffer.indexOf("\r\n");
-    if (endIndex == -1) {
-        qDebug() << "IMAP ERROR: Malformed response.";
-        return QString();
+
+    if (m_queue.isEmpty() && m_inFlight.isEmpty()) {
+        enterIdle();
     }
-    QString response = m_responseBuffer.left(endIndex);
-    m_responseBuffer.remove(0, endIndex + 2);
-    qDebug() << "IMAP RECV:" << response;
-    return response;
 }
 
-QStringList ImapClient::readMultilineResponse() {
-    QStringList responses;
-    while (true) {
-        QString response = readResponse();
-        if (response.isEmpty()) {
-            break;
+bool ImapClient::canSend(const PendingCommand& command) const {
+    if (m_inFlight.isEmpty()) {
+        return true;
+    }
+    if (m_inFlight.size() >= m_pipelineDepth || command.kind == Barrier) {
+        return false;
+    }
+
+    for (const PendingCommand& inFlight : m_inFlight) {
+        if (inFlight.kind == Barrier) {
+            return false;
         }
-        responses.append(response);
-        // Check if this is the final response (tagged response)
-    if (response.contains(QRegularExpression("^A\\d+ (OK|NO|BAD)"))) {
-            break;
+        // Message numbers are only stable while nothing that may expunge runs
+        if (command.kind == SequenceNumbers && inFlight.kind != SequenceNumbers) {
+            return false;
         }
     }
-    qDebug() << "IMAP MULTILINE RECV:" << responses;
-    return responses;
+    return true;
 }
 
-bool ImapClient::waitForResponse(int timeoutMs) {
-    QEventLoop loop;
-    QTimer timer;
-    timer.setSingleShot(true);
-    
-    connect(&timer, &QTimer::timeout, &loop, &QEventLoop::quit);
-    connect(m_socket, &QSslSocket::readyRead, &loop, &QEventLoop::quit);
-    
-    timer.start(timeoutMs);
-    
-    while (!m_responseBuffer.contains("\r\n") && timer.isActive()) {
-        loop.exec();
+ImapClient::CommandKind ImapClient::classifyCommand(const QString& command) {
+    const QString verb = command.section(' ', 0, 0).toUpper();
+    if (verb == "LOGIN" || verb == "AUTHENTICATE" || verb == "STARTTLS" || verb == "LOGOUT"
+        || verb == "IDLE") {
+        return Barrier;
     }
-    
-    return m_responseBuffer.contains("\r\n");
+    if (verb == "FETCH" || verb == "STORE" || verb == "SEARCH") {
+        return SequenceNumbers;
+    }
+    return Pipelined;
 }
 
-QString ImapClient::generateTag() {
-    return QString("A%1").arg(++m_tagCounter, 4, 10, QChar('0'));
-}
+void ImapClient::handleResponse(const ImapResponse& response) {
+    // Capabilities may come with the greeting, after login or on request
+    if (response.code == "CAPABILITY") {
+        updateCapabilities(response.codeArgs);
+    } else if (response.kind == ImapResponse::Untagged && response.name == "CAPABILITY") {
+        updateCapabilities(response.fields);
+    }
 
-bool ImapClient::parseResponse(const QString& response, QString& tag, QString& status, QString& data) {
-    QRegularExpression re("^(A\\d+)\\s+(OK|NO|BAD)\\s*(.*)$");
-    QRegularExpressionMatch match = re.match(response);
-    
-    if (match.hasMatch()) {
-        tag = match.captured(1);
-        status = match.captured(2);
-        data = match.captured(3);
-        return true;
+    if (m_awaitingGreeting) {
+        handleGreeting(response);
+        return;
     }
-    
-    return false;
-}
 
-bool ImapClient::loginCommand(const QString& username, const QString& password) {
-    QString tag = generateTag();
-    QString command = QString("%1 LOGIN %2 %3").arg(tag, username, password);
-    sendCommand(command);
-    QString response = readResponse();
-    QString responseTag, status, data;
-    if (parseResponse(response, responseTag, status, data) && responseTag == tag) {
-        if (status == "OK") {
-            qDebug() << "IMAP LOGIN SUCCESS";
-            return true;
-        } else {
-            m_lastError = "Login failed: " + data;
-            qDebug() << "IMAP LOGIN FAILED:" << m_lastError;
+    switch (response.kind) {
+    case ImapResponse::Tagged:
+        completeCommand(response);
+        break;
+    case ImapResponse::Untagged:
+        if (response.name == "BYE") {
+            m_lastError = "Server closed connection: " + QString::fromUtf8(response.text);
         }
+        if (response.name == "STATUS") {
+            handleStatusResponse(response);
+        }
+        trackResponse(response);
+        if (!m_inFlight.isEmpty() && m_inFlight.first().tag == m_idleTag) {
+            break;
+        }
+        // Pipelined commands are answered in order, so untagged data belongs
+        // to the oldest command that has not completed yet
+        if (!m_inFlight.isEmpty()) {
+            m_inFlight.first().untagged.append(response);
+        }
+        break;
+    case ImapResponse::Continuation:
+        if (!m_inFlight.isEmpty() && m_inFlight.first().tag == m_idleTag) {
+            m_idling = true;
+            m_responseTimer->stop();
+            m_idleTimer->start();
+            // Work queued while the IDLE was being set up ends it right away
+            if (!m_queue.isEmpty() || m_idleMailbox != m_currentMailbox) {
+                leaveIdle();
+            }
+            break;
+        }
+        // The client never sends literals, so other continuations are unexpected
+        qDebug() << "IMAP: ignoring continuation request";
+        break;
+    }
+}
+
+void ImapClient::handleGreeting(const ImapResponse& response) {
+    m_awaitingGreeting = false;
+    m_responseTimer->stop();
+
+    if (response.kind == ImapResponse::Untagged && (response.isOk() || response.name == "PREAUTH")) {
+        emit connected();
+        processQueue();
     } else {
-        m_lastError = "Invalid login response: " + response;
-        qDebug() << "IMAP LOGIN INVALID RESPONSE:" << response;
+        m_lastError = "Server greeting failed: " + QString::fromUtf8(describeResponse(response));
+        m_state = Error;
+        emit error(m_lastError);
     }
-    return false;
 }
 
-QStringList ImapClient::listCommand() {
-    QString tag = generateTag();
-    QString command = QString("%1 LIST \"\" \"*\"").arg(tag);
-    
-    sendCommand(command);
-    
-    QStringList responses = readMultilineResponse();
-    QStringList mailboxes;
-    
-    for (const QString& response : responses) {
-        if (response.startsWith("*") && response.contains("LIST")) {
-            // Parse LIST response: * LIST (\HasNoChildren) "." BACKLOG
-            // The mailbox name is the last word in the response
-            QStringList parts = response.split(' ', Qt::SkipEmptyParts);
-            if (parts.size() >= 4) {
-                QString mailboxName = parts.last();
-                // Remove quotes if present
-                if (mailboxName.startsWith('"') && mailboxName.endsWith('"')) {
-                    mailboxName = mailboxName.mid(1, mailboxName.length() - 2);
+void ImapClient::completeCommand(const ImapResponse& tagged) {
+    int index = -1;
+    for (int i = 0; i < m_inFlight.size(); ++i) {
+        if (m_inFlight[i].tag.toLatin1() == tagged.tag) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0) {
+        qDebug() << "IMAP: unexpected tagged response" << tagged.tag;
+        return;
+    }
+
+    PendingCommand command = m_inFlight.takeAt(index);
+    if (m_inFlight.isEmpty()) {
+        m_responseTimer->stop();
+    }
+
+    ImapCommandResult result;
+    result.ok = tagged.isOk();
+    result.tag = command.tag;
+    result.tagged = tagged;
+    result.untagged = command.untagged;
+    if (!result.ok) {
+        result.errorMessage = QString("%1 failed: %2")
+            .arg(command.command.section(' ', 0, 0), QString::fromUtf8(tagged.text));
+        m_lastError = result.errorMessage;
+    }
+
+    if (command.callback) {
+        command.callback(result);
+    }
+
+    processQueue();
+}
+
+void ImapClient::updateCapabilities(const ImapValue& capabilities) {
+    m_capabilities.clear();
+    for (const ImapValue& capability : capabilities.values()) {
+        m_capabilities.insert(capability.data().toUpper());
+    }
+}
+
+void ImapClient::enableExtensions(std::function<void()> done) {
+    auto enable = [this, done]() {
+        if (!hasCapability("QRESYNC")) {
+            done();
+            return;
+        }
+        execute("ENABLE QRESYNC", [this, done](const ImapCommandResult& result) {
+            for (const ImapResponse& response : result.untagged) {
+                if (response.name != "ENABLED") {
+                    continue;
+                }
+                for (const ImapValue& extension : response.fields.values()) {
+                    if (extension.data().toUpper() == "QRESYNC") {
+                        m_qresyncEnabled = true;
+                    }
                 }
-                mailboxes.append(mailboxName);
             }
+            done();
+        });
+    };
+
+    if (m_capabilities.isEmpty()) {
+        execute("CAPABILITY", [enable](const ImapCommandResult&) {
+            enable();
+        });
+    } else {
+        enable();
+    }
+}
+
+void ImapClient::enterIdle() {
+    if (m_idleMailbox.isEmpty() || !m_idleTag.isEmpty() || !isAuthenticated() || !hasCapability("IDLE")
+        || m_socket->state() != QAbstractSocket::ConnectedState) {
+        return;
+    }
+
+    // IDLE watches the selected mailbox, which it only reads
+    if (m_idleMailbox != m_queuedMailbox) {
+        const QString mailbox = m_idleMailbox;
+        selectCommand(mailbox, true, [this, mailbox](bool ok) {
+            if (!ok && m_idleMailbox == mailbox) {
+                m_idleMailbox.clear();
+            }
+        });
+        return;
+    }
+
+    // EXPUNGE names messages by number: learn the UIDs behind them first
+    if (!m_sequence.isComplete()) {
+        loadSequence();
+        return;
+    }
+
+    m_idleRefreshRequested = false;
+    m_idleTag = execute("IDLE", [this](const ImapCommandResult& result) {
+        m_idling = false;
+        m_idleTag.clear();
+        m_idleTimer->stop();
+        if (!result.ok && !result.tagged.tag.isEmpty()) {
+            // Rejected by the server; don't retry on every idle moment
+            qDebug() << "IMAP IDLE failed:" << result.errorMessage;
+            m_idleMailbox.clear();
         }
+    });
+}
+
+void ImapClient::leaveIdle() {
+    if (!m_idling) {
+        return;
     }
-    
-    return mailboxes;
+    m_idling = false;
+    m_idleTimer->stop();
+    sendCommand("DONE");
+    m_responseTimer->start();
 }
 
-bool ImapClient::selectCommand(const QString& mailbox) {
-    QString tag = generateTag();
-    QString command = QString("%1 SELECT \"%2\"").arg(tag, mailbox);
-    
-    sendCommand(command);
-    
-    QStringList responses = readMultilineResponse();
-    
-    for (const QString& response : responses) {
-        QString responseTag, status, data;
-        if (parseResponse(response, responseTag, status, data) && responseTag == tag) {
-            return status == "OK";
+void ImapClient::trackResponse(const ImapResponse& response) {
+    // Untagged data belongs to the oldest command in flight, if any
+    const QString tag = m_inFlight.isEmpty() ? QString() : m_inFlight.first().tag;
+    const QString command = m_inFlight.isEmpty() ? QString() : m_inFlight.first().command;
+    QString verb = command.section(' ', 0, 0).toUpper();
+    if (verb == "UID") {
+        verb = command.section(' ', 1, 1).toUpper();
+    }
+    // The data of a SELECT describes the mailbox being selected; the map
+    // starts over when it completes
+    if (m_currentMailbox.isEmpty() || verb == "SELECT" || verb == "EXAMINE") {
+        return;
+    }
+    if (m_pushedMailbox != m_currentMailbox) {
+        flushPushedChanges();
+        m_pushedMailbox = m_currentMailbox;
+    }
+
+    bool refreshNeeded = false;
+    if (response.name == "EXISTS") {
+        // New messages: their cards come with a refresh
+        const quint32 exists = quint32(response.number);
+        refreshNeeded = exists > m_sequence.count();
+        if (!m_sequence.setExists(exists)) {
+            m_sequence.reset(exists);
+        }
+    } else if (response.name == "EXPUNGE") {
+        const quint32 uid = m_sequence.expunge(quint32(response.number));
+        if (uid != 0) {
+            m_pushedChanges.vanished.append(QString::number(uid));
+        } else {
+            refreshNeeded = true;
         }
+    } else if (response.name == "VANISHED") {
+        // * VANISHED 41,43:116 (QRESYNC reports expunges by UID). Those
+        // reported (EARLIER) answer a sync and are gone from the map already.
+        if (response.fields.size() > 1) {
+            return;
+        }
+        bool ok = false;
+        const QList<quint32> vanished = SequenceSet::parse(response.fields.at(0).data(), &ok);
+        if (!ok) {
+            // Too many to list: a refresh reports them again from the last sync
+            m_sequence.reset();
+            refreshNeeded = true;
+        }
+        for (quint32 uid : vanished) {
+            m_pushedChanges.vanished.append(QString::number(uid));
+            if (!m_sequence.remove(uid) && m_sequence.count() > 0) {
+                // One of the messages whose UID was not known yet
+                m_sequence.reset(m_sequence.count() - 1);
+            }
+        }
+    } else if (response.name == "FETCH") {
+        // * 12 FETCH (FLAGS (\Seen)): the UID is only included when asked for
+        const ImapValue& data = response.fields.at(0);
+        const quint32 msn = quint32(response.number);
+        quint32 uid = quint32(data.value("UID").toNumber());
+        if (uid == 0) {
+            uid = m_sequence.uid(msn);
+        } else if (!m_sequence.setUid(msn, uid)) {
+            // Out of step with the server: learn the UIDs again
+            m_sequence.reset(m_sequence.count());
+        }
+        // What a FETCH asked for reaches its own callback
+        if (data.contains("FLAGS") && verb != "FETCH") {
+            if (uid != 0) {
+                m_pushedChanges.flags.insert(QString::number(uid), parseFlagList(data.value("FLAGS")));
+            } else {
+                refreshNeeded = true;
+            }
+        }
+    } else if ((response.name == "SEARCH" || response.name == "ESEARCH") && !tag.isEmpty()
+               && tag == m_sequenceTag) {
+        // Taken as it arrives, which is when it matches the map
+        QList<quint32> uids;
+        if (response.name == "ESEARCH") {
+            // * ESEARCH (TAG "A12") UID ALL 41:44,47
+            uids = SequenceSet::parse(searchResult(response.fields, "ALL").data());
+        } else {
+            // * SEARCH 41 42 43 44 47
+            for (const ImapValue& uid : response.fields.values()) {
+                uids.append(quint32(uid.toNumber()));
+            }
+        }
+        m_sequenceLoaded = true;
+        if (!m_sequence.setUnknownUids(uids)) {
+            // Given up until the next EXISTS, which starts a full search
+            m_sequence.reset();
+        }
+        return;
+    } else {
+        return;
     }
-    
-    return false;
+
+    // One refresh per IDLE is enough: it runs after the IDLE has ended and
+    // sees everything the server announced until then
+    if (refreshNeeded && !tag.isEmpty() && tag == m_idleTag) {
+        refreshNeeded = !m_idleRefreshRequested;
+        m_idleRefreshRequested = true;
+    }
+    m_pushedRefresh = m_pushedRefresh || refreshNeeded;
 }
 
-QList<EmailCard> ImapClient::fetchCommand(const QString& range) {
-    QString tag = generateTag();
-    QString fetchRange = range.isEmpty() ? "1:*" : range;
-    QString command = QString("%1 FETCH %2 (UID FLAGS ENVELOPE BODY[HEADER])").arg(tag, fetchRange);
-    
-    sendCommand(command);
-    
-    QStringList responses = readMultilineResponse();
-    QList<EmailCard> cards;
-    
-    QString currentHeaders;
-    QString currentUid;
-    QStringList currentFlags;
+void ImapClient::flushPushedChanges() {
+    if (m_pushedChanges.isEmpty() && !m_pushedRefresh) {
+        return;
+    }
+    const MailboxChanges changes = m_pushedChanges;
+    const bool refreshNeeded = m_pushedRefresh;
+    m_pushedChanges = MailboxChanges();
+    m_pushedChanges.fullResync = false;
+    m_pushedRefresh = false;
+    emit mailboxChanged(m_pushedMailbox, changes, refreshNeeded);
+}
+
+void ImapClient::loadSequence() {
+    // Only the messages above the known UIDs, e.g. new ones after an EXISTS
+    const quint32 known = m_sequence.knownUid();
+    QString criteria = known == 0 ? QString("ALL") : QString("UID %1:*").arg(known + 1);
+    if (hasCapability("ESEARCH")) {
+        // Answered with a sequence set instead of a number per message
+        criteria = "RETURN (ALL) " + criteria;
+    }
+    m_sequenceLoaded = false;
+    m_sequenceTag = execute("UID SEARCH " + criteria, [this](const ImapCommandResult& result) {
+        m_sequenceTag.clear();
+        if (!result.ok || !m_sequenceLoaded) {
+            m_sequence.reset();
+        }
+    });
+}
+void ImapClient::handleStatusResponse(const ImapResponse& response) {
+    // * STATUS "TODO" (MESSAGES 12 UIDNEXT 40 UIDVALIDITY 3 HIGHESTMODSEQ 771)
+    const QString mailbox = response.fields.at(0).toString();
+    const ImapValue& items = response.fields.at(1);
+    if (mailbox.isEmpty() || !items.isList()) {
+        return;
+    }
+
+    // NOTIFY events may carry only the items that changed
+    const bool known = m_mailboxStatus.contains(mailbox);
+    const MailboxStatus previous = m_mailboxStatus.value(mailbox);
+    MailboxStatus status = previous;
+    bool ok = false;
+    quint64 value = items.value("MESSAGES").toNumber(&ok);
+    if (ok) {
+        status.messages = quint32(value);
+    }
+    value = items.value("UIDNEXT").toNumber(&ok);
+    if (ok) {
+        status.uidNext = quint32(value);
+    }
+    value = items.value("UIDVALIDITY").toNumber(&ok);
+    if (ok) {
+        status.uidValidity = quint32(value);
+    }
+    value = items.value("HIGHESTMODSEQ").toNumber(&ok);
+    if (ok) {
+        status.highestModSeq = value;
+    }
+
+    bool changed;
+    if (known) {
+        changed = status.messages != previous.messages || status.uidNext != previous.uidNext
+            || status.uidValidity != previous.uidValidity || status.highestModSeq != previous.highestModSeq;
+    } else {
+        // First report: compare with what was last synchronized. A mailbox
+        // that was never synchronized has nothing to refresh yet.
+        const MailboxSyncState synced = m_syncStates->value(mailbox);
+        changed = synced.uidValidity != 0
+            && (status.uidValidity != synced.uidValidity || status.uidNext != synced.uidNext
+                || (status.highestModSeq != 0 && status.highestModSeq != synced.highestModSeq));
+    }
+
+    m_mailboxStatus.insert(mailbox, status);
+    if (changed) {
+        MailboxChanges changes;
+        changes.fullResync = false;
+        emit mailboxChanged(mailbox, changes, true);
+    }
+}
+
+void ImapClient::failAllCommands(const QString& message) {
+    QList<PendingCommand> commands = m_inFlight + m_queue;
+    m_inFlight.clear();
+    m_queue.clear();
+    m_responseTimer->stop();
+    m_queuedMailbox.clear();
+    if (!commands.isEmpty()) {
+        m_lastError = message;
+    }
+
+    ImapCommandResult result;
+    result.errorMessage = message;
+    for (const PendingCommand& command : commands) {
+        if (command.callback) {
+            result.tag = command.tag;
+            command.callback(result);
+        }
+    }
+}
+
+QString ImapClient::generateTag() {
+    return QString("A%1").arg(++m_tagCounter, 4, 10, QChar('0'));
+}
+
+void ImapClient::loginCommand(const QString& username, const QString& password, ResultCallback callback) {
+    QString command = QString("LOGIN %1 %2").arg(username, password);
+    execute(command, [this, callback](const ImapCommandResult& result) {
+        if (result.ok) {
+            qDebug() << "IMAP LOGIN SUCCESS";
+            // Capabilities announced before login may no longer apply
+            if (result.tagged.code != "CAPABILITY") {
+                m_capabilities.clear();
+            }
+        } else if (!result.tagged.tag.isEmpty()) {
+            m_lastError = "Login failed: " + QString::fromUtf8(result.tagged.text);
+            qDebug() << "IMAP LOGIN FAILED:" << m_lastError;
+        } else {
+            m_lastError = "Invalid login response: " + result.errorMessage;
+            qDebug() << "IMAP LOGIN INVALID RESPONSE:" << result.errorMessage;
+        }
+        if (callback) {
+            callback(result.ok);
+        }
+    });
+}
+
+void ImapClient::listCommand(const QString& returnOptions, MailboxInfoCallback callback) {
+    QString command = "LIST \"\" \"*\"";
+    if (!returnOptions.isEmpty()) {
+        command += ' ' + returnOptions;
+    }
+
+    execute(command, [callback](const ImapCommandResult& result) {
+        QList<MailboxInfo> mailboxes;
+        QHash<QString, int> indexes;
+        for (const ImapResponse& response : result.untagged) {
+            MailboxInfo info;
+            if (response.name == "LIST" && parseListResponse(response, info)) {
+                indexes.insert(info.name, mailboxes.size());
+                mailboxes.append(info);
+            } else if (response.name == "STATUS") {
+                // LIST-STATUS sends each STATUS right after its LIST
+                auto it = indexes.constFind(response.fields.at(0).toString());
+                if (it != indexes.constEnd()) {
+                    applyStatus(response.fields.at(1), mailboxes[it.value()]);
+                }
+            }
+        }
+        if (callback) {
+            callback(result.ok, mailboxes);
+        }
+    });
+}
+
+void ImapClient::statusBatch(const QList<MailboxInfo>& mailboxes, MailboxInfoCallback callback) {
+    auto results = std::make_shared<QList<MailboxInfo>>(mailboxes);
+    auto pending = std::make_shared<int>(0);
+    const QString items = statusItems(true);
+
+    // All STATUS commands are pipelined, so this costs one more round trip
+    for (int i = 0; i < results->size(); ++i) {
+        if (!results->at(i).isSelectable()) {
+            continue;
+        }
+        ++*pending;
+        QString command = QString("STATUS \"%1\" %2").arg(results->at(i).name, items);
+        execute(command, [results, pending, i, callback](const ImapCommandResult& result) {
+            for (const ImapResponse& response : result.untagged) {
+                if (response.name == "STATUS") {
+                    applyStatus(response.fields.at(1), (*results)[i]);
+                }
+            }
+            if (--*pending == 0 && callback) {
+                callback(true, *results);
+            }
+        });
+    }
+
+    if (*pending == 0 && callback) {
+        callback(true, *results);
+    }
+}
+
+QString ImapClient::statusItems(bool unseen) const {
+    QStringList items = {"MESSAGES", "UIDNEXT", "UIDVALIDITY"};
+    if (unseen) {
+        items.append("UNSEEN");
+    }
+    if (hasCapability("CONDSTORE") || hasCapability("QRESYNC")) {
+        items.append("HIGHESTMODSEQ");
+    }
+    return '(' + items.join(' ') + ')';
+}
+
+void ImapClient::ensureSelected(const QString& mailbox, bool readOnly) {
+    if (mailbox == m_queuedMailbox && (readOnly || !m_queuedReadOnly)) {
+        return;
+    }
+    selectCommand(mailbox, readOnly, ResultCallback());
+}
+
+void ImapClient::selectCommand(const QString& mailbox, bool readOnly, ResultCallback callback) {
+    selectCommand(mailbox, QString(), readOnly, [callback](const ImapCommandResult& result) {
+        if (callback) {
+            callback(result.ok);
+        }
+    });
+}
+
+void ImapClient::selectCommand(const QString& mailbox, const QString& parameters, bool readOnly,
+                               CommandCallback callback) {
+    QString command = QString("%1 \"%2\"").arg(readOnly ? "EXAMINE" : "SELECT", mailbox);
+    if (!parameters.isEmpty()) {
+        command += ' ' + parameters;
+    }
+    m_queuedMailbox = mailbox;
+    m_queuedReadOnly = readOnly;
+    auto waiters = std::make_shared<QList<ResultCallback>>();
+    m_selectWaiters = waiters;
     
-    for (const QString& response : responses) {
-        if (response.startsWith("*") && response.contains("FETCH")) {
-            // Parse FETCH response
-            QRegularExpression uidRe("UID (\\d+)");
-            QRegularExpressionMatch uidMatch = uidRe.match(response);
-            if (uidMatch.hasMatch()) {
-                currentUid = uidMatch.captured(1);
-            }
-            
-            // Parse flags
-            QRegularExpression flagsRe("FLAGS \\(([^)]*)\\)");
-            QRegularExpressionMatch flagsMatch = flagsRe.match(response);
-            if (flagsMatch.hasMatch()) {
-                currentFlags = flagsMatch.captured(1).split(' ', Qt::SkipEmptyParts);
-            }
-        } else if (!response.startsWith("*") && !response.contains(tag)) {
-            // This is header data
-            currentHeaders += response + "\n";
-        } else if (response.contains(tag)) {
-            // End of fetch, create card
-            if (!currentUid.isEmpty()) {
-                EmailCard card = parseEmailHeaders(currentHeaders, currentUid);
-                card.setFlags(currentFlags);
-                cards.append(card);
-            }
-            
-            // Reset for next card
-            currentHeaders.clear();
-            currentUid.clear();
-            currentFlags.clear();
+    execute(command, [this, mailbox, readOnly, callback, waiters](const ImapCommandResult& result) {
+        if (m_selectWaiters == waiters) {
+            m_selectWaiters.reset();
         }
+        if (result.ok) {
+            m_currentMailbox = mailbox;
+            m_readOnly = readOnly;
+            m_selectedState = parseSelectState(result.untagged);
+            // The UIDs are only learned when something needs them (see enterIdle())
+            quint32 exists = 0;
+            for (const ImapResponse& response : result.untagged) {
+                if (response.name == "EXISTS") {
+                    exists = quint32(response.number);
+                }
+            }
+            m_sequence.reset(exists);
+            m_state = Selected;
+            emit mailboxSelected(mailbox);
+        } else {
+            // A failed SELECT leaves no mailbox selected
+            m_currentMailbox.clear();
+            m_selectedState = MailboxSyncState();
+            m_sequence.reset();
+            if (m_state == Selected) {
+                m_state = Authenticated;
+            }
+            if (m_queuedMailbox == mailbox) {
+                m_queuedMailbox.clear();
+            }
+        }
+        if (callback) {
+            callback(result);
+        }
+        for (const ResultCallback& waiter : *waiters) {
+            waiter(result.ok);
+        }
+    });
+}
+
+void ImapClient::sortCommand(int offset, int count,
+                             std::function<void(bool ok, const QList<quint32>& uids)> callback) {
+    // Newest sent first, as MailboxList::DateDescending shows the cards
+    const QString criteria = "(REVERSE DATE) UTF-8 ALL";
+
+    if (hasCapability("ESORT") && hasCapability("PARTIAL")) {
+        // * ESEARCH (TAG "A7") UID PARTIAL (51:100 2090,2043,2040:2011)
+        QString command = QString("UID SORT RETURN (PARTIAL %1:%2) %3")
+            .arg(offset + 1).arg(offset + count).arg(criteria);
+        execute(command, [callback](const ImapCommandResult& result) {
+            QList<quint32> uids;
+            for (const ImapResponse& response : result.untagged) {
+                if (response.name == "ESEARCH") {
+                    uids = SequenceSet::parse(searchResult(response.fields, "PARTIAL").at(1).data());
+                }
+            }
+            callback(result.ok, uids);
+        });
+        return;
     }
+
+    // * SORT 2090 2043 2040 ...: the whole mailbox, of which the page is kept
+    execute("UID SORT " + criteria, [offset, count, callback](const ImapCommandResult& result) {
+        QList<quint32> uids;
+        for (const ImapResponse& response : result.untagged) {
+            if (response.name == "SORT") {
+                for (const ImapValue& uid : response.fields.values()) {
+                    uids.append(quint32(uid.toNumber()));
+                }
+            }
+        }
+        callback(result.ok, uids.mid(offset, count));
+    });
+}
+
+void ImapClient::fetchCommand(const QString& range, bool byUid, CardsCallback callback) {
+    QString fetchRange = range.isEmpty() ? "1:*" : range;
+    QString command = QString("%1 %2 %3")
+        .arg(byUid ? "UID FETCH" : "FETCH", fetchRange, cardFetchItems());
     
-    return cards;
+    execute(command, [this, callback](const ImapCommandResult& result) {
+        QList<EmailCard> cards;
+        if (result.ok) {
+            cards = parseFetchResponses(result.untagged);
+            emit cardsFetched(cards);
+        }
+        if (callback) {
+            callback(result.ok, cards);
+        }
+    });
 }
 
-bool ImapClient::storeCommand(const QString& uid, const QString& flags, bool add) {
-    QString tag = generateTag();
+void ImapClient::storeCommand(const QString& uid, const QString& flags, bool add, ResultCallback callback) {
     QString operation = add ? "+FLAGS" : "-FLAGS";
-    QString command = QString("%1 UID STORE %2 %3 (%4)").arg(tag, uid, operation, flags);
-    
-    sendCommand(command);
+    QString command = QString("UID STORE %1 %2 (%3)").arg(uid, operation, flags);
     
-    QString response = readResponse();
-    QString responseTag, status, data;
-    
-    return parseResponse(response, responseTag, status, data) && 
-           responseTag == tag && status == "OK";
+    execute(command, [callback](const ImapCommandResult& result) {
+        if (callback) {
+            callback(result.ok);
+        }
+    });
 }
 
-bool ImapClient::moveCommand(const QString& uid, const QString& targetMailbox) {
-    QString tag = generateTag();
-    QString command = QString("%1 UID MOVE %2 \"%3\"").arg(tag, uid, targetMailbox);
-    
-    sendCommand(command);
-    
-    QString response = readResponse();
-    QString responseTag, status, data;
+void ImapClient::moveCommand(const QString& uid, const QString& targetMailbox, MoveCallback callback) {
+    QString command = QString("UID MOVE %1 \"%2\"").arg(uid, targetMailbox);
     
-    return parseResponse(response, responseTag, status, data) && 
-           responseTag == tag && status == "OK";
+    execute(command, [callback](const ImapCommandResult& result) {
+        // MOVE reports COPYUID in an untagged OK ahead of its expunges (RFC
+        // 6851); COPY-style servers put it on the tagged reply
+        QHash<quint32, quint32> moved;
+        QList<ImapResponse> responses = result.untagged;
+        responses.append(result.tagged);
+        for (const ImapResponse& response : responses) {
+            if (response.code != "COPYUID" || response.codeArgs.size() < 3) {
+                continue;
+            }
+            // * OK [COPYUID 38505 304,319:320 3956:3958]: the sets are in step
+            const QList<quint32> sources = SequenceSet::parse(response.codeArgs.at(1).data());
+            const QList<quint32> targets = SequenceSet::parse(response.codeArgs.at(2).data());
+            if (sources.size() != targets.size()) {
+                continue;
+            }
+            for (int i = 0; i < sources.size(); ++i) {
+                moved.insert(sources.at(i), targets.at(i));
+            }
+        }
+        if (callback) {
+            callback(result.ok, result.ok ? moved : QHash<quint32, quint32>());
+        }
+    });
 }
 
-bool ImapClient::expungeCommand() {
-    QString tag = generateTag();
-    QString command = QString("%1 EXPUNGE").arg(tag);
-    
-    sendCommand(command);
-    
-    QString response = readResponse();
-    QString responseTag, status, data;
-    
-    return parseResponse(response, responseTag, status, data) && 
-           responseTag == tag && status == "OK";
+void ImapClient::expungeCommand(const QString& uid, ResultCallback callback) {
+    // A plain EXPUNGE would also remove messages other clients flagged \Deleted
+    const QString command = hasCapability("UIDPLUS") && !uid.isEmpty() ? "UID EXPUNGE " + uid : "EXPUNGE";
+    execute(command, [callback](const ImapCommandResult& result) {
+        if (callback) {
+            callback(result.ok);
+        }
+    });
 }
 
-EmailCard ImapClient::parseEmailHeaders(const QString& headers, const QString& uid) {
-    EmailCard card;
-    card.setUid(uid);
-    
-    QString subject = extractHeaderValue(headers, "Subject");
-    QString from = extractHeaderValue(headers, "From");
-    QString to = extractHeaderValue(headers, "To");
-    QString dateStr = extractHeaderValue(headers, "Date");
-    
-    card.setSubject(subject);
-    card.setFrom(from);
-    card.setTo(to);
-    card.setDate(parseDate(dateStr));
-    
-    return card;
+void ImapClient::fullSync(const QString& mailbox, ChangesCallback callback) {
+    if (m_cardWindow <= 0) {
+        ensureSelected(mailbox, true);
+        windowSync(mailbox, "UID FETCH 1:*", false, callback);
+        return;
+    }
+
+    // The newest messages have the highest sequence numbers, so the window
+    // follows from EXISTS: "FETCH 4951:*" for the last 50 of 5000. A mailbox
+    // that is selected already has its EXISTS tracked, once its SELECT is
+    // answered; any other is selected for it.
+    auto fetch = [this, mailbox, callback](bool ok) {
+        if (!ok) {
+            if (callback) {
+                callback(false, MailboxChanges());
+            }
+            return;
+        }
+        fetchWindow(mailbox, m_sequence.count(), callback);
+    };
+    if (mailbox != m_queuedMailbox) {
+        selectCommand(mailbox, true, fetch);
+    } else if (m_selectWaiters) {
+        m_selectWaiters->append(fetch);
+    } else {
+        fetch(true);
+    }
+}
+
+void ImapClient::fetchWindow(const QString& mailbox, quint32 exists, ChangesCallback callback) {
+    const quint32 window = quint32(m_cardWindow);
+    ensureSelected(mailbox, true);
+    if (exists > window && hasCapability("SORT")) {
+        // The newest by sent date, which the board shows first, rather
+        // than the last to arrive
+        sortCommand(0, m_cardWindow, [this, mailbox, callback](bool ok, const QList<quint32>& uids) {
+            if (!ok || uids.isEmpty()) {
+                if (callback) {
+                    callback(false, MailboxChanges());
+                }
+                return;
+            }
+            ensureSelected(mailbox, true);
+            windowSync(mailbox, "UID FETCH " + QString::fromLatin1(SequenceSet::format(uids)), true, callback);
+        });
+    } else if (exists > window) {
+        windowSync(mailbox, QString("FETCH %1:*").arg(exists - window + 1), true, callback);
+    } else {
+        windowSync(mailbox, "UID FETCH 1:*", false, callback);
+    }
+}
+
+void ImapClient::windowSync(const QString& mailbox, const QString& fetch, bool hasOlder,
+                            ChangesCallback callback) {
+    execute(QString("%1 %2").arg(fetch, cardFetchItems()),
+            [this, mailbox, hasOlder, callback](const ImapCommandResult& result) {
+        MailboxChanges changes;
+        if (result.ok) {
+            // Commands complete in order, so the selected state is this mailbox's
+            changes.state = m_selectedState;
+            changes.hasOlder = hasOlder;
+            for (const ImapResponse& response : result.untagged) {
+                if (response.name == "FETCH") {
+                    advanceSyncState(response.fields.at(0), changes.state);
+                }
+            }
+            changes.cards = parseFetchResponses(result.untagged);
+            m_syncStates->insert(mailbox, changes.state);
+            emit cardsFetched(changes.cards);
+        }
+        if (callback) {
+            callback(result.ok, changes);
+        }
+    });
+}
+
+void ImapClient::deltaSync(const QString& mailbox, const MailboxSyncState& known, ChangesCallback callback) {
+    auto changes = std::make_shared<MailboxChanges>();
+    auto ok = std::make_shared<bool>(true);
+    changes->fullResync = false;
+    changes->state = known;
+
+    if (mailbox != m_queuedMailbox) {
+        // The server reports everything changed or expunged since the known
+        // HIGHESTMODSEQ as FETCH and VANISHED (EARLIER) responses
+        QString parameters = QString("(QRESYNC (%1 %2))").arg(known.uidValidity).arg(known.highestModSeq);
+        selectCommand(mailbox, parameters, true, [this, changes, ok, known](const ImapCommandResult& result) {
+            *ok = result.ok;
+            if (!result.ok) {
+                return;
+            }
+            if (m_selectedState.uidValidity != known.uidValidity) {
+                changes->fullResync = true;
+                return;
+            }
+            collectChanges(result.untagged, known, *changes);
+            // NOMODSEQ leaves the mailbox without a HIGHESTMODSEQ: resync fully next time
+            changes->state.highestModSeq = m_selectedState.highestModSeq == 0
+                ? 0 : qMax(changes->state.highestModSeq, m_selectedState.highestModSeq);
+            changes->state.uidNext = qMax(changes->state.uidNext, m_selectedState.uidNext);
+        });
+    } else {
+        execute(QString("UID FETCH 1:* (UID FLAGS) (CHANGEDSINCE %1 VANISHED)").arg(known.highestModSeq),
+                [this, changes, ok, known](const ImapCommandResult& result) {
+            *ok = result.ok;
+            if (result.ok) {
+                collectChanges(result.untagged, known, *changes);
+            }
+        });
+    }
+
+    // Cards that arrived since the last sync. "n:*" always matches the last
+    // message, but CHANGEDSINCE keeps the reply empty on a quiet mailbox.
+    QString command = QString("UID FETCH %1:* %2 (CHANGEDSINCE %3)")
+        .arg(known.uidNext).arg(cardFetchItems()).arg(known.highestModSeq);
+    execute(command, [this, mailbox, changes, ok, known, callback](const ImapCommandResult& result) {
+        if (changes->fullResync) {
+            // UIDVALIDITY changed (or more vanished than can be listed):
+            // everything known about the mailbox is stale
+            m_syncStates->remove(mailbox);
+            fullSync(mailbox, callback);
+            return;
+        }
+        if (!*ok || !result.ok) {
+            if (callback) {
+                callback(false, MailboxChanges());
+            }
+            return;
+        }
+
+        collectChanges(result.untagged, known, *changes);
+        m_syncStates->insert(mailbox, changes->state);
+        if (callback) {
+            callback(true, *changes);
+        }
+    });
+}
+
+void ImapClient::collectChanges(const QList<ImapResponse>& responses, const MailboxSyncState& known,
+                                MailboxChanges& changes) {
+    QList<ImapResponse> newCards;
+
+    for (const ImapResponse& response : responses) {
+        if (response.name == "VANISHED") {
+            // * VANISHED (EARLIER) 41,43:116
+            const ImapValue& uids = response.fields.at(response.fields.size() - 1);
+            bool ok = false;
+            const QList<quint32> vanished = SequenceSet::parse(uids.data(), &ok);
+            if (!ok) {
+                // Too many to list: the cards are loaded again instead
+                changes.fullResync = true;
+                return;
+            }
+            for (quint32 uid : vanished) {
+                changes.vanished.append(QString::number(uid));
+            }
+            continue;
+        }
+        if (response.name != "FETCH") {
+            continue;
+        }
+
+        // * 12 FETCH (UID 34 FLAGS (\Seen) MODSEQ (9071) ...)
+        const ImapValue& data = response.fields.at(0);
+        quint32 uid = advanceSyncState(data, changes.state);
+        if (uid == 0) {
+            continue;
+        }
+
+        // Card fetches carry RFC822.SIZE; flag-only updates do not
+        if (uid >= known.uidNext && data.contains("RFC822.SIZE")) {
+            newCards.append(response);
+        } else if (uid < known.uidNext) {
+            changes.flags.insert(QString::number(uid), parseFlagList(data.value("FLAGS")));
+        }
+    }
+
+    changes.cards.append(parseFetchResponses(newCards));
+}
+
+MailboxSyncState ImapClient::parseSelectState(const QList<ImapResponse>& responses) {
+    MailboxSyncState state;
+    for (const ImapResponse& response : responses) {
+        if (response.code == "UIDVALIDITY") {
+            state.uidValidity = quint32(response.codeArgs.at(0).toNumber());
+        } else if (response.code == "UIDNEXT") {
+            state.uidNext = quint32(response.codeArgs.at(0).toNumber());
+        } else if (response.code == "HIGHESTMODSEQ") {
+            state.highestModSeq = response.codeArgs.at(0).toNumber();
+        }
+    }
+    return state;
+}
+
+bool ImapClient::parseListResponse(const ImapResponse& response, MailboxInfo& info) {
+    // * LIST (\HasNoChildren \Drafts) "/" "Projects/Kanban board"
+    // The delimiter is NIL for flat namespaces; the name may be a literal
+    const ImapValue& flags = response.fields.at(0);
+    const ImapValue& delimiter = response.fields.at(1);
+    const ImapValue& name = response.fields.at(2);
+    if (!flags.isList() || name.isNil() || name.isList()) {
+        return false;
+    }
+
+    info.name = name.toString();
+    if (info.name.isEmpty()) {
+        return false;
+    }
+    info.delimiter = delimiter.isNil() || delimiter.data().isEmpty() ? QChar() : QChar::fromLatin1(delimiter.data().at(0));
+    info.flags = parseFlagList(flags);
+    return true;
+}
+
+void ImapClient::applyStatus(const ImapValue& items, MailboxInfo& info) {
+    // (MESSAGES 12 UNSEEN 3 UIDNEXT 40 HIGHESTMODSEQ 771)
+    if (!items.isList()) {
+        return;
+    }
+    info.hasStatus = true;
+    info.messages = quint32(items.value("MESSAGES").toNumber());
+    info.unseen = quint32(items.value("UNSEEN").toNumber());
+    info.uidNext = quint32(items.value("UIDNEXT").toNumber());
+    info.highestModSeq = items.value("HIGHESTMODSEQ").toNumber();
 }
 
-QString ImapClient::extractHeaderValue(const QString& headers, const QString& headerName) {
-    QRegularExpression re(QString("^%1:\\s*(.+)$").arg(headerName), 
-                         QRegularExpression::MultilineOption | QRegularExpression::CaseInsensitiveOption);
-    QRegularExpressionMatch match = re.match(headers);
+QList<EmailCard> ImapClient::parseFetchResponses(const QList<ImapResponse>& responses) {
+    QList<EmailCard> cards;
     
-    if (match.hasMatch()) {
-        return match.captured(1).trimmed();
+    for (const ImapResponse& response : responses) {
+        if (response.name != "FETCH") {
+            continue;
+        }
+        
+        // * 12 FETCH (UID 34 FLAGS (\Seen) INTERNALDATE "..." RFC822.SIZE 2048 ENVELOPE (...))
+        const ImapValue& data = response.fields.at(0);
+        quint32 uid = quint32(data.value("UID").toNumber());
+        if (uid == 0) {
+            continue;
+        }
+        
+        EmailCard card;
+        card.setUid(uid);
+        card.setSize(qint64(data.value("RFC822.SIZE").toNumber()));
+
+        const ImapValue& envelope = data.value("ENVELOPE");
+        if (envelope.isList()) {
+            parseEnvelope(envelope, card);
+        } else {
+            // BODY[HEADER.FIELDS (FROM TO SUBJECT DATE)] {n}; the section may be
+            // echoed in a different spelling, so match on the prefix
+            const std::vector<ImapValue>& items = data.values();
+            for (size_t i = 0; i + 1 < items.size(); i += 2) {
+                if (items[i].data().startsWith("BODY[HEADER")) {
+                    parseHeaderFields(items[i + 1].data(), card);
+                    break;
+                }
+            }
+        }
+
+        if (!card.date().isValid()) {
+            card.setDate(parseInternalDate(data.value("INTERNALDATE").toString()));
+        }
+        if (!card.date().isValid()) {
+            card.setDate(QDateTime::currentDateTime());
+        }
+
+        card.setFlags(parseFlagList(data.value("FLAGS")));
+        cards.append(card);
     }
     
-    return QString();
+    return cards;
+}
+
+QString ImapClient::cardFetchItems() const {
+    return m_fetchHeaderFields ? kHeaderFieldsFetchItems : kEnvelopeFetchItems;
+}
+
+void ImapClient::parseEnvelope(const ImapValue& value, EmailCard& card) {
+    Envelope envelope;
+    if (!Envelope::parse(value, envelope)) {
+        return;
+    }
+    card.setSubject(envelope.subject);
+    card.setFrom(Envelope::formatAddresses(envelope.from));
+    card.setTo(Envelope::formatAddresses(envelope.to));
+    card.setDate(parseDate(envelope.date));
+}
+
+void ImapClient::parseHeaderFields(const QByteArray& headers, EmailCard& card) {
+    // One pass over the lines; folded continuation lines extend the
+    // previous field (RFC 5322 section 2.2.3)
+    QByteArray name;
+    QByteArray value;
+    auto apply = [&card](const QByteArray& field, const QByteArray& text) {
+        const QString decoded = QString::fromUtf8(text.trimmed());
+        if (field == "subject") {
+            card.setSubject(decoded);
+        } else if (field == "from") {
+            card.setFrom(decoded);
+        } else if (field == "to") {
+            card.setTo(decoded);
+        } else if (field == "date") {
+            card.setDate(parseDate(decoded));
+        }
+    };
+
+    for (const QByteArray& rawLine : headers.split('\n')) {
+        QByteArray line = rawLine.endsWith('\r') ? rawLine.left(rawLine.size() - 1) : rawLine;
+        if (!line.isEmpty() && (line.at(0) == ' ' || line.at(0) == '\t')) {
+            value += line;
+            continue;
+        }
+        if (!name.isEmpty()) {
+            apply(name, value);
+            name.clear();
+        }
+        int colon = line.indexOf(':');
+        if (colon > 0) {
+            name = line.left(colon).trimmed().toLower();
+            value = line.mid(colon + 1);
+        }
+    }
+    if (!name.isEmpty()) {
+        apply(name, value);
+    }
 }
 
 QDateTime ImapClient::parseDate(const QString& dateStr) {
+    const QString trimmed = dateStr.trimmed();
+    if (trimmed.isEmpty()) {
+        return QDateTime();
+    }
+
+    QDateTime rfcDate = QDateTime::fromString(trimmed, Qt::RFC2822Date);
+    if (rfcDate.isValid()) {
+        return rfcDate;
+    }
+
     // Try different date formats commonly used in email headers
     QStringList formats = {
         "ddd, dd MMM yyyy hh:mm:ss +hhmm",
@@ -549,11 +1873,22 @@ QDateTime ImapClient::parseDate(const QString& dateStr) {
     };
     
     for (const QString& format : formats) {
-        QDateTime dt = QDateTime::fromString(dateStr, format);
+        QDateTime dt = QDateTime::fromString(trimmed, format);
         if (dt.isValid()) {
             return dt;
         }
     }
     
-    return QDateTime::currentDateTime();
-}
\ No newline at end of file
+    return QDateTime();
+}
+
+QDateTime ImapClient::parseInternalDate(const QString& dateStr) {
+    // "17-Jul-1996 02:44:25 -0700" is RFC 2822 with dashes in the date part
+    QString text = dateStr.trimmed();
+    int space = text.indexOf(' ');
+    if (space < 0) {
+        return QDateTime();
+    }
+    text = text.left(space).replace('-', ' ') + text.mid(space);
+    return QDateTime::fromString(text, Qt::RFC2822Date);
+}
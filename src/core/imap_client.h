@@ -3,11 +3,44 @@
 #include "email_card.h"
 #include "mailbox_list.h"
 #include "settings.h"
+#include "imap_response_parser.h"
+#include "mailbox_sync_state.h"
+#include "mailbox_info.h"
+#include "message_sequence.h"
 #include <QObject>
 #include <QTcpSocket>
 #include <QSslSocket>
 #include <QTimer>
+#include <QHash>
+#include <QSet>
 #include <QStringList>
+#include <functional>
+#include <memory>
+
+// Outcome of one tagged command, with the untagged data it produced
+struct ImapCommandResult {
+    bool ok = false;
+    QString tag;
+    ImapResponse tagged;
+    QList<ImapResponse> untagged;
+    QString errorMessage;
+};
+
+// Outcome of syncCards(). A full resync lists every card of the card window
+// (the newest messages); otherwise only new cards, changed flags and
+// vanished UIDs are reported.
+struct MailboxChanges {
+    bool fullResync = true;
+    bool hasOlder = false;      // Full resync left older messages on the server
+    QList<EmailCard> cards;
+    QHash<QString, QStringList> flags;
+    QStringList vanished;
+    MailboxSyncState state;
+
+    bool isEmpty() const {
+        return !fullResync && cards.isEmpty() && flags.isEmpty() && vanished.isEmpty();
+    }
+};
 
 class ImapClient : public QObject {
     Q_OBJECT
@@ -22,6 +55,19 @@ public:
         Error
     };
 
+    using CommandCallback = std::function<void(const ImapCommandResult& result)>;
+    using ResultCallback = std::function<void(bool ok)>;
+    using CardsCallback = std::function<void(bool ok, const QList<EmailCard>& cards)>;
+    using MailboxesCallback = std::function<void(bool ok, const QStringList& mailboxes)>;
+    using MailboxInfoCallback = std::function<void(bool ok, const QList<MailboxInfo>& mailboxes)>;
+    using ChangesCallback = std::function<void(bool ok, const MailboxChanges& changes)>;
+    using UidsCallback = std::function<void(bool ok, quint32 uidValidity, const QList<quint32>& uids)>;
+    // UIDs the moved messages were given in the target, by their UID in the
+    // source; empty unless the server reports them (COPYUID, RFC 4315)
+    using MoveCallback = std::function<void(bool ok, const QHash<quint32, quint32>& movedUids)>;
+    // Each conversation as the UIDs of its messages
+    using ThreadsCallback = std::function<void(bool ok, const QList<QList<quint32>>& threads)>;
+
     explicit ImapClient(QObject* parent = nullptr);
     ~ImapClient();
 
@@ -34,22 +80,93 @@ public:
     // Authentication
     void authenticate(const QString& username, const QString& password);
 
+    // Server capabilities; QRESYNC is enabled after login when offered
+    bool hasCapability(const QString& capability) const;
+    bool qresyncEnabled() const;
+
+    // Queue a raw command (without tag). The callback runs once the tagged
+    // completion arrives, or with ok == false if the connection goes away.
+    // Up to pipelineDepth() commands are written before their replies arrive.
+    QString execute(const QString& command, CommandCallback callback = CommandCallback());
+    int pipelineDepth() const;
+    void setPipelineDepth(int depth);
+    // Number of newest messages a full sync fetches; 0 fetches all of them
+    int cardWindow() const;
+    void setCardWindow(int cards);
+
     // Mailbox operations
-    QStringList listMailboxes();
-    bool selectMailbox(const QString& mailbox);
+    void listMailboxes(MailboxesCallback callback);
+    // All mailboxes with their hierarchy and counts: one LIST ... RETURN
+    // (STATUS ...) with LIST-STATUS, else LIST plus a pipelined STATUS batch
+    void listMailboxInfo(MailboxInfoCallback callback);
+    // Mailboxes are only selected when the mailbox or the access needed
+    // changes: reads (refresh, fetch, IDLE) EXAMINE it, writes SELECT it, and
+    // a read-write selection serves reads as well. selectMailbox() asks for
+    // read-write access.
+    void selectMailbox(const QString& mailbox, ResultCallback callback = ResultCallback());
     QString currentMailbox() const;
+    bool isReadOnly() const;
+    // Leaves the selected mailbox without expunging it (UNSELECT, RFC 3691,
+    // or CLOSE after EXAMINE); false if nothing was sent
+    bool unselectMailbox(ResultCallback callback = ResultCallback());
 
     // Email operations
-    QList<EmailCard> fetchCards(const QString& mailbox = QString());
-    EmailCard fetchCard(const QString& uid, const QString& mailbox = QString());
-    bool moveCard(const QString& uid, const QString& fromMailbox, const QString& toMailbox);
-    bool deleteCard(const QString& uid, const QString& mailbox = QString());
-    bool markAsRead(const QString& uid, bool read = true, const QString& mailbox = QString());
-    bool markAsFlagged(const QString& uid, bool flagged = true, const QString& mailbox = QString());
+    void fetchCards(const QString& mailbox, CardsCallback callback);
+    void fetchCard(const QString& uid, const QString& mailbox, CardsCallback callback);
+    // Up to count cards older than those loaded. With SORT (RFC 5256) the
+    // server orders the mailbox as the board does, newest sent first, and the
+    // page follows the first loaded ones. Otherwise it is the newest below
+    // beforeUid, found with ESEARCH PARTIAL (RFC 9394) or COUNT (RFC 4731)
+    // where available.
+    void fetchOlderCards(const QString& mailbox, quint32 beforeUid, int loaded, int count,
+                         CardsCallback callback);
+    // The mailbox's conversations (THREAD, RFC 5256), by REFERENCES where
+    // the server has it, else by subject; fails without THREAD
+    void fetchThreads(const QString& mailbox, ThreadsCallback callback);
+    // Which of the given UIDs (a UID set) still exist in the mailbox, along
+    // with its current UIDVALIDITY: the UIDs only mean the same messages if
+    // that has not changed since they were seen.
+    void findUids(const QString& mailbox, const QString& uids, UidsCallback callback);
+
+    // Refresh a mailbox. Once it has been synchronized, later calls only
+    // transfer what changed since (QRESYNC, RFC 7162) while UIDVALIDITY holds.
+    void syncCards(const QString& mailbox, ChangesCallback callback);
+    MailboxSyncState syncState(const QString& mailbox) const;
+    // Connections of one session share what they know, so any of them can
+    // continue a delta sync. The states outlive the connection.
+    void setSyncStates(std::shared_ptr<MailboxSyncStates> states);
+
+    // Push updates (RFC 2177). Whenever nothing else is queued the connection
+    // waits in IDLE on this mailbox and reports changes via mailboxChanged().
+    void startIdle(const QString& mailbox);
+    void stopIdle();
+    QString idleMailbox() const;
+    bool isIdling() const;
+
+    // Change tracking for mailboxes other than the selected one. With NOTIFY
+    // (RFC 5465) the server pushes STATUS events; otherwise pollStatus() asks
+    // for STATUS of each mailbox. Either way mailboxChanged() is emitted with
+    // refreshNeeded for every mailbox whose status moved.
+    bool watchMailboxes(const QStringList& mailboxes);
+    bool isWatching() const;
+    void pollStatus(const QStringList& mailboxes);
+    void moveCard(const QString& uid, const QString& fromMailbox, const QString& toMailbox,
+                  MoveCallback callback = MoveCallback());
+    // Expunges only the given messages where UIDPLUS allows (UID EXPUNGE)
+    void deleteCard(const QString& uid, const QString& mailbox, ResultCallback callback = ResultCallback());
+    void markAsRead(const QString& uid, bool read, const QString& mailbox,
+                    ResultCallback callback = ResultCallback());
+    void markAsFlagged(const QString& uid, bool flagged, const QString& mailbox,
+                       ResultCallback callback = ResultCallback());
 
     // Utility
     bool isConnected() const;
     bool isAuthenticated() const;
+    bool isBusy() const;
+    int pendingCommands() const;
+
+    // Builds cards from FETCH data carrying ENVELOPE or header fields
+    static QList<EmailCard> parseFetchResponses(const QList<ImapResponse>& responses);
 
 signals:
     void connected();
@@ -58,6 +175,10 @@ signals:
     void error(const QString& message);
     void mailboxSelected(const QString& mailbox);
     void cardsFetched(const QList<EmailCard>& cards);
+    // Changes the server reported on the selected mailbox without being
+    // asked, while idling or along with other commands. refreshNeeded is set
+    // for what takes a syncCards(), such as new messages.
+    void mailboxChanged(const QString& mailbox, const MailboxChanges& changes, bool refreshNeeded);
 
 private slots:
     void onSocketConnected();
@@ -65,39 +186,139 @@ private slots:
     void onSocketError(QAbstractSocket::SocketError error);
     void onSslErrors(const QList<QSslError>& errors);
     void onReadyRead();
+    void onResponseTimeout();
+    void onIdleRenewTimeout();
 
 private:
+    // How a command may share the pipeline with others (RFC 3501 5.5)
+    enum CommandKind {
+        Pipelined,        // UID commands, SELECT, LIST, ...
+        SequenceNumbers,  // FETCH/STORE/SEARCH by message number
+        Barrier           // LOGIN, LOGOUT, ...: sent alone, nothing follows until done
+    };
+
+    struct PendingCommand {
+        QString tag;
+        QString command;
+        CommandKind kind = Pipelined;
+        CommandCallback callback;
+        QList<ImapResponse> untagged;
+    };
+
     void sendCommand(const QString& command);
-    QString readResponse();
-    QStringList readMultilineResponse();
-    bool waitForResponse(int timeoutMs = 5000);
-    
+    void processQueue();
+    bool canSend(const PendingCommand& command) const;
+    static CommandKind classifyCommand(const QString& command);
+    void handleResponse(const ImapResponse& response);
+    void handleGreeting(const ImapResponse& response);
+    void completeCommand(const ImapResponse& tagged);
+    void updateCapabilities(const ImapValue& capabilities);
+    void enableExtensions(std::function<void()> done);
+    void enterIdle();
+    void leaveIdle();
+    // Keeps the sequence map up to date from untagged data; what other
+    // clients changed is collected and pushed per read by flushPushedChanges()
+    void trackResponse(const ImapResponse& response);
+    void flushPushedChanges();
+    // Asks for the UIDs the sequence map does not know yet
+    void loadSequence();
+    void handleStatusResponse(const ImapResponse& response);
+    void failAllCommands(const QString& message);
+
     QString generateTag();
-    bool parseResponse(const QString& response, QString& tag, QString& status, QString& data);
-    
+
     // IMAP command helpers
-    bool loginCommand(const QString& username, const QString& password);
-    QStringList listCommand();
-    bool selectCommand(const QString& mailbox);
-    QList<EmailCard> fetchCommand(const QString& range = "1:*");
-    bool storeCommand(const QString& uid, const QString& flags, bool add = true);
-    bool moveCommand(const QString& uid, const QString& targetMailbox);
-    bool expungeCommand();
+    void loginCommand(const QString& username, const QString& password, ResultCallback callback);
+    void listCommand(const QString& returnOptions, MailboxInfoCallback callback);
+    void statusBatch(const QList<MailboxInfo>& mailboxes, MailboxInfoCallback callback);
+    QString statusItems(bool unseen) const;
+    // Queues a SELECT, or an EXAMINE for read-only access, unless the mailbox
+    // will be selected with enough access when the queue gets there
+    void ensureSelected(const QString& mailbox, bool readOnly);
+    void selectCommand(const QString& mailbox, bool readOnly, ResultCallback callback);
+    void selectCommand(const QString& mailbox, const QString& parameters, bool readOnly,
+                       CommandCallback callback);
+    void fetchCommand(const QString& range, bool byUid, CardsCallback callback);
+    void fetchPage(const QString& mailbox, bool ok, const QList<quint32>& uids, CardsCallback callback);
+    // The UIDs from offset on in the board's order, by UID SORT
+    void sortCommand(int offset, int count, std::function<void(bool ok, const QList<quint32>& uids)> callback);
+    void storeCommand(const QString& uid, const QString& flags, bool add, ResultCallback callback);
+    void moveCommand(const QString& uid, const QString& targetMailbox, MoveCallback callback);
+    void expungeCommand(const QString& uid, ResultCallback callback);
+
+    // Mailbox synchronization
+    void fullSync(const QString& mailbox, ChangesCallback callback);
+    // The newest m_cardWindow of the mailbox's exists messages
+    void fetchWindow(const QString& mailbox, quint32 exists, ChangesCallback callback);
+    void windowSync(const QString& mailbox, const QString& fetch, bool hasOlder, ChangesCallback callback);
+    void deltaSync(const QString& mailbox, const MailboxSyncState& known, ChangesCallback callback);
+    void collectChanges(const QList<ImapResponse>& responses, const MailboxSyncState& known,
+                        MailboxChanges& changes);
+    static MailboxSyncState parseSelectState(const QList<ImapResponse>& responses);
+    static bool parseListResponse(const ImapResponse& response, MailboxInfo& info);
+    static void applyStatus(const ImapValue& items, MailboxInfo& info);
 
     // Email parsing
-    EmailCard parseEmailHeaders(const QString& headers, const QString& uid);
-    QString extractHeaderValue(const QString& headers, const QString& headerName);
-    QDateTime parseDate(const QString& dateStr);
+    QString cardFetchItems() const;
+    static void parseEnvelope(const ImapValue& value, EmailCard& card);
+    static void parseHeaderFields(const QByteArray& headers, EmailCard& card);
+    static QDateTime parseDate(const QString& dateStr);
+    static QDateTime parseInternalDate(const QString& dateStr);
 
     QSslSocket* m_socket;
+    QTimer* m_responseTimer;
     State m_state;
     QString m_lastError;
     QString m_currentMailbox;
+    QString m_queuedMailbox;        // Selected once the queued commands have run
+    bool m_readOnly;                // Of m_currentMailbox
+    bool m_queuedReadOnly;          // Of m_queuedMailbox
+    // Run when the last SELECT sent is answered; null once it has been
+    std::shared_ptr<QList<ResultCallback>> m_selectWaiters;
     int m_tagCounter;
-    QString m_responseBuffer;
-    
+    int m_pipelineDepth;
+    int m_cardWindow;
+    bool m_awaitingGreeting;
+    ImapResponseParser m_parser;
+    QList<PendingCommand> m_queue;
+    QList<PendingCommand> m_inFlight;
+
+    // Extensions and per-mailbox synchronization state
+    QSet<QByteArray> m_capabilities;
+    bool m_qresyncEnabled;
+    MailboxSyncState m_selectedState;
+    MessageSequence m_sequence;     // Of m_currentMailbox
+    QString m_sequenceTag;
+    bool m_sequenceLoaded;          // The pending search was answered
+    QString m_pushedMailbox;
+    MailboxChanges m_pushedChanges;
+    bool m_pushedRefresh;
+    std::shared_ptr<MailboxSyncStates> m_syncStates;
+
+    // Last STATUS seen per mailbox; zero means not reported
+    struct MailboxStatus {
+        quint32 messages = 0;
+        quint32 uidNext = 0;
+        quint32 uidValidity = 0;
+        quint64 highestModSeq = 0;
+    };
+    QHash<QString, MailboxStatus> m_mailboxStatus;
+    bool m_notifyActive;
+
+    // IDLE
+    QTimer* m_idleTimer;
+    QString m_idleMailbox;
+    QString m_idleTag;
+    bool m_idling;
+    bool m_idleRefreshRequested;
+
     // Settings
     QString m_server;
     int m_port;
     bool m_useSSL;
-};
\ No newline at end of file
+    bool m_fetchHeaderFields;
+    bool m_expungeAll;          // Plain EXPUNGE without UIDPLUS (Settings)
+};
+
+// Sent across threads by ImapClient::mailboxChanged()
+Q_DECLARE_METATYPE(MailboxChanges)
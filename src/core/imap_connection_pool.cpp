@@ -0,0 +1,225 @@
+#include "imap_connection_pool.h"
+#include "command_scheduler.h"
+#include <QDebug>
+
+namespace {
+
+const int kHealthCheckMs = 60 * 1000;
+const qint64 kIdleTrimMs = 5 * 60 * 1000;
+
+} // namespace
+
+ImapConnectionPool::ImapConnectionPool(QObject* parent)
+    : QObject(parent)
+    , m_interactive(new ImapClient(this))
+    , m_syncStates(std::make_shared<MailboxSyncStates>())
+    , m_scheduler(std::make_unique<CommandScheduler>(this))
+    , m_healthTimer(new QTimer(this))
+    , m_maxConnections(4)
+{
+    m_interactive->setSyncStates(m_syncStates);
+
+    m_healthTimer->setInterval(kHealthCheckMs);
+    connect(m_healthTimer, &QTimer::timeout, this, &ImapConnectionPool::onHealthCheck);
+}
+
+ImapConnectionPool::~ImapConnectionPool() {
+    close();
+}
+
+void ImapConnectionPool::open(const Settings& settings) {
+    m_settings = settings;
+    m_maxConnections = settings.maxConnections();
+    m_interactive->connectToServer(settings);
+    m_healthTimer->start();
+}
+
+void ImapConnectionPool::close() {
+    m_healthTimer->stop();
+    m_scheduler->cancelAll();
+
+    const QList<ImapClient*> clients = m_connections.keys();
+    for (ImapClient* client : clients) {
+        dropConnection(client);
+    }
+    m_interactive->disconnectFromServer();
+
+    // A new session starts from scratch
+    m_syncStates->clear();
+}
+
+ImapClient* ImapConnectionPool::interactive() const {
+    return m_interactive;
+}
+
+CommandScheduler* ImapConnectionPool::scheduler() const {
+    return m_scheduler.get();
+}
+
+void ImapConnectionPool::acquire(const QString& mailbox, ClientCallback callback) {
+    if (!m_interactive->isAuthenticated()) {
+        callback(nullptr);
+        return;
+    }
+    // With a single connection everything shares the interactive one
+    if (m_maxConnections <= 1) {
+        callback(m_interactive);
+        return;
+    }
+
+    ImapClient* best = nullptr;
+    for (auto it = m_connections.constBegin(); it != m_connections.constEnd(); ++it) {
+        ImapClient* client = it.key();
+        if (load(client) > 0) {
+            continue;
+        }
+        if (client->currentMailbox() == mailbox) {
+            best = client;
+            break;
+        }
+        if (!best) {
+            best = client;
+        }
+    }
+
+    if (!best && m_connections.size() < m_maxConnections - 1) {
+        best = openConnection();
+    }
+
+    if (!best) {
+        for (auto it = m_connections.constBegin(); it != m_connections.constEnd(); ++it) {
+            if (!best || load(it.key()) < load(best)) {
+                best = it.key();
+            }
+        }
+    }
+
+    if (!best) {
+        callback(m_interactive);
+        return;
+    }
+
+    Connection& connection = m_connections[best];
+    connection.lastUsed.restart();
+    if (best->isAuthenticated()) {
+        callback(best);
+    } else {
+        connection.waiting.append(callback);
+    }
+}
+
+void ImapConnectionPool::setSyncState(const QString& mailbox, const MailboxSyncState& state) {
+    m_syncStates->insert(mailbox, state);
+}
+
+int ImapConnectionPool::connectionCount() const {
+    return m_connections.size() + (m_interactive->isConnected() ? 1 : 0);
+}
+
+int ImapConnectionPool::maxConnections() const {
+    return m_maxConnections;
+}
+
+void ImapConnectionPool::setMaxConnections(int count) {
+    m_maxConnections = qMax(1, count);
+}
+
+void ImapConnectionPool::onHealthCheck() {
+    const QList<ImapClient*> clients = m_connections.keys();
+    for (ImapClient* client : clients) {
+        const Connection& connection = m_connections[client];
+        if (!connection.waiting.isEmpty() || client->isBusy()) {
+            continue;
+        }
+
+        if (!client->isAuthenticated() || connection.lastUsed.elapsed() > kIdleTrimMs) {
+            qDebug() << "IMAP POOL: closing idle connection";
+            dropConnection(client);
+            continue;
+        }
+
+        auto checked = [this, client](bool ok) {
+            if (!ok) {
+                qDebug() << "IMAP POOL: health check failed:" << client->lastError();
+                dropConnection(client);
+            }
+        };
+        // A connection without work for a whole interval gives up its
+        // mailbox, so the server stops tracking changes for it; that also
+        // keeps the session alive, as a NOOP would
+        if (connection.lastUsed.elapsed() < kHealthCheckMs || !client->unselectMailbox(checked)) {
+            client->execute("NOOP", [checked](const ImapCommandResult& result) {
+                checked(result.ok);
+            });
+        }
+    }
+
+    // The interactive connection stays open; an IDLE already keeps it alive
+    if (m_interactive->isAuthenticated() && !m_interactive->isBusy() && !m_interactive->isIdling()) {
+        m_interactive->execute("NOOP");
+    }
+}
+
+ImapClient* ImapConnectionPool::openConnection() {
+    ImapClient* client = new ImapClient(this);
+    client->setSyncStates(m_syncStates);
+    m_connections.insert(client, Connection());
+    m_connections[client].lastUsed.start();
+
+    connect(client, &ImapClient::connected, this, [this, client]() {
+        client->authenticate(m_settings.username(), m_settings.password());
+    });
+    connect(client, &ImapClient::authenticated, this, [this, client]() {
+        runWaiting(client);
+    });
+    connect(client, &ImapClient::error, this, [this, client](const QString& message) {
+        qDebug() << "IMAP POOL: connection error:" << message;
+        if (!client->isAuthenticated()) {
+            dropConnection(client);
+        }
+    });
+    connect(client, &ImapClient::disconnected, this, [this, client]() {
+        dropConnection(client);
+    });
+
+    client->connectToServer(m_settings);
+    return client;
+}
+
+void ImapConnectionPool::dropConnection(ImapClient* client) {
+    auto it = m_connections.find(client);
+    if (it == m_connections.end()) {
+        return;
+    }
+    const QList<ClientCallback> waiting = it->waiting;
+    m_connections.erase(it);
+
+    client->disconnect(this);
+    client->disconnectFromServer();
+    client->deleteLater();
+
+    // Work that never got this connection moves to the interactive one
+    ImapClient* fallback = m_interactive->isAuthenticated() ? m_interactive : nullptr;
+    for (const ClientCallback& callback : waiting) {
+        callback(fallback);
+    }
+}
+
+void ImapConnectionPool::runWaiting(ImapClient* client) {
+    auto it = m_connections.find(client);
+    if (it == m_connections.end()) {
+        return;
+    }
+    const QList<ClientCallback> waiting = it->waiting;
+    it->waiting.clear();
+
+    for (const ClientCallback& callback : waiting) {
+        callback(client);
+    }
+}
+
+int ImapConnectionPool::load(ImapClient* client) const {
+    auto it = m_connections.constFind(client);
+    int waiting = it != m_connections.constEnd() ? it->waiting.size() : 0;
+    return client->pendingCommands() + waiting;
+}
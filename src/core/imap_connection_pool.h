@@ -0,0 +1,72 @@
+#pragma once
+
+#include "imap_client.h"
+#include "settings.h"
+#include <QObject>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <functional>
+#include <memory>
+
+class CommandScheduler;
+
+// A bounded set of authenticated IMAP sessions sharing one set of
+// credentials. One connection is reserved for interactive operations (and
+// push updates); background work such as column refreshes is spread over
+// the others, which are opened on demand and closed again when idle.
+class ImapConnectionPool : public QObject {
+    Q_OBJECT
+
+public:
+    using ClientCallback = std::function<void(ImapClient* client)>;
+
+    explicit ImapConnectionPool(QObject* parent = nullptr);
+    ~ImapConnectionPool();
+
+    // Opens the interactive connection. The settings are copied; background
+    // connections use the same credentials when they are opened.
+    void open(const Settings& settings);
+    void close();
+
+    ImapClient* interactive() const;
+
+    // Orders the work submitted to the pool's connections; see CommandScheduler
+    CommandScheduler* scheduler() const;
+
+    // Seeds what an earlier session knew about a mailbox (e.g. from the card
+    // cache), so its first refresh can be a delta sync
+    void setSyncState(const QString& mailbox, const MailboxSyncState& state);
+
+    // Hands out a background connection for work on the mailbox once it is
+    // authenticated: preferably an idle one that already has the mailbox
+    // selected, else a new one while under the limit, else the least busy.
+    // Falls back to the interactive connection; nullptr if nothing is usable.
+    void acquire(const QString& mailbox, ClientCallback callback);
+
+    int connectionCount() const;
+    int maxConnections() const;
+    void setMaxConnections(int count);
+
+private slots:
+    void onHealthCheck();
+
+private:
+    struct Connection {
+        QList<ClientCallback> waiting;
+        QElapsedTimer lastUsed;
+    };
+
+    ImapClient* openConnection();
+    void dropConnection(ImapClient* client);
+    void runWaiting(ImapClient* client);
+    int load(ImapClient* client) const;
+
+    ImapClient* m_interactive;
+    QHash<ImapClient*, Connection> m_connections;
+    std::shared_ptr<MailboxSyncStates> m_syncStates;
+    Settings m_settings;
+    std::unique_ptr<CommandScheduler> m_scheduler;
+    QTimer* m_healthTimer;
+    int m_maxConnections;
+};
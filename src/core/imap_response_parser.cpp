@@ -0,0 +1,435 @@
+#include "imap_response_parser.h"
+
+namespace {
+
+const ImapValue kNilValue;
+
+// Tokenizer over one framed response. Literals are sized, so CR/LF inside
+// them never terminate the response.
+class Cursor {
+public:
+    Cursor(const char* data, int pos, int end)
+        : m_data(data), m_pos(pos), m_end(end) {}
+
+    bool atEnd() const {
+        return m_pos >= m_end || m_data[m_pos] == '\r' || m_data[m_pos] == '\n';
+    }
+
+    char peek() const {
+        return m_pos < m_end ? m_data[m_pos] : '\0';
+    }
+
+    void skip(int count = 1) {
+        m_pos += count;
+    }
+
+    void skipSpaces() {
+        while (m_pos < m_end && m_data[m_pos] == ' ') {
+            ++m_pos;
+        }
+    }
+
+    QByteArray word() {
+        int start = m_pos;
+        while (m_pos < m_end && m_data[m_pos] != ' ' && m_data[m_pos] != '\r'
+               && m_data[m_pos] != '\n' && m_data[m_pos] != ']') {
+            ++m_pos;
+        }
+        return QByteArray(m_data + start, m_pos - start);
+    }
+
+    QByteArray rest() {
+        int start = m_pos;
+        int end = m_end;
+        while (end > start && (m_data[end - 1] == '\r' || m_data[end - 1] == '\n')) {
+            --end;
+        }
+        m_pos = m_end;
+        return QByteArray(m_data + start, end - start);
+    }
+
+    ImapValue value() {
+        skipSpaces();
+        char c = peek();
+        if (c == '(') {
+            return list();
+        } else if (c == '"') {
+            return quoted();
+        } else if (c == '{' || (c == '~' && m_pos + 1 < m_end && m_data[m_pos + 1] == '{')) {
+            return literal();
+        }
+        return atom();
+    }
+
+    ImapValue values(char terminator) {
+        ImapValue result(ImapValue::List);
+        while (true) {
+            skipSpaces();
+            if (atEnd() || peek() == terminator) {
+                break;
+            }
+            int before = m_pos;
+            result.append(value());
+            if (m_pos == before) {
+                // Stray delimiter; skip it rather than loop forever
+                ++m_pos;
+            }
+        }
+        return result;
+    }
+
+private:
+    ImapValue list() {
+        ++m_pos; // '('
+        ImapValue result = values(')');
+        if (peek() == ')') {
+            ++m_pos;
+        }
+        return result;
+    }
+
+    ImapValue quoted() {
+        ++m_pos; // opening quote
+        QByteArray data;
+        int start = m_pos;
+        while (m_pos < m_end && m_data[m_pos] != '"') {
+            if (m_data[m_pos] == '\\' && m_pos + 1 < m_end) {
+                data.append(m_data + start, m_pos - start);
+                ++m_pos;
+                start = m_pos;
+            }
+            ++m_pos;
+        }
+        data.append(m_data + start, m_pos - start);
+        if (m_pos < m_end) {
+            ++m_pos; // closing quote
+        }
+        return ImapValue(ImapValue::String, data);
+    }
+
+    ImapValue literal() {
+        if (m_data[m_pos] == '~') {
+            ++m_pos;
+        }
+        ++m_pos; // '{'
+        qint64 size = 0;
+        while (m_pos < m_end && m_data[m_pos] >= '0' && m_data[m_pos] <= '9') {
+            size = size * 10 + (m_data[m_pos] - '0');
+            ++m_pos;
+        }
+        while (m_pos < m_end && m_data[m_pos] != '\n') {
+            ++m_pos; // "+}\r"
+        }
+        ++m_pos; // '\n'
+        qint64 available = qMax<qint64>(0, m_end - m_pos);
+        int length = int(qMin(size, available));
+        ImapValue result(ImapValue::String, QByteArray(m_data + m_pos, length));
+        m_pos += length;
+        return result;
+    }
+
+    ImapValue atom() {
+        int start = m_pos;
+        int bracketDepth = 0;
+        while (m_pos < m_end) {
+            char c = m_data[m_pos];
+            if (c == '[') {
+                ++bracketDepth;
+            } else if (c == ']') {
+                if (bracketDepth == 0) {
+                    break;
+                }
+                --bracketDepth;
+            } else if (bracketDepth == 0 && (c == ' ' || c == '(' || c == ')' || c == '"'
+                                             || c == '\r' || c == '\n')) {
+                break;
+            }
+            ++m_pos;
+        }
+        QByteArray data(m_data + start, m_pos - start);
+        if (data.size() == 3 && qstricmp(data.constData(), "NIL") == 0) {
+            return ImapValue(ImapValue::Nil);
+        }
+        return ImapValue(ImapValue::Atom, data);
+    }
+
+    const char* m_data;
+    int m_pos;
+    int m_end;
+};
+
+bool isStatusName(const QByteArray& name) {
+    return name == "OK" || name == "NO" || name == "BAD" || name == "BYE" || name == "PREAUTH";
+}
+
+} // namespace
+
+// ImapValue implementation
+
+ImapValue::ImapValue()
+    : m_type(Nil)
+{
+}
+
+ImapValue::ImapValue(Type type, const QByteArray& data)
+    : m_type(type)
+    , m_data(data)
+{
+}
+
+ImapValue::Type ImapValue::type() const {
+    return m_type;
+}
+
+bool ImapValue::isNil() const {
+    return m_type == Nil;
+}
+
+bool ImapValue::isAtom() const {
+    return m_type == Atom;
+}
+
+bool ImapValue::isString() const {
+    return m_type == String;
+}
+
+bool ImapValue::isList() const {
+    return m_type == List;
+}
+
+QByteArray ImapValue::data() const {
+    return m_data;
+}
+
+QString ImapValue::toString() const {
+    return QString::fromUtf8(m_data);
+}
+
+quint64 ImapValue::toNumber(bool* ok) const {
+    return m_data.toULongLong(ok);
+}
+
+int ImapValue::size() const {
+    return int(m_list.size());
+}
+
+const ImapValue& ImapValue::at(int index) const {
+    if (index < 0 || index >= int(m_list.size())) {
+        return kNilValue;
+    }
+    return m_list[index];
+}
+
+const std::vector<ImapValue>& ImapValue::values() const {
+    return m_list;
+}
+
+void ImapValue::append(const ImapValue& value) {
+    m_list.push_back(value);
+}
+
+const ImapValue& ImapValue::value(const QByteArray& key) const {
+    for (size_t i = 0; i + 1 < m_list.size(); i += 2) {
+        const ImapValue& candidate = m_list[i];
+        if (candidate.isAtom() && candidate.m_data.size() == key.size()
+            && qstrnicmp(candidate.m_data.constData(), key.constData(), key.size()) == 0) {
+            return m_list[i + 1];
+        }
+    }
+    return kNilValue;
+}
+
+bool ImapValue::contains(const QByteArray& key) const {
+    for (size_t i = 0; i + 1 < m_list.size(); i += 2) {
+        const ImapValue& candidate = m_list[i];
+        if (candidate.isAtom() && candidate.m_data.size() == key.size()
+            && qstrnicmp(candidate.m_data.constData(), key.constData(), key.size()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ImapResponse implementation
+
+ImapResponse::ImapResponse()
+    : kind(Untagged)
+    , number(-1)
+    , codeArgs(ImapValue::List)
+    , fields(ImapValue::List)
+{
+}
+
+bool ImapResponse::isStatus() const {
+    return isStatusName(name);
+}
+
+bool ImapResponse::isOk() const {
+    return name == "OK";
+}
+
+// ImapResponseParser implementation
+
+ImapResponseParser::ImapResponseParser()
+    : m_readPos(0)
+    , m_scanPos(0)
+    , m_segmentPos(0)
+    , m_literalRemaining(0)
+{
+}
+
+void ImapResponseParser::feed(const QByteArray& data) {
+    compact();
+    m_buffer.append(data);
+}
+
+bool ImapResponseParser::next(ImapResponse& response) {
+    if (!scanResponse()) {
+        return false;
+    }
+
+    response = parseResponse(m_readPos, m_scanPos);
+    m_readPos = m_scanPos;
+    return true;
+}
+
+void ImapResponseParser::clear() {
+    m_buffer.clear();
+    m_readPos = 0;
+    m_scanPos = 0;
+    m_segmentPos = 0;
+    m_literalRemaining = 0;
+}
+
+qint64 ImapResponseParser::bufferedBytes() const {
+    return m_buffer.size() - m_readPos;
+}
+
+bool ImapResponseParser::scanResponse() {
+    const int size = m_buffer.size();
+    const char* data = m_buffer.constData();
+
+    while (true) {
+        if (m_literalRemaining > 0) {
+            qint64 available = size - m_scanPos;
+            if (available < m_literalRemaining) {
+                m_literalRemaining -= available;
+                m_scanPos = size;
+                return false;
+            }
+            m_scanPos += int(m_literalRemaining);
+            m_literalRemaining = 0;
+            m_segmentPos = m_scanPos;
+        }
+
+        int lineFeed = m_buffer.indexOf('\n', m_scanPos);
+        if (lineFeed < 0) {
+            m_scanPos = size;
+            return false;
+        }
+
+        // A line ending in {n} or {n+} announces n literal bytes after the
+        // CRLF. The line only starts after the last literal, whose bytes
+        // must not be read as part of it.
+        const int segment = m_segmentPos;
+        int lineEnd = lineFeed;
+        if (lineEnd > segment && data[lineEnd - 1] == '\r') {
+            --lineEnd;
+        }
+        m_scanPos = lineFeed + 1;
+
+        if (lineEnd > segment && data[lineEnd - 1] == '}') {
+            int pos = lineEnd - 2;
+            if (pos >= segment && data[pos] == '+') {
+                --pos;
+            }
+            qint64 literalSize = 0;
+            qint64 multiplier = 1;
+            int digitEnd = pos;
+            while (pos >= segment && data[pos] >= '0' && data[pos] <= '9') {
+                literalSize += (data[pos] - '0') * multiplier;
+                multiplier *= 10;
+                --pos;
+            }
+            if (pos < digitEnd && pos >= segment && data[pos] == '{') {
+                m_literalRemaining = literalSize;
+                m_segmentPos = m_scanPos;   // Past the literal once it is in
+                continue;
+            }
+        }
+
+        m_segmentPos = m_scanPos;
+        return true;
+    }
+}
+
+ImapResponse ImapResponseParser::parseResponse(int begin, int end) const {
+    ImapResponse response;
+    Cursor cursor(m_buffer.constData(), begin, end);
+
+    if (cursor.peek() == '+') {
+        response.kind = ImapResponse::Continuation;
+        cursor.skip();
+        cursor.skipSpaces();
+        response.text = cursor.rest();
+        return response;
+    }
+
+    if (cursor.peek() == '*') {
+        response.kind = ImapResponse::Untagged;
+        cursor.skip();
+    } else {
+        response.kind = ImapResponse::Tagged;
+        response.tag = cursor.word();
+    }
+
+    cursor.skipSpaces();
+    QByteArray word = cursor.word().toUpper();
+
+    if (response.kind == ImapResponse::Untagged && !word.isEmpty()) {
+        bool isNumber = false;
+        qint64 number = word.toLongLong(&isNumber);
+        if (isNumber) {
+            response.number = number;
+            cursor.skipSpaces();
+            word = cursor.word().toUpper();
+        }
+    }
+    response.name = word;
+
+    if (response.isStatus()) {
+        cursor.skipSpaces();
+        if (cursor.peek() == '[') {
+            cursor.skip();
+            response.code = cursor.word().toUpper();
+            response.codeArgs = cursor.values(']');
+            if (cursor.peek() == ']') {
+                cursor.skip();
+            }
+            cursor.skipSpaces();
+        }
+        response.text = cursor.rest();
+    } else {
+        response.fields = cursor.values('\0');
+    }
+
+    return response;
+}
+
+void ImapResponseParser::compact() {
+    // Drop consumed bytes only once they dominate the buffer, so the cost of
+    // moving the unread tail is amortized over the data already parsed.
+    if (m_readPos == 0) {
+        return;
+    }
+    if (m_readPos == m_buffer.size()) {
+        m_buffer.clear();
+    } else if (m_readPos < 65536 || m_readPos < m_buffer.size() / 2) {
+        return;
+    } else {
+        m_buffer.remove(0, m_readPos);
+    }
+    m_scanPos -= m_readPos;
+    m_segmentPos -= m_readPos;
+    m_readPos = 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <vector>
+
+// A single token of an IMAP response: atom, NIL, string (quoted or literal)
+// or a parenthesized list of further values.
+class ImapValue {
+public:
+    enum Type {
+        Nil,
+        Atom,
+        String,
+        List
+    };
+
+    ImapValue();
+    ImapValue(Type type, const QByteArray& data = QByteArray());
+
+    Type type() const;
+    bool isNil() const;
+    bool isAtom() const;
+    bool isString() const;
+    bool isList() const;
+
+    // Atom or string contents
+    QByteArray data() const;
+    QString toString() const;
+    quint64 toNumber(bool* ok = nullptr) const;
+
+    // List access
+    int size() const;
+    const ImapValue& at(int index) const;
+    const std::vector<ImapValue>& values() const;
+    void append(const ImapValue& value);
+
+    // Lookup in key/value lists such as FETCH data: (UID 5 FLAGS (\Seen) ...)
+    // Keys are compared case-insensitively. Returns a Nil value if absent.
+    const ImapValue& value(const QByteArray& key) const;
+    bool contains(const QByteArray& key) const;
+
+private:
+    Type m_type;
+    QByteArray m_data;
+    std::vector<ImapValue> m_list;
+};
+
+// One complete server response, including any literals it carries.
+struct ImapResponse {
+    enum Kind {
+        Untagged,
+        Tagged,
+        Continuation
+    };
+
+    ImapResponse();
+
+    Kind kind;
+    QByteArray tag;        // Command tag for tagged responses
+    qint64 number;         // Leading number of "* 5 EXISTS", or -1
+    QByteArray name;       // OK/NO/BAD/BYE/PREAUTH, EXISTS, FETCH, LIST, ...
+    QByteArray code;       // Response code name, e.g. UIDVALIDITY in "[UIDVALIDITY 3]"
+    ImapValue codeArgs;    // Response code arguments as a list
+    QByteArray text;       // Human readable text of status responses
+    ImapValue fields;      // Remaining tokens of data responses as a list
+
+    bool isStatus() const;
+    bool isOk() const;
+};
+
+// Incremental, byte-oriented tokenizer for IMAP server responses.
+// Data is appended with feed() as it arrives; complete responses are returned
+// by next() once the terminating CRLF and all announced {n} literals are in.
+// Each byte is scanned once for framing and once for tokenizing.
+class ImapResponseParser {
+public:
+    ImapResponseParser();
+
+    void feed(const QByteArray& data);
+    bool next(ImapResponse& response);
+    void clear();
+
+    qint64 bufferedBytes() const;
+
+private:
+    bool scanResponse();
+    ImapResponse parseResponse(int begin, int end) const;
+    void compact();
+
+    QByteArray m_buffer;
+    int m_readPos;
+    int m_scanPos;
+    int m_segmentPos;       // Start of the line being scanned
+    qint64 m_literalRemaining;
+};
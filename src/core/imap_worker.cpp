@@ -0,0 +1,41 @@
+#include "imap_worker.h"
+
+ImapWorker::ImapWorker(bool threaded, QObject* parent)
+    : QObject(parent)
+    , m_thread(threaded ? new QThread(this) : nullptr)
+    , m_pool(new ImapConnectionPool(threaded ? nullptr : this))
+{
+    qRegisterMetaType<MailboxChanges>();
+
+    if (m_thread) {
+        m_thread->setObjectName("imap");
+        // The pool's clients, sockets and timers are its children and move along
+        m_pool->moveToThread(m_thread);
+        connect(m_thread, &QThread::finished, m_pool, &QObject::deleteLater);
+        m_thread->start();
+    }
+}
+
+ImapWorker::~ImapWorker() {
+    if (m_thread) {
+        // Tasks already posted still run; the pool is deleted on its thread
+        // (closing its connections) once the event loop has stopped
+        post([](ImapConnectionPool* pool) {
+            pool->thread()->quit();
+        });
+        m_thread->wait();
+    }
+}
+
+bool ImapWorker::isThreaded() const {
+    return m_thread != nullptr;
+}
+
+ImapConnectionPool* ImapWorker::pool() const {
+    return m_pool;
+}
+
+void ImapWorker::post(Task task) {
+    ImapConnectionPool* pool = m_pool;
+    QMetaObject::invokeMethod(m_pool, [pool, task]() { task(pool); }, Qt::QueuedConnection);
+}
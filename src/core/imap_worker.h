@@ -0,0 +1,51 @@
+#pragma once
+
+#include "imap_connection_pool.h"
+#include <QObject>
+#include <QThread>
+#include <functional>
+
+// Runs an ImapConnectionPool, and with it every socket, TLS session and
+// response parser, on a thread of its own so that the GUI thread never
+// waits on the network.
+//
+// The pool is driven by tasks posted to that thread, which run there in the
+// order they were posted. Results come back through reply(): the wrapped
+// callback runs on the worker's owning thread with copies of the arguments,
+// so nothing the IMAP thread goes on to change is shared.
+class ImapWorker : public QObject {
+    Q_OBJECT
+
+public:
+    using Task = std::function<void(ImapConnectionPool* pool)>;
+
+    // threaded = false keeps the pool on the calling thread, as before the
+    // worker existed (used by benchmarks for comparison)
+    explicit ImapWorker(bool threaded = true, QObject* parent = nullptr);
+    ~ImapWorker();
+
+    bool isThreaded() const;
+
+    // For connecting to its signals (and those of its clients) only. Call
+    // its methods from a task.
+    ImapConnectionPool* pool() const;
+
+    void post(Task task);
+
+    // Wraps a callback for use on the IMAP thread. Calling the wrapper
+    // queues the callback, with copies of the arguments, to this object's
+    // thread; it is dropped if the worker is gone by then.
+    // Args are given explicitly, e.g. reply<bool, MailboxChanges>(...).
+    template <typename... Args, typename Callback>
+    std::function<void(Args...)> reply(Callback callback) {
+        ImapWorker* receiver = this;
+        return [receiver, callback](Args... args) {
+            QMetaObject::invokeMethod(receiver, [callback, args...]() { callback(args...); },
+                                      Qt::QueuedConnection);
+        };
+    }
+
+private:
+    QThread* m_thread;      // Null when not threaded
+    ImapConnectionPool* m_pool;
+};
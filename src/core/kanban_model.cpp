@@ -5,35 +5,194 @@ void KanbanModel::reloadMailboxes() {
     if (!isConnected()) {
         return;
     }
-    m_availableMailboxes = m_imapClient->listMailboxes();
-    // If no visible mailboxes are configured, use all available ones
-    if (m_settings.visibleMailboxes().isEmpty()) {
-        m_settings.setVisibleMailboxes(m_availableMailboxes);
-    }
-    emit mailboxesChanged();
-    // Optionally refresh mailbox contents
-    refreshAll();
+    auto listed = m_worker->reply<bool, QList<MailboxInfo>>([this](bool ok, const QList<MailboxInfo>& mailboxes) {
+        if (!ok) {
+            return;
+        }
+        setMailboxInfo(mailboxes);
+        // If no visible mailboxes are configured, use all available ones
+        if (m_settings.visibleMailboxes().isEmpty()) {
+            m_settings.setVisibleMailboxes(m_availableMailboxes);
+        }
+        emit mailboxesChanged();
+        // Optionally refresh mailbox contents
+        refreshAll();
+    });
+    m_worker->post([listed](ImapConnectionPool* pool) {
+        pool->interactive()->listMailboxInfo(listed);
+    });
 }
 #include "kanban_model.h"
+#include "sequence_set.h"
 #include <QDebug>
+#include <QElapsedTimer>
+
+namespace {
+
+// Bursts of updates (IDLE, paging) are written to the cache together
+const int kCacheWriteDelayMs = 2000;
+// Beyond this many moved cards a column is rebuilt instead
+const int kMaxRowMoves = 32;
+// Beyond this many changed cards a column is diffed once instead of
+// signalled card by card
+const int kMaxRowChanges = 32;
+
+// One step of the row-level notifications for a column
+struct RowChange {
+    enum Kind {
+        Removed,
+        Moved,
+        Inserted,
+        Changed
+    };
+
+    Kind kind;
+    int first;
+    int last;
+    int destination;    // Moved only
+};
+
+// How one batch of a journal replay went on the server
+struct ReplayResult {
+    bool sent = false;          // False if the connection was lost first
+    bool ok = false;
+    QList<quint32> conflicts;   // Cards the batch could not be applied to
+    QHash<quint32, quint32> moved;  // Move: new UIDs, when the server reports them
+    QString reason;
+    QString message;            // Server error when not ok
+};
+
+const char* operationName(JournalEntry::Operation operation) {
+    switch (operation) {
+    case JournalEntry::MarkRead:
+        return "mark read";
+    case JournalEntry::MarkFlagged:
+        return "mark flagged";
+    case JournalEntry::Move:
+        return "move";
+    case JournalEntry::Delete:
+        return "delete";
+    }
+    return "";
+}
+
+QString uidSet(const QList<quint32>& uids) {
+    return QString::fromLatin1(SequenceSet::format(uids));
+}
+
+// Messages flagged \Deleted are about to be expunged, or stay flagged on
+// servers without UIDPLUS (see Settings::expungeAll()); neither is shown
+QList<EmailCard> withoutDeleted(const QList<EmailCard>& cards) {
+    QList<EmailCard> shown;
+    shown.reserve(cards.size());
+    for (const EmailCard& card : cards) {
+        if (!(card.systemFlags() & EmailCard::Deleted)) {
+            shown.append(card);
+        }
+    }
+    return shown;
+}
+
+// Sends one batch of a journal replay, skipping the cards that are no
+// longer where the journal saw them
+void replayOn(ImapClient* client, const JournalBatch& batch,
+              const std::function<void(const ReplayResult& result)>& finished) {
+    client->findUids(batch.mailbox, uidSet(batch.uids), [client, batch, finished](bool ok, quint32 uidValidity,
+                                                                                 const QList<quint32>& found) {
+        ReplayResult result;
+        result.sent = client->isAuthenticated();
+        if (!ok) {
+            // E.g. the mailbox is gone
+            result.conflicts = batch.uids;
+            result.reason = client->lastError();
+            result.ok = true;
+            finished(result);
+            return;
+        }
+
+        QList<quint32> present;
+        if (batch.uidValidity != 0 && uidValidity != batch.uidValidity) {
+            result.conflicts = batch.uids;
+            result.reason = "The mailbox was recreated (UIDVALIDITY changed)";
+        } else {
+            for (quint32 uid : batch.uids) {
+                if (found.contains(uid)) {
+                    present.append(uid);
+                } else {
+                    result.conflicts.append(uid);
+                }
+            }
+            result.reason = "The message no longer exists";
+        }
+        if (present.isEmpty()) {
+            result.ok = true;
+            finished(result);
+            return;
+        }
+
+        auto moved = [client, result, finished](bool ok, const QHash<quint32, quint32>& movedUids) {
+            ReplayResult sent = result;
+            sent.sent = ok || client->isAuthenticated();
+            sent.ok = ok;
+            sent.moved = movedUids;
+            sent.message = ok ? QString() : client->lastError();
+            finished(sent);
+        };
+        auto done = [moved](bool ok) {
+            moved(ok, QHash<quint32, quint32>());
+        };
+        const QString uids = uidSet(present);
+        switch (batch.operation) {
+        case JournalEntry::MarkRead:
+            client->markAsRead(uids, batch.value, batch.mailbox, done);
+            break;
+        case JournalEntry::MarkFlagged:
+            client->markAsFlagged(uids, batch.value, batch.mailbox, done);
+            break;
+        case JournalEntry::Move:
+            client->moveCard(uids, batch.mailbox, batch.target, moved);
+            break;
+        case JournalEntry::Delete:
+            client->deleteCard(uids, batch.mailbox, done);
+            break;
+        }
+    });
+}
+
+} // namespace
 
 KanbanModel::KanbanModel(QObject* parent)
     : QObject(parent)
-    , m_imapClient(new ImapClient(this))
+    , m_worker(new ImapWorker(true, this))
     , m_autoRefreshTimer(new QTimer(this))
+    , m_cacheTimer(new QTimer(this))
+    , m_authenticated(false)
     , m_autoRefreshEnabled(false)
+    , m_pendingRefreshes(0)
+    , m_pendingReplays(0)
 {
-    connect(m_imapClient, &ImapClient::connected, this, &KanbanModel::onImapConnected);
-    connect(m_imapClient, &ImapClient::disconnected, this, &KanbanModel::onImapDisconnected);
-    connect(m_imapClient, &ImapClient::authenticated, this, &KanbanModel::onImapAuthenticated);
-    connect(m_imapClient, &ImapClient::error, this, &KanbanModel::onImapError);
+    // The client lives on the IMAP thread, so these are queued connections
+    ImapClient* client = m_worker->pool()->interactive();
+    connect(client, &ImapClient::connected, this, &KanbanModel::onImapConnected);
+    connect(client, &ImapClient::disconnected, this, &KanbanModel::onImapDisconnected);
+    connect(client, &ImapClient::authenticated, this, &KanbanModel::onImapAuthenticated);
+    connect(client, &ImapClient::error, this, &KanbanModel::onImapError);
+    connect(client, &ImapClient::mailboxChanged, this, &KanbanModel::onImapMailboxChanged);
     
     connect(m_autoRefreshTimer, &QTimer::timeout, this, &KanbanModel::onAutoRefreshTimer);
     m_autoRefreshTimer->setSingleShot(false);
+
+    connect(this, &KanbanModel::mailboxUpdated, this, &KanbanModel::onMailboxUpdated);
+    connect(m_cacheTimer, &QTimer::timeout, this, &KanbanModel::writeCache);
+    m_cacheTimer->setSingleShot(true);
+    m_cacheTimer->setInterval(kCacheWriteDelayMs);
 }
 
 KanbanModel::~KanbanModel() {
     disconnectFromServer();
+    // Runs what was posted, including the final cache write, before the
+    // IMAP thread stops
+    delete m_worker;
 }
 
 bool KanbanModel::connectToServer() {
@@ -43,23 +202,35 @@ bool KanbanModel::connectToServer() {
         return false;
     }
 
-    m_imapClient->connectToServer(m_settings);
+    m_journal.setAccount(m_settings.imapServer(), m_settings.username());
+    loadCache();
+    const Settings settings = m_settings;
+    m_worker->post([settings](ImapConnectionPool* pool) {
+        pool->open(settings);
+    });
     return true;
 }
 
 void KanbanModel::disconnectFromServer() {
     stopAutoRefresh();
-    m_imapClient->disconnectFromServer();
+    // The sync states the cache is written with go away with the pool
+    writeCache();
+    m_worker->post([](ImapConnectionPool* pool) {
+        pool->close();
+    });
+    m_authenticated = false;
     m_availableMailboxes.clear();
+    m_mailboxInfo.clear();
     m_mailboxLists.clear();
+    m_fetchingOlder.clear();
 }
 
 bool KanbanModel::isConnected() const {
-    return m_imapClient->isAuthenticated();
+    return m_authenticated;
 }
 
 QString KanbanModel::lastError() const {
-    return m_lastError.isEmpty() ? m_imapClient->lastError() : m_lastError;
+    return m_lastError;
 }
 
 Settings& KanbanModel::settings() {
@@ -82,8 +253,17 @@ QStringList KanbanModel::visibleMailboxes() const {
     return m_settings.visibleMailboxes();
 }
 
+MailboxInfo KanbanModel::mailboxInfo(const QString& mailbox) const {
+    return m_mailboxInfo.value(mailbox);
+}
+
 void KanbanModel::setVisibleMailboxes(const QStringList& mailboxes) {
     m_settings.setVisibleMailboxes(mailboxes);
+    m_worker->post([mailboxes](ImapConnectionPool* pool) {
+        if (pool->interactive()->isWatching()) {
+            pool->interactive()->watchMailboxes(mailboxes);
+        }
+    });
     emit mailboxesChanged();
 }
 
@@ -91,6 +271,10 @@ MailboxList KanbanModel::mailboxList(const QString& mailbox) const {
     return m_mailboxLists.value(mailbox, MailboxList(mailbox));
 }
 
+bool KanbanModel::hasCards() const {
+    return !m_mailboxLists.isEmpty();
+}
+
 QList<MailboxList> KanbanModel::allMailboxLists() const {
     QList<MailboxList> lists;
     const QStringList visible = visibleMailboxes();
@@ -108,109 +292,239 @@ EmailCard KanbanModel::card(const QString& uid, const QString& mailbox) const {
 }
 
 bool KanbanModel::moveCard(const QString& uid, const QString& fromMailbox, const QString& toMailbox) {
-    if (!isConnected()) {
-        m_lastError = "Not connected to IMAP server";
-        emit error(m_lastError);
-        return false;
+    return applyCardOperation(JournalEntry::Move, fromMailbox, QStringList{uid}, toMailbox, false);
+}
+
+bool KanbanModel::deleteCard(const QString& uid, const QString& mailbox) {
+    return applyCardOperation(JournalEntry::Delete, mailbox, QStringList{uid}, QString(), false);
+}
+
+bool KanbanModel::markCardAsRead(const QString& uid, const QString& mailbox, bool read) {
+    return applyCardOperation(JournalEntry::MarkRead, mailbox, QStringList{uid}, QString(), read);
+}
+
+bool KanbanModel::markCardAsFlagged(const QString& uid, const QString& mailbox, bool flagged) {
+    return applyCardOperation(JournalEntry::MarkFlagged, mailbox, QStringList{uid}, QString(), flagged);
+}
+
+bool KanbanModel::moveCards(const QHash<QString, QStringList>& uids, const QString& toMailbox) {
+    bool applied = false;
+    for (auto it = uids.constBegin(); it != uids.constEnd(); ++it) {
+        applied |= applyCardOperation(JournalEntry::Move, it.key(), it.value(), toMailbox, false);
     }
+    return applied;
+}
 
-    if (m_imapClient->moveCard(uid, fromMailbox, toMailbox)) {
-        // Update local model
-        if (m_mailboxLists.contains(fromMailbox)) {
-            EmailCard card = m_mailboxLists[fromMailbox].card(uid);
-            m_mailboxLists[fromMailbox].removeCard(uid);
-            
-            if (m_mailboxLists.contains(toMailbox)) {
-                m_mailboxLists[toMailbox].addCard(card);
-            }
-        }
-        
-        emit cardMoved(uid, fromMailbox, toMailbox);
-        emit mailboxUpdated(fromMailbox);
-        emit mailboxUpdated(toMailbox);
-        return true;
+bool KanbanModel::deleteCards(const QHash<QString, QStringList>& uids) {
+    bool applied = false;
+    for (auto it = uids.constBegin(); it != uids.constEnd(); ++it) {
+        applied |= applyCardOperation(JournalEntry::Delete, it.key(), it.value(), QString(), false);
     }
-    
-    m_lastError = m_imapClient->lastError();
-    emit error(m_lastError);
-    return false;
+    return applied;
 }
 
-bool KanbanModel::deleteCard(const QString& uid, const QString& mailbox) {
-    if (!isConnected()) {
-        m_lastError = "Not connected to IMAP server";
-        emit error(m_lastError);
-        return false;
+bool KanbanModel::markCardsAsRead(const QHash<QString, QStringList>& uids, bool read) {
+    bool applied = false;
+    for (auto it = uids.constBegin(); it != uids.constEnd(); ++it) {
+        applied |= applyCardOperation(JournalEntry::MarkRead, it.key(), it.value(), QString(), read);
     }
+    return applied;
+}
 
-    if (m_imapClient->deleteCard(uid, mailbox)) {
-        // Update local model
-        if (m_mailboxLists.contains(mailbox)) {
-            m_mailboxLists[mailbox].removeCard(uid);
-        }
-        
-        emit cardDeleted(uid, mailbox);
-        emit mailboxUpdated(mailbox);
-        return true;
+bool KanbanModel::markCardsAsFlagged(const QHash<QString, QStringList>& uids, bool flagged) {
+    bool applied = false;
+    for (auto it = uids.constBegin(); it != uids.constEnd(); ++it) {
+        applied |= applyCardOperation(JournalEntry::MarkFlagged, it.key(), it.value(), QString(), flagged);
     }
-    
-    m_lastError = m_imapClient->lastError();
-    emit error(m_lastError);
-    return false;
+    return applied;
 }
 
-bool KanbanModel::markCardAsRead(const QString& uid, const QString& mailbox, bool read) {
-    if (!isConnected()) {
-        m_lastError = "Not connected to IMAP server";
+bool KanbanModel::applyCardOperation(JournalEntry::Operation operation, const QString& mailbox,
+                                     const QStringList& uids, const QString& target, bool value) {
+    const bool offline = !isConnected() || !m_journal.isEmpty();
+    QList<EmailCard> before;        // As they were, for a rollback
+    QList<quint64> placeholders;    // Move: in step with before
+    QList<quint32> unloaded;        // Sent by UID alone, nothing to show
+    QString problem;
+    int skipped = 0;
+    for (const QString& uid : uids) {
+        const EmailCard current = card(uid, mailbox);
+        if (!offline && !current.isValid()) {
+            // Outside the card window or in a column that is not shown; the
+            // server tells whether the message is there
+            bool ok = false;
+            const quint32 number = uid.toUInt(&ok);
+            if (ok && number > 0) {
+                unloaded.append(number);
+                continue;
+            }
+        }
+        // Shown in the target under a placeholder until the server has it
+        const quint64 placeholder = operation == JournalEntry::Move ? m_journal.placeholderKey() : 0;
+        QString reason;
+        if (offline) {
+            JournalEntry entry;
+            entry.operation = operation;
+            entry.target = target;
+            entry.targetUid = placeholder;
+            entry.value = value;
+            reason = queueOperation(entry, current, mailbox);
+        } else {
+            reason = sendProblem(current);
+        }
+        if (!reason.isEmpty()) {
+            problem = reason;
+            ++skipped;
+            continue;
+        }
+        before.append(current);
+        placeholders.append(placeholder);
+    }
+
+    if (skipped > 0) {
+        m_lastError = uids.size() == 1 ? problem
+            : QString("%1 of %2 cards were skipped: %3").arg(skipped).arg(uids.size()).arg(problem);
         emit error(m_lastError);
+    }
+    if (before.isEmpty() && unloaded.isEmpty()) {
         return false;
     }
 
-    if (m_imapClient->markAsRead(uid, read, mailbox)) {
-        // Update local model
-        if (m_mailboxLists.contains(mailbox)) {
-            EmailCard card = m_mailboxLists[mailbox].card(uid);
-            if (card.isValid()) {
-                card.setRead(read);
-                m_mailboxLists[mailbox].updateCard(card);
-            }
+    // One batch per column, however many cards it covers
+    QList<EmailCard> updated;
+    QStringList removed;
+    QList<EmailCard> added;     // To the target
+    QList<quint32> uidNumbers;
+    for (int i = 0; i < before.size(); ++i) {
+        EmailCard changed = before.at(i);
+        uidNumbers.append(changed.uidNumber());
+        switch (operation) {
+        case JournalEntry::MarkRead:
+            changed.setRead(value);
+            updated.append(changed);
+            break;
+        case JournalEntry::MarkFlagged:
+            changed.setFlagged(value);
+            updated.append(changed);
+            break;
+        case JournalEntry::Move:
+            removed.append(changed.uid());
+            changed.setKey(placeholders.at(i));
+            added.append(changed);
+            break;
+        case JournalEntry::Delete:
+            removed.append(changed.uid());
+            break;
         }
-        
-        emit cardUpdated(uid, mailbox);
-        emit mailboxUpdated(mailbox);
+    }
+    changeCards(mailbox, updated, removed);
+    if (operation == JournalEntry::Move) {
+        changeCards(target, added);
+    }
+
+    for (const EmailCard& changed : before) {
+        switch (operation) {
+        case JournalEntry::MarkRead:
+        case JournalEntry::MarkFlagged:
+            emit cardUpdated(changed.uid(), mailbox);
+            break;
+        case JournalEntry::Move:
+            emit cardMoved(changed.uid(), mailbox, target);
+            break;
+        case JournalEntry::Delete:
+            emit cardDeleted(changed.uid(), mailbox);
+            break;
+        }
+    }
+    if (offline) {
+        reportQueuedLater();
         return true;
     }
-    
-    m_lastError = m_imapClient->lastError();
-    emit error(m_lastError);
-    return false;
+
+    // A single command for the whole group, loaded or not
+    const QString set = uidSet(uidNumbers + unloaded);
+    runOperation(operation, [operation, mailbox, set, target, value](ImapClient* client,
+                                                                     ImapClient::MoveCallback callback) {
+        auto done = [callback](bool ok) {
+            callback(ok, QHash<quint32, quint32>());
+        };
+        switch (operation) {
+        case JournalEntry::MarkRead:
+            client->markAsRead(set, value, mailbox, done);
+            break;
+        case JournalEntry::MarkFlagged:
+            client->markAsFlagged(set, value, mailbox, done);
+            break;
+        case JournalEntry::Move:
+            client->moveCard(set, mailbox, target, callback);
+            break;
+        case JournalEntry::Delete:
+            client->deleteCard(set, mailbox, done);
+            break;
+        }
+    }, [this, operation, mailbox, target, before, placeholders, unloaded](bool ok,
+                                                                          const QHash<quint32, quint32>& moved) {
+        if (ok) {
+            if (operation == JournalEntry::Move) {
+                QList<quint32> sources;
+                for (const EmailCard& card : before) {
+                    sources.append(card.uidNumber());
+                }
+                // Without COPYUID an incremental refresh brings the moved
+                // cards with their new UIDs, which then replace the placeholders
+                const QList<quint64> unsettled = settleMovedCards(target, sources, placeholders, moved);
+                if (!unsettled.isEmpty()) {
+                    m_settledPlaceholders[target] += unsettled;
+                }
+                // Cards that were not loaded only show up with a refresh
+                if (!unsettled.isEmpty() || (!unloaded.isEmpty() && m_mailboxLists.contains(target))) {
+                    refreshMailbox(target);
+                }
+            }
+            return;
+        }
+        rollBack(operation, mailbox, target, before, placeholders);
+    });
+    return true;
 }
 
-bool KanbanModel::markCardAsFlagged(const QString& uid, const QString& mailbox, bool flagged) {
-    if (!isConnected()) {
-        m_lastError = "Not connected to IMAP server";
-        emit error(m_lastError);
-        return false;
+void KanbanModel::rollBack(JournalEntry::Operation operation, const QString& mailbox, const QString& target,
+                           const QList<EmailCard>& before, const QList<quint64>& placeholders) {
+    QList<EmailCard> restored;
+    for (const EmailCard& card : before) {
+        if (operation == JournalEntry::Move || operation == JournalEntry::Delete) {
+            restored.append(card);
+            continue;
+        }
+        // Only the flag is put back; the card may have changed since
+        EmailCard current = this->card(card.uid(), mailbox);
+        if (!current.isValid()) {
+            continue;
+        }
+        if (operation == JournalEntry::MarkRead) {
+            current.setRead(card.isRead());
+        } else {
+            current.setFlagged(card.isFlagged());
+        }
+        restored.append(current);
     }
+    changeCards(mailbox, restored);
 
-    if (m_imapClient->markAsFlagged(uid, flagged, mailbox)) {
-        // Update local model
-        if (m_mailboxLists.contains(mailbox)) {
-            EmailCard card = m_mailboxLists[mailbox].card(uid);
-            if (card.isValid()) {
-                card.setFlagged(flagged);
-                m_mailboxLists[mailbox].updateCard(card);
-            }
+    if (operation == JournalEntry::Move) {
+        QStringList moved;
+        for (quint64 placeholder : placeholders) {
+            moved.append(QString::number(placeholder));
         }
-        
-        emit cardUpdated(uid, mailbox);
-        emit mailboxUpdated(mailbox);
-        return true;
+        changeCards(target, QList<EmailCard>(), moved);
     }
-    
-    m_lastError = m_imapClient->lastError();
-    emit error(m_lastError);
-    return false;
+}
+
+int KanbanModel::pendingOperations() const {
+    return m_journal.size();
+}
+
+LatencyStats KanbanModel::confirmationLatency(JournalEntry::Operation operation) const {
+    return m_confirmationLatency.value(operation);
 }
 
 void KanbanModel::refreshAll() {
@@ -229,9 +543,155 @@ void KanbanModel::refreshMailbox(const QString& mailbox) {
         return;
     }
 
-    QList<EmailCard> cards = m_imapClient->fetchCards(mailbox);
-    updateMailboxList(mailbox, cards);
-    emit mailboxUpdated(mailbox);
+    ++m_pendingRefreshes;
+    auto refreshed = [this]() {
+        if (--m_pendingRefreshes == 0) {
+            updateSchedulerMetrics();
+            emit refreshFinished();
+        }
+    };
+    auto finished = m_worker->reply<bool, MailboxChanges>([this, mailbox, refreshed](bool ok,
+                                                                                   const MailboxChanges& changes) {
+        if (ok) {
+            applyChanges(mailbox, changes);
+            if (changes.fullResync || !changes.cards.isEmpty()) {
+                refreshThreads(mailbox);
+            }
+        }
+        refreshed();
+    });
+    // Neither a success nor a failure: the refresh it was merged into reports
+    auto merged = m_worker->reply<>(refreshed);
+    
+    // Columns refresh on the pool's background connections, leaving the
+    // interactive one free for user actions. A refresh of a column that is
+    // already waiting for one is merged into it.
+    m_worker->post([mailbox, finished, merged](ImapConnectionPool* pool) {
+        pool->scheduler()->submit(CommandScheduler::VisibleRefresh, mailbox, "sync:" + mailbox,
+                                  [mailbox, finished](ImapClient* client, const std::function<void()>& done) {
+            if (!client) {
+                finished(false, MailboxChanges());
+                return;
+            }
+            client->syncCards(mailbox, [finished, done](bool ok, const MailboxChanges& changes) {
+                done();
+                finished(ok, changes);
+            });
+        }, merged);
+    });
+}
+
+bool KanbanModel::isRefreshing() const {
+    return m_pendingRefreshes > 0;
+}
+
+CommandScheduler::Metrics KanbanModel::schedulerMetrics() const {
+    return m_schedulerMetrics;
+}
+
+bool KanbanModel::hasOlderCards(const QString& mailbox) const {
+    return m_mailboxLists.value(mailbox).hasOlderCards();
+}
+
+bool KanbanModel::fetchOlderCards(const QString& mailbox, int count) {
+    if (count <= 0) {
+        count = m_settings.cardWindow();
+    }
+    if (!isConnected() || count <= 0 || !hasOlderCards(mailbox) || m_fetchingOlder.contains(mailbox)) {
+        return false;
+    }
+
+    const quint32 before = m_mailboxLists.value(mailbox).oldestUid();
+    const int loaded = m_mailboxLists.value(mailbox).cardCount();
+    m_fetchingOlder.insert(mailbox);
+    auto finished = m_worker->reply<bool, QList<EmailCard>>([this, mailbox, count](bool ok,
+                                                                                  const QList<EmailCard>& cards) {
+        m_fetchingOlder.remove(mailbox);
+        auto it = m_mailboxLists.find(mailbox);
+        if (ok && it != m_mailboxLists.end()) {
+            QList<EmailCard> older;
+            for (const EmailCard& card : withoutDeleted(cards)) {
+                if (!it->hasCard(card.uid())) {
+                    older.append(card);
+                }
+            }
+            // A short page means the oldest message has been reached
+            const bool hadOlder = it->hasOlderCards();
+            it->setHasOlderCards(cards.size() >= count);
+            if (!changeCards(mailbox, older) && hadOlder != it->hasOlderCards()) {
+                emit mailboxUpdated(mailbox);
+            }
+        }
+        emit olderCardsFetched(mailbox, ok);
+    });
+
+    // Pages of older cards wait for the refreshes of visible columns
+    m_worker->post([mailbox, before, loaded, count, finished](ImapConnectionPool* pool) {
+        pool->scheduler()->submit(CommandScheduler::BackgroundPrefetch, mailbox, QString(),
+                                  [mailbox, before, loaded, count, finished](ImapClient* client,
+                                                                             const std::function<void()>& done) {
+            if (!client) {
+                finished(false, QList<EmailCard>());
+                return;
+            }
+            client->fetchOlderCards(mailbox, before, loaded, count, [finished, done](bool ok,
+                                                                                   const QList<EmailCard>& cards) {
+                done();
+                finished(ok, cards);
+            });
+        });
+    });
+    return true;
+}
+
+bool KanbanModel::isFetchingOlderCards(const QString& mailbox) const {
+    return m_fetchingOlder.contains(mailbox);
+}
+
+QStringList KanbanModel::conversation(const QString& uid, const QString& mailbox) const {
+    const QHash<quint32, quint32> threads = m_threads.value(mailbox);
+    const quint32 thread = threads.value(uid.toUInt());
+    if (thread == 0) {
+        return QStringList{uid};
+    }
+    QStringList uids;
+    for (const EmailCard& card : m_mailboxLists.value(mailbox).cards()) {
+        if (threads.value(card.uidNumber()) == thread) {
+            uids.append(card.uid());
+        }
+    }
+    return uids;
+}
+
+void KanbanModel::refreshThreads(const QString& mailbox) {
+    auto finished = m_worker->reply<bool, QList<QList<quint32>>>([this, mailbox](bool ok,
+                                                                               const QList<QList<quint32>>& threads) {
+        if (!ok) {
+            return;
+        }
+        QHash<quint32, quint32> roots;
+        for (const QList<quint32>& thread : threads) {
+            for (quint32 uid : thread) {
+                roots.insert(uid, thread.first());
+            }
+        }
+        m_threads.insert(mailbox, roots);
+    });
+
+    // Threads only group cards already shown, so they wait like older pages
+    m_worker->post([mailbox, finished](ImapConnectionPool* pool) {
+        pool->scheduler()->submit(CommandScheduler::BackgroundPrefetch, mailbox, "threads:" + mailbox,
+                                  [mailbox, finished](ImapClient* client, const std::function<void()>& done) {
+            if (!client) {
+                finished(false, QList<QList<quint32>>());
+                return;
+            }
+            client->fetchThreads(mailbox, [finished, done](bool ok, const QList<QList<quint32>>& threads) {
+                done();
+                finished(ok, threads);
+            });
+        });
+    });
 }
 
 void KanbanModel::setAutoRefresh(bool enabled) {
@@ -241,6 +701,13 @@ void KanbanModel::setAutoRefresh(bool enabled) {
         startAutoRefresh();
     } else {
         stopAutoRefresh();
+        if (isConnected()) {
+            m_worker->post([](ImapConnectionPool* pool) {
+                if (pool->interactive()->isWatching()) {
+                    pool->interactive()->watchMailboxes(QStringList());
+                }
+            });
+        }
     }
 }
 
@@ -248,37 +715,85 @@ bool KanbanModel::autoRefreshEnabled() const {
     return m_autoRefreshEnabled;
 }
 
+QString KanbanModel::activeMailbox() const {
+    if (!m_activeMailbox.isEmpty()) {
+        return m_activeMailbox;
+    }
+    const QStringList visible = visibleMailboxes();
+    return visible.isEmpty() ? QString() : visible.first();
+}
+
+void KanbanModel::setActiveMailbox(const QString& mailbox) {
+    if (m_activeMailbox == mailbox) {
+        return;
+    }
+    m_activeMailbox = mailbox;
+    
+    if (m_autoRefreshEnabled && isConnected()) {
+        m_worker->post([mailbox](ImapConnectionPool* pool) {
+            if (pool->interactive()->hasCapability("IDLE")) {
+                pool->interactive()->startIdle(mailbox);
+            }
+        });
+    }
+}
+
 void KanbanModel::onImapConnected() {
     // Authenticate automatically
-    m_imapClient->authenticate(m_settings.username(), m_settings.password());
+    const QString username = m_settings.username();
+    const QString password = m_settings.password();
+    m_worker->post([username, password](ImapConnectionPool* pool) {
+        pool->interactive()->authenticate(username, password);
+    });
 }
 
 void KanbanModel::onImapDisconnected() {
     stopAutoRefresh();
-    m_availableMailboxes.clear();
-    m_mailboxLists.clear();
+    writeCache();
+    // Background connections belong to the session that just ended
+    m_worker->post([](ImapConnectionPool* pool) {
+        pool->close();
+    });
+    m_authenticated = false;
+    // The cards stay, so work can go on offline; operations on them are
+    // journaled and replayed once connected again
+    m_fetchingOlder.clear();
     emit disconnected();
 }
 
 void KanbanModel::onImapAuthenticated() {
-    // Fetch available mailboxes
-    m_availableMailboxes = m_imapClient->listMailboxes();
-    
-    // If no visible mailboxes are configured, use all available ones
-    if (m_settings.visibleMailboxes().isEmpty()) {
-        m_settings.setVisibleMailboxes(m_availableMailboxes);
-    }
-    
-    emit connected();
-    emit mailboxesChanged();
-    
-    // Start auto-refresh if enabled
-    if (m_autoRefreshEnabled) {
-        startAutoRefresh();
-    }
-    
-    // Initial refresh
-    refreshAll();
+    m_authenticated = true;
+
+    // Fetch available mailboxes along with their counts
+    auto listed = m_worker->reply<bool, QList<MailboxInfo>>([this](bool ok, const QList<MailboxInfo>& mailboxes) {
+        Q_UNUSED(ok)
+        setMailboxInfo(mailboxes);
+        
+        // If no visible mailboxes are configured, use all available ones
+        if (m_settings.visibleMailboxes().isEmpty()) {
+            m_settings.setVisibleMailboxes(m_availableMailboxes);
+        }
+        
+        emit connected();
+        emit mailboxesChanged();
+        
+        // Initial refresh. Queued first, so the mailbox status reported when
+        // auto-refresh starts watching already matches the synchronized state.
+        // Operations made offline go to the server before it.
+        if (m_journal.isEmpty()) {
+            refreshAll();
+        } else {
+            replayJournal();
+        }
+        
+        // Start auto-refresh if enabled
+        if (m_autoRefreshEnabled) {
+            startAutoRefresh();
+        }
+    });
+    m_worker->post([listed](ImapConnectionPool* pool) {
+        pool->interactive()->listMailboxInfo(listed);
+    });
 }
 
 void KanbanModel::onImapError(const QString& message) {
@@ -286,18 +801,563 @@ void KanbanModel::onImapError(const QString& message) {
     emit error(message);
 }
 
+void KanbanModel::onImapMailboxChanged(const QString& mailbox, const MailboxChanges& changes,
+                                       bool refreshNeeded) {
+    applyChanges(mailbox, changes);
+    if (refreshNeeded && visibleMailboxes().contains(mailbox)) {
+        refreshMailbox(mailbox);
+    }
+}
+
 void KanbanModel::onAutoRefreshTimer() {
+    // Skip the tick while the previous refresh is still in progress
+    if (m_pendingRefreshes != 0 || !isConnected()) {
+        return;
+    }
+
+    // The mailbox watched with IDLE is kept up to date by the server; for the
+    // others a cheap STATUS check decides which columns need a refresh
+    const QStringList visible = visibleMailboxes();
+    m_worker->post([visible](ImapConnectionPool* pool) {
+        ImapClient* client = pool->interactive();
+        QStringList mailboxes = visible;
+        mailboxes.removeAll(client->idleMailbox());
+        client->pollStatus(mailboxes);
+    });
+}
+
+void KanbanModel::runOperation(JournalEntry::Operation kind, const Command& command,
+                               const ImapClient::MoveCallback& confirmed) {
+    QElapsedTimer timer;
+    timer.start();
+    auto finished = m_worker->reply<bool, QString, QHash<quint32, quint32>>(
+            [this, kind, timer, confirmed](bool ok, const QString& message, const QHash<quint32, quint32>& moved) {
+        m_confirmationLatency[kind].record(timer.nsecsElapsed(), ok);
+        qDebug() << "OPERATION:" << operationName(kind) << (ok ? "confirmed" : "rejected") << "after"
+                 << timer.elapsed() << "ms";
+        confirmed(ok, moved);
+        if (!ok) {
+            reportOperationFailure(message);
+            return;
+        }
+        emit operationFinished(true);
+    });
+    m_worker->post([command, finished](ImapConnectionPool* pool) {
+        pool->scheduler()->submit(CommandScheduler::Interactive, QString(), QString(),
+                                  [command, finished](ImapClient* client, const std::function<void()>& done) {
+            if (!client) {
+                finished(false, "Not connected to server", QHash<quint32, quint32>());
+                return;
+            }
+            command(client, [client, finished, done](bool ok, const QHash<quint32, quint32>& moved) {
+                done();
+                finished(ok, ok ? QString() : client->lastError(), moved);
+            });
+        });
+    });
+}
+
+void KanbanModel::updateSchedulerMetrics() {
+    auto snapshot = m_worker->reply<CommandScheduler::Metrics>([this](const CommandScheduler::Metrics& metrics) {
+        m_schedulerMetrics = metrics;
+        qDebug() << "SCHEDULER: max queued" << metrics.maxQueueDepth[CommandScheduler::VisibleRefresh]
+                 << "refreshes," << metrics.coalesced << "coalesced; interactive wait p95"
+                 << metrics.waitTime[CommandScheduler::Interactive].percentileMs(0.95) << "ms";
+    });
+    m_worker->post([snapshot](ImapConnectionPool* pool) {
+        snapshot(pool->scheduler()->metrics());
+    });
+}
+
+void KanbanModel::reportOperationFailure(const QString& message) {
+    m_lastError = message;
+    emit error(m_lastError);
+    emit operationFinished(false);
+}
+
+void KanbanModel::reportQueuedLater() {
+    // Reported from the event loop, like operations that went to the server
+    QMetaObject::invokeMethod(this, [this]() {
+        emit operationQueued();
+    }, Qt::QueuedConnection);
+}
+
+QList<quint64> KanbanModel::settleMovedCards(const QString& mailbox, const QList<quint32>& sources,
+                                             const QList<quint64>& placeholders,
+                                             const QHash<quint32, quint32>& moved) {
+    if (!m_mailboxLists.contains(mailbox)) {
+        return QList<quint64>();
+    }
+
+    QList<quint64> unsettled;
+    QStringList settled;
+    QList<EmailCard> cards;
+    for (int i = 0; i < placeholders.size() && i < sources.size(); ++i) {
+        const QString placeholder = QString::number(placeholders.at(i));
+        const quint32 uid = moved.value(sources.at(i));
+        EmailCard card = this->card(placeholder, mailbox);
+        if (uid == 0 || !card.isValid()) {
+            unsettled.append(placeholders.at(i));
+            continue;
+        }
+        settled.append(placeholder);
+        card.setUid(uid);
+        cards.append(card);
+    }
+    changeCards(mailbox, cards, settled);
+    return unsettled;
+}
+
+void KanbanModel::removeLocalCard(const QString& uid, const QString& mailbox) {
+    changeCards(mailbox, QList<EmailCard>(), QStringList{uid});
+}
+
+QString KanbanModel::sendProblem(const EmailCard& card) const {
+    if (!card.isValid()) {
+        return "Card not found";
+    }
+    if (card.isPlaceholder()) {
+        // Its UID in the new mailbox is not known yet
+        return "The card is still being moved";
+    }
+    return QString();
+}
+
+QString KanbanModel::queueOperation(JournalEntry& entry, const EmailCard& card, const QString& mailbox) {
+    if (!card.isValid()) {
+        return isConnected() ? "Card not found" : "Not connected to IMAP server";
+    }
+    if (card.isPlaceholder()) {
+        // Only a move still in the journal can be followed up on
+        bool journaled = false;
+        for (const JournalEntry& queued : m_journal.entries()) {
+            journaled |= queued.targetUid == card.key();
+        }
+        if (!journaled) {
+            return "The card is still being moved";
+        }
+    }
+
+    entry.mailbox = mailbox;
+    entry.uid = card.key();
+    entry.uidValidity = m_syncStates.value(mailbox).uidValidity;
+    if (!m_journal.append(entry)) {
+        return "Could not write the operation journal";
+    }
+    return QString();
+}
+
+void KanbanModel::replayJournal() {
+    if (m_pendingReplays > 0) {
+        return;
+    }
+
+    const JournalReplay replay = m_journal.replay();
+    qDebug() << "JOURNAL: replaying" << m_journal.size() << "operations as" << replay.batches.size()
+             << "commands";
+    m_journal.remove(replay.cancelled);
+    m_resyncMailboxes += replay.resyncMailboxes;
+
+    m_pendingReplays = replay.batches.size();
+    if (m_pendingReplays == 0) {
+        finishReplay();
+        return;
+    }
+    for (const JournalBatch& batch : replay.batches) {
+        replayBatch(batch);
+    }
+}
+
+void KanbanModel::replayBatch(const JournalBatch& batch) {
+    auto finished = m_worker->reply<ReplayResult>([this, batch](const ReplayResult& result) {
+        // Batches cut off by a lost connection stay in the journal
+        if (result.sent) {
+            m_journal.remove(batch.entries);
+            for (quint32 uid : result.conflicts) {
+                emit operationConflict(QString::number(uid), batch.mailbox, result.reason);
+            }
+            if (!result.ok) {
+                m_lastError = result.message;
+                emit error(m_lastError);
+            }
+            if (!result.ok || !result.conflicts.isEmpty()) {
+                m_resyncMailboxes.insert(batch.mailbox);
+                if (batch.operation == JournalEntry::Move) {
+                    m_resyncMailboxes.insert(batch.target);
+                }
+            }
+            // Moved cards take the UIDs the server reported; the others come
+            // back from the target with theirs on the refresh that follows
+            const QList<quint64> unsettled = settleMovedCards(batch.target, batch.uids, batch.targetUids,
+                                                              result.moved);
+            for (quint64 placeholder : unsettled) {
+                removeLocalCard(QString::number(placeholder), batch.target);
+            }
+        }
+        if (--m_pendingReplays == 0) {
+            finishReplay();
+        }
+    });
+
+    m_worker->post([batch, finished](ImapConnectionPool* pool) {
+        pool->scheduler()->submit(CommandScheduler::Interactive, batch.mailbox, QString(),
+                                  [batch, finished](ImapClient* client, const std::function<void()>& done) {
+            if (!client) {
+                finished(ReplayResult());
+                return;
+            }
+            replayOn(client, batch, [finished, done](const ReplayResult& result) {
+                done();
+                finished(result);
+            });
+        });
+    });
+}
+
+void KanbanModel::finishReplay() {
+    // Cards that were moved back and forth, or whose operations failed, are
+    // put right by a full resync of their mailboxes
+    const QSet<QString> resync = m_resyncMailboxes;
+    m_resyncMailboxes.clear();
+    m_worker->post([resync](ImapConnectionPool* pool) {
+        for (const QString& mailbox : resync) {
+            pool->setSyncState(mailbox, MailboxSyncState());
+        }
+    });
+
+    if (!isConnected()) {
+        return;
+    }
+    // Operations made while the replay was under way
+    if (!m_journal.isEmpty()) {
+        replayJournal();
+        return;
+    }
     refreshAll();
 }
 
-void KanbanModel::updateMailboxList(const QString& mailbox, const QList<EmailCard>& cards) {
-    MailboxList& list = m_mailboxLists[mailbox];
-    list.setName(mailbox);
-    list.setCards(cards);
-    list.sortCards(MailboxList::DateDescending);
+bool KanbanModel::changeCards(const QString& mailbox, const QList<EmailCard>& cards, const QStringList& removed) {
+    auto it = m_mailboxLists.find(mailbox);
+    if (it == m_mailboxLists.end()) {
+        return false;
+    }
+    MailboxList& list = it.value();
+    QStringList present;
+    for (const QString& uid : removed) {
+        if (list.hasCard(uid)) {
+            present.append(uid);
+        }
+    }
+    if (cards.isEmpty() && present.isEmpty()) {
+        return false;
+    }
+
+    if (cards.size() + present.size() > kMaxRowChanges) {
+        const QList<EmailCard> before = list.cards();
+        list.removeCards(present);
+        list.addCards(cards);
+        return emitRowChanges(mailbox, before, list.hasOlderCards());
+    }
+
+    // Each card is changed in place and its rows reported at once, so the
+    // rows of one change are final when the next is made
+    bool changed = false;
+    for (const QString& uid : present) {
+        const int row = list.row(uid);
+        list.removeCard(uid);
+        emit cardsRemoved(mailbox, row, row);
+        changed = true;
+    }
+    for (const EmailCard& card : cards) {
+        const int from = list.row(card.uid());
+        if (!card.isValid() || (from >= 0 && list.card(card.uid()) == card)) {
+            continue;
+        }
+        list.addCard(card);
+        const int to = list.row(card.uid());
+        changed = true;
+        if (from < 0) {
+            emit cardsInserted(mailbox, to, to);
+            continue;
+        }
+        if (to != from) {
+            emit cardsMoved(mailbox, from, from, to > from ? to + 1 : to);
+        }
+        emit cardsChanged(mailbox, to, to);
+    }
+    if (changed) {
+        emit mailboxUpdated(mailbox);
+    }
+    return changed;
+}
+
+bool KanbanModel::emitRowChanges(const QString& mailbox, const QList<EmailCard>& before, bool hadOlderCards) {
+    const MailboxList& updated = m_mailboxLists[mailbox];
+    const QList<EmailCard> after = updated.cards();
+
+    QHash<quint64, int> beforeRows;
+    QHash<quint64, int> afterRows;
+    beforeRows.reserve(before.size());
+    afterRows.reserve(after.size());
+    for (int row = 0; row < before.size(); ++row) {
+        beforeRows.insert(before.at(row).key(), row);
+    }
+    for (int row = 0; row < after.size(); ++row) {
+        afterRows.insert(after.at(row).key(), row);
+    }
+
+    // The batch is worked out first, so that a reset can replace it
+    QList<RowChange> batch;
+
+    // Removals run from the end so that earlier rows keep their numbers
+    QList<quint64> current;
+    current.reserve(before.size());
+    for (int row = before.size() - 1; row >= 0; --row) {
+        if (afterRows.contains(before.at(row).key())) {
+            continue;
+        }
+        int first = row;
+        while (first > 0 && !afterRows.contains(before.at(first - 1).key())) {
+            --first;
+        }
+        batch.append({ RowChange::Removed, first, row, 0 });
+        row = first;
+    }
+    for (const EmailCard& card : before) {
+        if (afterRows.contains(card.key())) {
+            current.append(card.key());
+        }
+    }
+
+    // Cards that changed their place, e.g. a corrected date. Each move puts
+    // one card at its final row; a handful is cheaper than a rebuild.
+    bool reset = false;
+    int moves = 0;
+    int target = 0;
+    for (const EmailCard& card : after) {
+        if (!beforeRows.contains(card.key())) {
+            continue;
+        }
+        if (current.at(target) != card.key()) {
+            if (++moves > kMaxRowMoves) {
+                reset = true;
+                break;
+            }
+            int from = current.indexOf(card.key(), target + 1);
+            current.move(from, target);
+            batch.append({ RowChange::Moved, from, from, target });
+        }
+        ++target;
+    }
+
+    // Insertions and changes, in final rows
+    for (int pass = 0; pass < 2 && !reset; ++pass) {
+        const RowChange::Kind kind = pass == 0 ? RowChange::Inserted : RowChange::Changed;
+        for (int row = 0; row < after.size(); ++row) {
+            auto affected = [&](int r) {
+                const EmailCard& card = after.at(r);
+                auto it = beforeRows.constFind(card.key());
+                if (kind == RowChange::Inserted) {
+                    return it == beforeRows.constEnd();
+                }
+                return it != beforeRows.constEnd() && before.at(it.value()) != card;
+            };
+            if (!affected(row)) {
+                continue;
+            }
+            int last = row;
+            while (last + 1 < after.size() && affected(last + 1)) {
+                ++last;
+            }
+            batch.append({ kind, row, last, 0 });
+            row = last;
+        }
+    }
+
+    if (batch.isEmpty() && hadOlderCards == updated.hasOlderCards()) {
+        return false;
+    }
+
+    if (reset) {
+        emit mailboxReset(mailbox);
+    } else {
+        for (const RowChange& change : batch) {
+            switch (change.kind) {
+            case RowChange::Removed:
+                emit cardsRemoved(mailbox, change.first, change.last);
+                break;
+            case RowChange::Moved:
+                emit cardsMoved(mailbox, change.first, change.last, change.destination);
+                break;
+            case RowChange::Inserted:
+                emit cardsInserted(mailbox, change.first, change.last);
+                break;
+            case RowChange::Changed:
+                emit cardsChanged(mailbox, change.first, change.last);
+                break;
+            }
+        }
+    }
+    emit mailboxUpdated(mailbox);
+    return true;
+}
+
+void KanbanModel::loadCache() {
+    m_cache.setAccount(m_settings.imapServer(), m_settings.username());
+    // Cards already in memory are at least as fresh as the cache
+    if (!m_settings.cacheEnabled() || !m_mailboxLists.isEmpty()) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int cards = 0;
+    QHash<QString, MailboxSyncState> states;
+    for (const QString& mailbox : m_settings.visibleMailboxes()) {
+        MailboxList list;
+        MailboxSyncState state;
+        if (m_cache.load(mailbox, list, state)) {
+            list.sortCards(MailboxList::DateDescending);
+            cards += list.cardCount();
+            m_mailboxLists.insert(mailbox, list);
+            m_syncStates.insert(mailbox, state);
+            states.insert(mailbox, state);
+        }
+    }
+
+    // The first refresh then only asks for what changed since
+    m_worker->post([states](ImapConnectionPool* pool) {
+        for (auto it = states.constBegin(); it != states.constEnd(); ++it) {
+            pool->setSyncState(it.key(), it.value());
+        }
+    });
+
+    if (!m_mailboxLists.isEmpty()) {
+        qDebug() << "CACHE: loaded" << cards << "cards in" << timer.elapsed() << "ms";
+        emit mailboxesChanged();
+    }
+}
+
+void KanbanModel::onMailboxUpdated(const QString& mailbox) {
+    if (m_settings.cacheEnabled()) {
+        m_dirtyMailboxes.insert(mailbox);
+        m_cacheTimer->start();
+    }
+}
+
+void KanbanModel::writeCache() {
+    m_cacheTimer->stop();
+    if (m_dirtyMailboxes.isEmpty()) {
+        return;
+    }
+
+    // Each snapshot goes with the sync state of the changes applied to it.
+    // The connections' own states may already be ahead, with a sync whose
+    // result has not reached this thread: a delta from there would never
+    // fetch what the snapshot is missing. The files are written on the IMAP
+    // thread.
+    struct Snapshot {
+        QList<EmailCard> cards;
+        bool hasOlder;
+        MailboxSyncState state;
+    };
+    QHash<QString, Snapshot> snapshots;
+    for (const QString& mailbox : m_dirtyMailboxes) {
+        auto it = m_mailboxLists.constFind(mailbox);
+        if (it != m_mailboxLists.constEnd()) {
+            snapshots.insert(mailbox, { it->cards(), it->hasOlderCards(), m_syncStates.value(mailbox) });
+        }
+    }
+    m_dirtyMailboxes.clear();
+
+    const CardCache cache = m_cache;
+    m_worker->post([cache, snapshots](ImapConnectionPool*) {
+        CardCache writer = cache;
+        for (auto it = snapshots.constBegin(); it != snapshots.constEnd(); ++it) {
+            // A mailbox without a sync state is dropped from the cache
+            writer.store(it.key(), it->cards, it->hasOlder, it->state);
+        }
+    });
+}
+
+void KanbanModel::setMailboxInfo(const QList<MailboxInfo>& mailboxes) {
+    m_availableMailboxes.clear();
+    m_mailboxInfo.clear();
+    for (const MailboxInfo& info : mailboxes) {
+        m_mailboxInfo.insert(info.name, info);
+        // Hierarchy-only nodes cannot hold cards
+        if (info.isSelectable()) {
+            m_availableMailboxes.append(info.name);
+        }
+    }
+}
+
+void KanbanModel::applyChanges(const QString& mailbox, const MailboxChanges& changes) {
+    // Changes pushed by the server carry no sync state
+    if (changes.state.uidValidity != 0) {
+        m_syncStates.insert(mailbox, changes.state);
+    }
+
+    auto it = m_mailboxLists.find(mailbox);
+    if (it == m_mailboxLists.end()) {
+        it = m_mailboxLists.insert(mailbox, MailboxList(mailbox));
+    }
+
+    if (changes.fullResync) {
+        // Compared with the current cards by emitRowChanges(), so an
+        // unchanged mailbox still costs no widget updates. Placeholders of
+        // cards moved here go with the rest.
+        m_settledPlaceholders.remove(mailbox);
+        const QList<EmailCard> before = it->cards();
+        const bool hadOlder = it->hasOlderCards();
+        it->setCards(withoutDeleted(changes.cards));
+        it->setHasOlderCards(changes.hasOlder);
+        emitRowChanges(mailbox, before, hadOlder);
+        return;
+    }
+
+    // Cards moved here are shown under placeholders until the server has
+    // reported them; they go in the same batch as the real ones arrive.
+    // Changes pushed by the server carry no sync state and no new cards.
+    QStringList removed = changes.vanished;
+    if (changes.state.uidValidity != 0) {
+        for (quint64 placeholder : m_settledPlaceholders.take(mailbox)) {
+            removed.append(QString::number(placeholder));
+        }
+    }
+
+    const QSet<QString> vanished(changes.vanished.begin(), changes.vanished.end());
+    QList<EmailCard> cards;
+    for (auto flags = changes.flags.constBegin(); flags != changes.flags.constEnd(); ++flags) {
+        EmailCard card = it->card(flags.key());
+        if (!card.isValid() || vanished.contains(flags.key()) || card.hasSameFlags(flags.value())) {
+            continue;
+        }
+        card.setFlags(flags.value());
+        if (card.systemFlags() & EmailCard::Deleted) {
+            removed.append(flags.key());
+            continue;
+        }
+        cards.append(card);
+    }
+    cards += withoutDeleted(changes.cards);
+
+    changeCards(mailbox, cards, removed);
 }
 
 void KanbanModel::startAutoRefresh() {
+    // Push updates replace polling for the active mailbox; the timer still
+    // checks the other columns and servers without IDLE
+    const QString active = activeMailbox();
+    const QStringList visible = visibleMailboxes();
+    m_worker->post([active, visible](ImapConnectionPool* pool) {
+        ImapClient* client = pool->interactive();
+        if (client->hasCapability("IDLE") && !active.isEmpty()) {
+            client->startIdle(active);
+        }
+        // With NOTIFY every visible column reports changes on this connection
+        client->watchMailboxes(visible);
+    });
     if (m_settings.refreshInterval() > 0) {
         m_autoRefreshTimer->start(m_settings.refreshInterval() * 1000);
     }
@@ -305,4 +1365,7 @@ void KanbanModel::startAutoRefresh() {
 
 void KanbanModel::stopAutoRefresh() {
     m_autoRefreshTimer->stop();
+    m_worker->post([](ImapConnectionPool* pool) {
+        pool->interactive()->stopIdle();
+    });
 }
\ No newline at end of file
@@ -1,9 +1,15 @@
 #pragma once
 
 #include "imap_client.h"
+#include "imap_worker.h"
+#include "command_scheduler.h"
+#include "card_cache.h"
+#include "latency_stats.h"
+#include "operation_journal.h"
 #include "mailbox_list.h"
 #include "settings.h"
 #include <QObject>
+#include <QSet>
 #include <QTimer>
 
 class KanbanModel : public QObject {
@@ -28,24 +34,69 @@ public:
     QStringList availableMailboxes() const;
     QStringList visibleMailboxes() const;
     void setVisibleMailboxes(const QStringList& mailboxes);
+    // Hierarchy and server-side counts from the last mailbox listing
+    MailboxInfo mailboxInfo(const QString& mailbox) const;
     
     MailboxList mailboxList(const QString& mailbox) const;
     QList<MailboxList> allMailboxLists() const;
+    // True once any column has cards, from the server or the card cache
+    bool hasCards() const;
 
-    // Card operations
+    // Card operations. The change is shown at once and the card signals are
+    // emitted; false (and nothing changed) if it cannot be made at all.
+    // operationFinished() follows when the server has confirmed it; if the
+    // server rejects it, it is rolled back and error() is emitted as well.
+    // While offline operations are journaled, to be replayed when the
+    // connection is back; operationQueued() follows instead, as nothing
+    // has been applied on the server yet. While connected, cards that are
+    // not loaded (outside the card window, or in a column not shown) are
+    // sent by UID alone, with nothing to show or roll back.
     EmailCard card(const QString& uid, const QString& mailbox) const;
     bool moveCard(const QString& uid, const QString& fromMailbox, const QString& toMailbox);
     bool deleteCard(const QString& uid, const QString& mailbox);
     bool markCardAsRead(const QString& uid, const QString& mailbox, bool read = true);
     bool markCardAsFlagged(const QString& uid, const QString& mailbox, bool flagged = true);
+    // Bulk versions, taking UIDs keyed by the mailbox the cards are in. The
+    // cards of each mailbox go to the server as one command over a
+    // compressed UID set, and operationFinished() follows for each mailbox.
+    // Cards that cannot be acted on are skipped and reported with one
+    // error(); false if none could be.
+    bool moveCards(const QHash<QString, QStringList>& uids, const QString& toMailbox);
+    bool deleteCards(const QHash<QString, QStringList>& uids);
+    bool markCardsAsRead(const QHash<QString, QStringList>& uids, bool read = true);
+    bool markCardsAsFlagged(const QHash<QString, QStringList>& uids, bool flagged = true);
+    // Journaled operations not yet replayed
+    int pendingOperations() const;
+    // How long the server took to confirm (or reject) each kind of operation
+    LatencyStats confirmationLatency(JournalEntry::Operation operation) const;
 
     // Refresh operations
 
     void refreshAll();
     void refreshMailbox(const QString& mailbox);
+    bool isRefreshing() const;
+    // Queue depths and wait times of the IMAP work, as of the last refresh
+    CommandScheduler::Metrics schedulerMetrics() const;
+
+    // Columns hold the newest Settings::cardWindow() cards after a refresh.
+    // fetchOlderCards() appends the next page (count cards, or one window)
+    // and reports through olderCardsFetched(); false if nothing was sent.
+    bool hasOlderCards(const QString& mailbox) const;
+    bool fetchOlderCards(const QString& mailbox, int count = 0);
+    bool isFetchingOlderCards(const QString& mailbox) const;
+
+    // The loaded cards of the card's conversation, in display order, where
+    // the server groups messages into threads (THREAD, RFC 5256); else just
+    // the card. Threads are fetched again whenever a refresh brings cards.
+    QStringList conversation(const QString& uid, const QString& mailbox) const;
     void setAutoRefresh(bool enabled);
     bool autoRefreshEnabled() const;
 
+    // The mailbox the user is working in. With auto-refresh on it receives
+    // push updates (IDLE) where the server supports them.
+    QString activeMailbox() const;
+    void setActiveMailbox(const QString& mailbox);
+
     // Reload mailbox list from server
     void reloadMailboxes();
 
@@ -54,30 +105,107 @@ signals:
     void disconnected();
     void error(const QString& message);
     void mailboxesChanged();
+    // Row-level changes of a column, in the order of mailboxList().cards().
+    // Removed rows are numbered before the removal, moves follow
+    // QAbstractItemModel::beginMoveRows(), inserted and changed rows are the
+    // ones after the change. A few changed cards are reported one by one,
+    // each as it is made. A batch that would move many rows is sent as
+    // mailboxReset() instead. mailboxUpdated() follows every batch; nothing
+    // is emitted when a refresh changes nothing.
+    void cardsRemoved(const QString& mailbox, int first, int last);
+    void cardsMoved(const QString& mailbox, int first, int last, int destination);
+    void cardsInserted(const QString& mailbox, int first, int last);
+    void cardsChanged(const QString& mailbox, int first, int last);
+    void mailboxReset(const QString& mailbox);
     void mailboxUpdated(const QString& mailbox);
     void cardMoved(const QString& uid, const QString& fromMailbox, const QString& toMailbox);
     void cardDeleted(const QString& uid, const QString& mailbox);
     void cardUpdated(const QString& uid, const QString& mailbox);
+    void operationFinished(bool success);
+    // An operation was journaled, not sent (see pendingOperations())
+    void operationQueued();
+    // A journaled operation could not be replayed on the card, e.g. because
+    // the message is gone or its UID no longer means the same message
+    void operationConflict(const QString& uid, const QString& mailbox, const QString& reason);
+    void refreshFinished();
+    void olderCardsFetched(const QString& mailbox, bool success);
 
 private slots:
     void onImapConnected();
     void onImapDisconnected();
     void onImapAuthenticated();
     void onImapError(const QString& message);
+    void onImapMailboxChanged(const QString& mailbox, const MailboxChanges& changes, bool refreshNeeded);
     void onAutoRefreshTimer();
+    void onMailboxUpdated(const QString& mailbox);
+    void writeCache();
 
 private:
-    void updateMailboxList(const QString& mailbox, const QList<EmailCard>& cards);
+    // Adds or replaces cards of a loaded column and removes others, in
+    // place, then emits the rows; false if nothing changed. Large batches
+    // are compared with the column as it was instead.
+    bool changeCards(const QString& mailbox, const QList<EmailCard>& cards,
+                     const QStringList& removed = QStringList());
+    // Emits the rows that turned before into the column's current cards
+    bool emitRowChanges(const QString& mailbox, const QList<EmailCard>& before, bool hadOlderCards);
+    void setMailboxInfo(const QList<MailboxInfo>& mailboxes);
+    void applyChanges(const QString& mailbox, const MailboxChanges& changes);
     void startAutoRefresh();
     void stopAutoRefresh();
+    // Sends a card operation on the interactive connection. confirmed is
+    // called back here with the outcome, to keep or roll back the change;
+    // failures are then reported. Only moves report new UIDs.
+    using Command = std::function<void(ImapClient* client, ImapClient::MoveCallback callback)>;
+    void runOperation(JournalEntry::Operation kind, const Command& command,
+                      const ImapClient::MoveCallback& confirmed);
+    // The cards of one mailbox: applied locally, then sent or journaled
+    bool applyCardOperation(JournalEntry::Operation operation, const QString& mailbox, const QStringList& uids,
+                            const QString& target, bool value);
+    void rollBack(JournalEntry::Operation operation, const QString& mailbox, const QString& target,
+                  const QList<EmailCard>& before, const QList<quint64>& placeholders);
+    // Empty if the card can be sent, else why not
+    QString sendProblem(const EmailCard& card) const;
+    void updateSchedulerMetrics();
+    void refreshThreads(const QString& mailbox);
+    void reportOperationFailure(const QString& message);
+    void reportQueuedLater();
+    // Gives the placeholders of cards moved into the mailbox (in step with
+    // their source UIDs) the UIDs the server reported; returns the rest
+    QList<quint64> settleMovedCards(const QString& mailbox, const QList<quint32>& sources,
+                                    const QList<quint64>& placeholders, const QHash<quint32, quint32>& moved);
+    void removeLocalCard(const QString& uid, const QString& mailbox);
+    // Journals an operation on the card; empty if done, else why not
+    QString queueOperation(JournalEntry& entry, const EmailCard& card, const QString& mailbox);
+    void replayJournal();
+    void replayBatch(const JournalBatch& batch);
+    void finishReplay();
+    void loadCache();
 
-    ImapClient* m_imapClient;
+    ImapWorker* m_worker;       // Owns the connections, on the IMAP thread
     Settings m_settings;
     QTimer* m_autoRefreshTimer;
+    CardCache m_cache;
+    OperationJournal m_journal;
+    // As of the cards shown: the journal's UIDVALIDITY, and what the cache
+    // is written with while a newer sync may still be on its way
+    QHash<QString, MailboxSyncState> m_syncStates;
+    QHash<QString, QList<quint64>> m_settledPlaceholders;   // Moves the server confirmed
+    QHash<int, LatencyStats> m_confirmationLatency;
+    CommandScheduler::Metrics m_schedulerMetrics;
+    QSet<QString> m_dirtyMailboxes;     // Changed since the cache was written
+    QTimer* m_cacheTimer;
     
     QStringList m_availableMailboxes;
+    QHash<QString, MailboxInfo> m_mailboxInfo;
     QHash<QString, MailboxList> m_mailboxLists;
+    QHash<QString, QHash<quint32, quint32>> m_threads;  // First UID of its thread, by UID
+    QString m_activeMailbox;
+    QSet<QString> m_fetchingOlder;
     
+    bool m_authenticated;       // As last reported by the interactive connection
     bool m_autoRefreshEnabled;
+    int m_pendingRefreshes;
+    int m_pendingReplays;
+    QSet<QString> m_resyncMailboxes;    // Need a full resync after the replay
     QString m_lastError;
 };
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "latency_stats.h"
+#include <algorithm>
+
+namespace {
+
+const int kMaxRecentSamples = 1024;
+
+} // namespace
+
+LatencyStats::LatencyStats()
+    : m_next(0)
+    , m_count(0)
+    , m_failures(0)
+    , m_totalNs(0)
+    , m_maxNs(0)
+{
+}
+
+void LatencyStats::record(qint64 nsecs, bool ok) {
+    if (m_recentNs.size() < kMaxRecentSamples) {
+        m_recentNs.append(nsecs);
+    } else {
+        m_recentNs[m_next] = nsecs;
+        m_next = (m_next + 1) % kMaxRecentSamples;
+    }
+    ++m_count;
+    if (!ok) {
+        ++m_failures;
+    }
+    m_totalNs += nsecs;
+    m_maxNs = qMax(m_maxNs, nsecs);
+}
+
+void LatencyStats::clear() {
+    *this = LatencyStats();
+}
+
+int LatencyStats::count() const {
+    return m_count;
+}
+
+int LatencyStats::failures() const {
+    return m_failures;
+}
+
+double LatencyStats::averageMs() const {
+    return m_count == 0 ? 0 : m_totalNs / 1e6 / m_count;
+}
+
+double LatencyStats::maxMs() const {
+    return m_maxNs / 1e6;
+}
+
+double LatencyStats::percentileMs(double fraction) const {
+    if (m_recentNs.isEmpty()) {
+        return 0;
+    }
+    QList<qint64> sorted = m_recentNs;
+    std::sort(sorted.begin(), sorted.end());
+    int index = qBound(0, int(fraction * sorted.size()), int(sorted.size()) - 1);
+    return sorted.at(index) / 1e6;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QList>
+
+// Durations of a recurring operation, such as how long the server takes to
+// confirm a card move. Percentiles are taken over the most recent samples.
+class LatencyStats {
+public:
+    LatencyStats();
+
+    void record(qint64 nsecs, bool ok = true);
+    void clear();
+
+    int count() const;
+    int failures() const;
+    double averageMs() const;
+    double maxMs() const;
+    // Duration that the given share of recent samples stayed under, e.g. 0.95
+    double percentileMs(double fraction) const;
+
+private:
+    QList<qint64> m_recentNs;   // Ring buffer
+    int m_next;
+    int m_count;
+    int m_failures;
+    qint64 m_totalNs;
+    qint64 m_maxNs;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+// A mailbox as reported by LIST, with its STATUS counts when the server
+// returned them (RFC 5819 LIST-STATUS or a separate STATUS command).
+struct MailboxInfo {
+    QString name;
+    QChar delimiter;        // Hierarchy delimiter; null for a flat namespace
+    QStringList flags;      // \HasChildren, \Noselect, \Drafts, ...
+    bool hasStatus = false;
+    quint32 messages = 0;
+    quint32 unseen = 0;
+    quint32 uidNext = 0;
+    quint64 highestModSeq = 0;
+
+    bool hasFlag(const QString& flag) const {
+        return flags.contains(flag, Qt::CaseInsensitive);
+    }
+
+    bool isSelectable() const {
+        return !hasFlag("\\Noselect") && !hasFlag("\\NonExistent");
+    }
+
+    // "Projects/2024/TODO" -> "Projects/2024"; empty at the top level
+    QString parentName() const {
+        int index = delimiter.isNull() ? -1 : name.lastIndexOf(delimiter);
+        return index < 0 ? QString() : name.left(index);
+    }
+
+    QString leafName() const {
+        int index = delimiter.isNull() ? -1 : name.lastIndexOf(delimiter);
+        return index < 0 ? name : name.mid(index + 1);
+    }
+};
@@ -1,12 +1,181 @@
 #include "mailbox_list.h"
+#include "string_pool.h"
+#include <QHash>
 #include <algorithm>
+#include <vector>
 
-MailboxList::MailboxList() {
+namespace {
+
+// Beyond this many cards a batch is sorted in once rather than row by row
+const int kMaxRowInserts = 16;
+
+// Position of a card in one sort order. Built once when the card is added
+// and kept with it, so that finding its entry again costs no string work.
+struct OrderKey {
+    qint64 date;        // Date orders: milliseconds since the epoch
+    QString text;       // Subject and sender orders: collation key
+    quint64 key;        // EmailCard::key()
+};
+
+// The subject a reply or forward shares with its original (RFC 5256 2.1):
+// without "Re:", "Fwd:" and "[list]" prefixes or a "(fwd)" suffix, so the
+// order agrees with a server-side SORT SUBJECT
+QString baseSubject(const QString& subject) {
+    QString base = subject.simplified();
+    bool changed = true;
+    while (changed && !base.isEmpty()) {
+        changed = false;
+        if (base.endsWith("(fwd)", Qt::CaseInsensitive)) {
+            base.chop(5);
+            base = base.trimmed();
+            changed = true;
+        }
+        // "[list] ", "Re: ", "Fwd: ", "Re[2]: "
+        int end = 0;
+        if (base.startsWith('[')) {
+            end = base.indexOf(']') + 1;
+        } else {
+            for (const char* prefix : { "re", "fwd", "fw" }) {
+                if (!base.startsWith(QLatin1String(prefix), Qt::CaseInsensitive)) {
+                    continue;
+                }
+                int i = int(qstrlen(prefix));
+                if (i < base.size() && base.at(i) == '[') {
+                    i = base.indexOf(']', i) + 1;
+                }
+                if (i > 0 && i < base.size() && base.at(i) == ':') {
+                    end = i + 1;
+                }
+                break;
+            }
+        }
+        // A subject that is nothing but a tag keeps it
+        if (end > 0 && end < base.size()) {
+            base = base.mid(end).trimmed();
+            changed = true;
+        }
+    }
+    return base;
+}
+
+OrderKey orderKey(const EmailCard& card, MailboxList::SortOrder order) {
+    OrderKey key;
+    key.date = 0;
+    switch (order) {
+    case MailboxList::DateAscending:
+    case MailboxList::DateDescending:
+        key.date = card.dateMSecs();
+        break;
+    case MailboxList::SubjectAscending:
+    case MailboxList::SubjectDescending:
+        key.text = baseSubject(card.subject()).toCaseFolded();
+        break;
+    case MailboxList::FromAscending:
+    case MailboxList::FromDescending:
+        // Senders repeat across cards: pooling the folded form lets equal
+        // senders compare by pointer
+        key.text = StringPool::internString(card.from().toCaseFolded());
+        break;
+    }
+    key.key = card.key();
+    return key;
+}
+
+// Strict weak order for one SortOrder. Ties are broken by key, so every
+// card has exactly one position.
+struct OrderCompare {
+    MailboxList::SortOrder order;
+
+    bool operator()(const OrderKey& a, const OrderKey& b) const {
+        const bool descending = order == MailboxList::DateDescending
+            || order == MailboxList::SubjectDescending || order == MailboxList::FromDescending;
+        const OrderKey& x = descending ? b : a;
+        const OrderKey& y = descending ? a : b;
+
+        if (x.date != y.date) {
+            return x.date < y.date;
+        }
+        if (x.text.constData() != y.text.constData()) {
+            int text = x.text.compare(y.text);
+            if (text != 0) {
+                return text < 0;
+            }
+        }
+        return x.key < y.key;
+    }
+};
+
+} // namespace
+
+struct MailboxList::Index {
+    explicit Index(SortOrder sortOrder)
+        : compare{sortOrder}
+        , sorted(true)
+    {
+    }
+
+    struct Entry {
+        EmailCard card;
+        OrderKey key;   // Its entry in order
+    };
+
+    // Row of the key in order, or where it would go
+    int rowOf(const OrderKey& key) const {
+        return int(std::lower_bound(order.begin(), order.end(), key, compare) - order.begin());
+    }
+
+    void insert(const Entry& entry) {
+        cards.insert(entry.key.key, entry);
+        if (sorted) {
+            const int row = rowOf(entry.key);
+            order.insert(order.begin() + row, entry.key);
+            ordered.insert(row, entry.card);
+        }
+    }
+
+    void erase(QHash<quint64, Entry>::iterator it) {
+        if (sorted) {
+            const int row = rowOf(it->key);
+            order.erase(order.begin() + row);
+            ordered.remove(row);
+        }
+        cards.erase(it);
+    }
+
+    // Puts the rows back in order after a batch
+    void sort() {
+        order.clear();
+        order.reserve(size_t(cards.size()));
+        for (const Entry& entry : cards) {
+            order.push_back(entry.key);
+        }
+        std::sort(order.begin(), order.end(), compare);
+        ordered.clear();
+        ordered.reserve(qsizetype(order.size()));
+        for (const OrderKey& key : order) {
+            ordered.append(cards.value(key.key).card);
+        }
+        sorted = true;
+    }
+
+    OrderCompare compare;
+    QHash<quint64, Entry> cards;    // By EmailCard::key()
+    std::vector<OrderKey> order;    // Sorted by compare while sorted is set
+    QList<EmailCard> ordered;       // cards(), in step with order
+    bool sorted;                    // False while a batch awaits sort()
+};
+
+MailboxList::MailboxList()
+    : m_sortOrder(DateDescending)
+    , m_hasOlderCards(false)
+{
 }
 
 MailboxList::MailboxList(const QString& name) 
     : m_name(name)
     , m_displayName(name)
+    , m_sortOrder(DateDescending)
+    , m_hasOlderCards(false)
 {
 }
 
@@ -34,79 +203,142 @@ void MailboxList::addCard(const EmailCard& card) {
         return;
     }
     
-    int index = findCardIndex(card.uid());
-    if (index >= 0) {
-        m_cards[index] = card;
-    } else {
-        m_cards.append(card);
+    Index& index = this->index();
+    auto it = index.cards.find(card.key());
+    if (it != index.cards.end()) {
+        // The position depends on the card's contents: take it out first
+        index.erase(it);
     }
+    index.insert({ card, orderKey(card, m_sortOrder) });
 }
 
 void MailboxList::removeCard(const QString& uid) {
-    int index = findCardIndex(uid);
-    if (index >= 0) {
-        m_cards.removeAt(index);
+    if (!hasCard(uid)) {
+        return;
     }
+    Index& index = this->index();
+    index.erase(index.cards.find(uid.toULongLong()));
 }
 
 void MailboxList::updateCard(const EmailCard& card) {
     addCard(card); // addCard handles both add and update
 }
 
+void MailboxList::addCards(const QList<EmailCard>& cards) {
+    if (cards.size() > kMaxRowInserts) {
+        index().sorted = false;
+    }
+    for (const EmailCard& card : cards) {
+        addCard(card);
+    }
+}
+
+void MailboxList::removeCards(const QStringList& uids) {
+    if (uids.size() > kMaxRowInserts && m_index) {
+        index().sorted = false;
+    }
+    for (const QString& uid : uids) {
+        removeCard(uid);
+    }
+}
+
 EmailCard MailboxList::card(const QString& uid) const {
-    int index = findCardIndex(uid);
-    if (index >= 0) {
-        return m_cards[index];
+    return m_index ? m_index->cards.value(uid.toULongLong()).card : EmailCard();
+}
+
+int MailboxList::row(const QString& uid) const {
+    if (!m_index) {
+        return -1;
+    }
+    auto it = m_index->cards.constFind(uid.toULongLong());
+    if (it == m_index->cards.constEnd()) {
+        return -1;
     }
-    return EmailCard();
+    if (!m_index->sorted) {
+        m_index->sort();
+    }
+    return m_index->rowOf(it->key);
 }
 
 QList<EmailCard> MailboxList::cards() const {
-    return m_cards;
+    if (!m_index) {
+        return QList<EmailCard>();
+    }
+    // Sorted once per batch and shared by every caller until the next change
+    if (!m_index->sorted) {
+        m_index->sort();
+    }
+    return m_index->ordered;
 }
 
 void MailboxList::setCards(const QList<EmailCard>& cards) {
-    m_cards = cards;
+    m_index.reset();
+    addCards(cards);
 }
 
 int MailboxList::cardCount() const {
-    return m_cards.size();
+    return m_index ? m_index->cards.size() : 0;
 }
 
 bool MailboxList::hasCard(const QString& uid) const {
-    return findCardIndex(uid) >= 0;
+    return m_index && m_index->cards.contains(uid.toULongLong());
 }
 
 void MailboxList::clear() {
-    m_cards.clear();
+    m_index.reset();
+    m_hasOlderCards = false;
 }
 
-void MailboxList::sortCards(SortOrder order) {
-    std::sort(m_cards.begin(), m_cards.end(), [order](const EmailCard& a, const EmailCard& b) {
-        switch (order) {
-            case DateAscending:
-                return a.date() < b.date();
-            case DateDescending:
-                return a.date() > b.date();
-            case SubjectAscending:
-                return a.subject().toLower() < b.subject().toLower();
-            case SubjectDescending:
-                return a.subject().toLower() > b.subject().toLower();
-            case FromAscending:
-                return a.from().toLower() < b.from().toLower();
-            case FromDescending:
-                return a.from().toLower() > b.from().toLower();
-            default:
-                return a.date() > b.date();
-        }
-    });
+bool MailboxList::hasOlderCards() const {
+    return m_hasOlderCards;
 }
 
-int MailboxList::findCardIndex(const QString& uid) const {
-    for (int i = 0; i < m_cards.size(); ++i) {
-        if (m_cards[i].uid() == uid) {
-            return i;
+void MailboxList::setHasOlderCards(bool hasOlder) {
+    m_hasOlderCards = hasOlder;
+}
+
+quint32 MailboxList::oldestUid() const {
+    quint32 oldest = 0;
+    if (!m_index) {
+        return oldest;
+    }
+    for (auto it = m_index->cards.constBegin(); it != m_index->cards.constEnd(); ++it) {
+        quint32 uid = it->card.uidNumber();
+        if (uid != 0 && (oldest == 0 || uid < oldest)) {
+            oldest = uid;
         }
     }
-    return -1;
-}
\ No newline at end of file
+    return oldest;
+}
+
+void MailboxList::sortCards(SortOrder order) {
+    if (order == m_sortOrder) {
+        return;
+    }
+    m_sortOrder = order;
+    if (!m_index) {
+        return;
+    }
+
+    auto sorted = std::make_shared<Index>(order);
+    sorted->cards = m_index->cards;
+    for (Index::Entry& entry : sorted->cards) {
+        entry.key = orderKey(entry.card, order);
+    }
+    sorted->sort();
+    m_index = sorted;
+}
+
+MailboxList::SortOrder MailboxList::sortOrder() const {
+    return m_sortOrder;
+}
+
+MailboxList::Index& MailboxList::index() {
+    if (!m_index) {
+        m_index = std::make_shared<Index>(m_sortOrder);
+    } else if (m_index.use_count() > 1) {
+        // Another copy still uses this index
+        m_index = std::make_shared<Index>(*m_index);
+    }
+    return *m_index;
+}
@@ -3,9 +3,25 @@
 #include "email_card.h"
 #include <QString>
 #include <QList>
+#include <memory>
 
+// The cards of one mailbox, indexed by key and kept in the active sort
+// order as they change. Lookups are O(1) and finding a card's row is
+// O(log n); adding, updating and removing a card shifts the rows after it
+// but copies nothing else. Larger batches are sorted once when next read.
+// Copies share the card index until one of them changes.
 class MailboxList {
 public:
+    // Sorting
+    enum SortOrder {
+        DateAscending,
+        DateDescending,
+        SubjectAscending,
+        SubjectDescending,
+        FromAscending,
+        FromDescending
+    };
+
     MailboxList();
     MailboxList(const QString& name);
     
@@ -20,31 +36,37 @@ public:
     void addCard(const EmailCard& card);
     void removeCard(const QString& uid);
     void updateCard(const EmailCard& card);
+    void addCards(const QList<EmailCard>& cards);
+    void removeCards(const QStringList& uids);
     EmailCard card(const QString& uid) const;
-    QList<EmailCard> cards() const;
+    int row(const QString& uid) const;  // In cards(), -1 if not there
+    QList<EmailCard> cards() const;     // In sortOrder()
     void setCards(const QList<EmailCard>& cards);
     
     // Utility
     int cardCount() const;
     bool hasCard(const QString& uid) const;
     void clear();
+
+    // Paging: whether the server has cards older than the loaded ones, and
+    // the lowest loaded UID that the next page continues from
+    bool hasOlderCards() const;
+    void setHasOlderCards(bool hasOlder);
+    quint32 oldestUid() const;
     
-    // Sorting
-    enum SortOrder {
-        DateAscending,
-        DateDescending,
-        SubjectAscending,
-        SubjectDescending,
-        FromAscending,
-        FromDescending
-    };
-    
+    // Changes the active order (DateDescending by default). Sorting by the
+    // active order again is free.
     void sortCards(SortOrder order);
+    SortOrder sortOrder() const;
     
 private:
+    struct Index;
+
+    Index& index();
+
     QString m_name;
     QString m_displayName;
-    QList<EmailCard> m_cards;
-    
-    int findCardIndex(const QString& uid) const;
-};
\ No newline at end of file
+    SortOrder m_sortOrder;
+    std::shared_ptr<Index> m_index;     // Null while the list is empty
+    bool m_hasOlderCards;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+
+// What the client knew about a mailbox when it was last synchronized
+// (RFC 7162). A delta refresh is only possible while UIDVALIDITY is
+// unchanged and the server reports a HIGHESTMODSEQ.
+struct MailboxSyncState {
+    quint32 uidValidity = 0;
+    quint64 highestModSeq = 0;
+    quint32 uidNext = 0;
+
+    bool canResync() const {
+        return uidValidity != 0 && highestModSeq != 0 && uidNext != 0;
+    }
+};
+
+// Sync states by mailbox name; shared by all connections of a session
+using MailboxSyncStates = QHash<QString, MailboxSyncState>;
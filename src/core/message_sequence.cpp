@@ -0,0 +1,234 @@
+#include "message_sequence.h"
+#include <algorithm>
+
+namespace {
+
+// Fewer expunged slots than this are not worth a rebuild
+const size_t kMinCompactSlots = 64;
+
+} // namespace
+
+MessageSequence::MessageSequence()
+    : m_count(0)
+    , m_known(0)
+{
+}
+
+void MessageSequence::reset(quint32 exists) {
+    m_uids.assign(exists, 0);
+    m_live.assign(exists, true);
+    m_count = exists;
+    m_known = 0;
+    build();
+}
+
+quint32 MessageSequence::count() const {
+    return m_count;
+}
+
+bool MessageSequence::isComplete() const {
+    return m_known == int(m_uids.size());
+}
+
+quint32 MessageSequence::knownUid() const {
+    return m_known > 0 ? m_uids[m_known - 1] : 0;
+}
+
+bool MessageSequence::setExists(quint32 exists) {
+    if (exists < m_count) {
+        return false;
+    }
+    while (m_count < exists) {
+        appendSlot();
+    }
+    return true;
+}
+
+quint32 MessageSequence::expunge(quint32 msn) {
+    if (msn == 0 || msn > m_count) {
+        return 0;
+    }
+    const int slot = slotOf(msn);
+    const quint32 uid = m_uids[slot];
+    drop(slot);
+    return uid;
+}
+
+bool MessageSequence::remove(quint32 uid) {
+    const int slot = findSlot(uid);
+    if (slot < 0) {
+        return false;
+    }
+    drop(slot);
+    return true;
+}
+
+bool MessageSequence::setUid(quint32 msn, quint32 uid) {
+    if (msn == 0 || msn > m_count || uid == 0) {
+        return false;
+    }
+    const int slot = slotOf(msn);
+    if (m_uids[slot] != 0) {
+        return m_uids[slot] == uid;
+    }
+    // Unknown slots all come after the known ones, and so do their UIDs
+    if (uid <= knownUid()) {
+        return false;
+    }
+    m_uids[slot] = uid;
+    advanceKnown();
+    return true;
+}
+
+bool MessageSequence::setUnknownUids(QList<quint32> uids) {
+    // UID SEARCH n:* always matches the last message, even below n
+    std::sort(uids.begin(), uids.end());
+    uids.erase(std::unique(uids.begin(), uids.end()), uids.end());
+    const quint32 known = knownUid();
+    uids.erase(uids.begin(), std::upper_bound(uids.begin(), uids.end(), known));
+
+    // Checked in full first, so that a mismatch changes nothing
+    int next = 0;
+    for (int slot = m_known; slot < int(m_uids.size()); ++slot) {
+        if (!m_live[slot]) {
+            continue;
+        }
+        if (next == uids.size() || (m_uids[slot] != 0 && m_uids[slot] != uids.at(next))) {
+            return false;
+        }
+        ++next;
+    }
+    if (next != uids.size()) {
+        return false;
+    }
+
+    next = 0;
+    for (int slot = m_known; slot < int(m_uids.size()); ++slot) {
+        if (m_live[slot]) {
+            m_uids[slot] = uids.at(next++);
+        }
+    }
+    advanceKnown();
+    return true;
+}
+
+quint32 MessageSequence::uid(quint32 msn) const {
+    if (msn == 0 || msn > m_count) {
+        return 0;
+    }
+    return m_uids[slotOf(msn)];
+}
+
+quint32 MessageSequence::msn(quint32 uid) const {
+    const int slot = findSlot(uid);
+    return slot < 0 ? 0 : prefix(slot + 1);
+}
+
+int MessageSequence::slotOf(quint32 msn) const {
+    // The slot where the live count first reaches msn, by descending the tree
+    const int size = int(m_uids.size());
+    int step = 1;
+    while (step * 2 <= size) {
+        step *= 2;
+    }
+    int position = 0;
+    for (; step > 0; step /= 2) {
+        if (position + step <= size && m_tree[position + step] < msn) {
+            position += step;
+            msn -= m_tree[position];
+        }
+    }
+    return position;
+}
+
+int MessageSequence::findSlot(quint32 uid) const {
+    if (uid == 0) {
+        return -1;
+    }
+    // Expunged slots keep their place in the order; the live one comes first
+    auto begin = m_uids.begin();
+    auto it = std::lower_bound(begin, begin + m_known, uid);
+    if (it != begin + m_known && *it == uid) {
+        const int slot = int(it - begin);
+        return m_live[slot] ? slot : -1;
+    }
+    // The few UIDs learned ahead of the known ones
+    for (int slot = m_known; slot < int(m_uids.size()); ++slot) {
+        if (m_uids[slot] == uid && m_live[slot]) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+quint32 MessageSequence::prefix(int slots) const {
+    quint32 live = 0;
+    for (int i = slots; i > 0; i -= i & -i) {
+        live += m_tree[i];
+    }
+    return live;
+}
+
+void MessageSequence::drop(int slot) {
+    m_live[slot] = false;
+    for (int i = slot + 1; i < int(m_tree.size()); i += i & -i) {
+        --m_tree[i];
+    }
+    --m_count;
+    advanceKnown();
+
+    if (m_uids.size() - m_count > std::max<size_t>(m_count, kMinCompactSlots)) {
+        compact();
+    }
+}
+
+void MessageSequence::appendSlot() {
+    // The new node covers the slots from the one after i - lowbit(i) up to i
+    const int i = int(m_uids.size()) + 1;
+    m_tree.push_back(1 + prefix(i - 1) - prefix(i - (i & -i)));
+    m_uids.push_back(0);
+    m_live.push_back(true);
+    ++m_count;
+}
+
+void MessageSequence::advanceKnown() {
+    // An expunged slot whose UID was never learned takes its predecessor's,
+    // which keeps the known slots in order for the binary search
+    while (m_known < int(m_uids.size()) && (m_uids[m_known] != 0 || !m_live[m_known])) {
+        if (m_uids[m_known] == 0) {
+            m_uids[m_known] = knownUid();
+        }
+        ++m_known;
+    }
+}
+
+void MessageSequence::compact() {
+    std::vector<quint32> uids;
+    uids.reserve(m_count);
+    int known = 0;
+    for (int slot = 0; slot < int(m_uids.size()); ++slot) {
+        if (!m_live[slot]) {
+            continue;
+        }
+        if (slot < m_known) {
+            ++known;
+        }
+        uids.push_back(m_uids[slot]);
+    }
+    m_uids.swap(uids);
+    m_live.assign(m_uids.size(), true);
+    m_known = known;
+    build();
+}
+
+void MessageSequence::build() {
+    const int size = int(m_uids.size());
+    m_tree.assign(size + 1, 0);
+    for (int i = 1; i <= size; ++i) {
+        m_tree[i] += m_live[i - 1] ? 1 : 0;
+        const int parent = i + (i & -i);
+        if (parent <= size) {
+            m_tree[parent] += m_tree[i];
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QList>
+#include <vector>
+
+// Message sequence numbers of the selected mailbox and the UIDs behind them
+// (RFC 3501 2.3.1), kept up to date from EXISTS, EXPUNGE and FETCH. Messages
+// sit in slots in ascending UID order; an expunge only marks its slot in a
+// Fenwick tree, so it and both lookups cost O(log n). Expunged slots are
+// dropped once they outnumber the messages.
+class MessageSequence {
+public:
+    MessageSequence();
+
+    // A mailbox of this many messages whose UIDs are not known yet
+    void reset(quint32 exists = 0);
+
+    quint32 count() const;
+    // Whether the UID of every message is known
+    bool isComplete() const;
+    // Highest UID below the first message with an unknown UID; 0 if none
+    quint32 knownUid() const;
+
+    // EXISTS: messages beyond the current count were added. False if the
+    // count went down, which only EXPUNGE may do.
+    bool setExists(quint32 exists);
+    // EXPUNGE: the UID of the message, 0 if it was not known
+    quint32 expunge(quint32 msn);
+    // VANISHED: false if the UID was not in the mailbox
+    bool remove(quint32 uid);
+    // FETCH with a UID: false if it contradicts what is known
+    bool setUid(quint32 msn, quint32 uid);
+    // The UIDs of every message above knownUid(), e.g. from UID SEARCH.
+    // False if they don't match those messages.
+    bool setUnknownUids(QList<quint32> uids);
+
+    quint32 uid(quint32 msn) const;     // 0 if unknown
+    quint32 msn(quint32 uid) const;     // 0 if not in the mailbox
+
+private:
+    int slotOf(quint32 msn) const;
+    int findSlot(quint32 uid) const;    // -1 unless a live slot has it
+    quint32 prefix(int slots) const;    // Live messages in the first slots
+    void drop(int slot);
+    void appendSlot();
+    void advanceKnown();
+    void compact();
+    void build();
+
+    std::vector<quint32> m_uids;    // By slot, ascending; 0 while unknown
+    std::vector<bool> m_live;       // False once expunged
+    std::vector<quint32> m_tree;    // Fenwick tree over m_live, 1-based
+    quint32 m_count;
+    int m_known;                    // Slots before it all have a UID
+};
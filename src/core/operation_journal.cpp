@@ -0,0 +1,271 @@
+#include "operation_journal.h"
+#include "email_card.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QPair>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+const quint32 kJournalMagic = 0x494b4f4a;   // "IKOJ"
+const quint32 kJournalVersion = 2;          // 2: card keys instead of UIDs
+
+// Where a card is and what is still to be done to it, during replay()
+struct CardState {
+    QString mailbox;            // Where the server has it
+    quint64 uid = 0;
+    quint32 uidValidity = 0;
+    QString location;           // Where the board shows it
+    quint64 placeholderKey = 0;
+    int read = -1;              // -1 while unchanged
+    int flagged = -1;
+    bool deleted = false;
+    QList<quint64> entries;
+};
+
+JournalBatch& batchFor(QList<JournalBatch>& batches, JournalEntry::Operation operation,
+                       const CardState& card, const QString& target, bool value) {
+    for (JournalBatch& batch : batches) {
+        if (batch.operation == operation && batch.mailbox == card.mailbox
+            && batch.uidValidity == card.uidValidity && batch.target == target && batch.value == value) {
+            return batch;
+        }
+    }
+    JournalBatch batch;
+    batch.operation = operation;
+    batch.mailbox = card.mailbox;
+    batch.uidValidity = card.uidValidity;
+    batch.target = target;
+    batch.value = value;
+    batches.append(batch);
+    return batches.last();
+}
+
+} // namespace
+
+OperationJournal::OperationJournal(const QString& directory)
+    : m_directory(directory)
+    , m_nextId(1)
+    , m_nextPlaceholder(1)
+{
+    if (m_directory.isEmpty()) {
+        // Settings live in <config>/IMAPKanban (see Settings), the journal beside them
+        m_directory = QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation)
+            + "/IMAPKanban/journal";
+    }
+}
+
+QString OperationJournal::directory() const {
+    return m_directory;
+}
+
+void OperationJournal::setAccount(const QString& server, const QString& username) {
+    QByteArray account = (username + '@' + server).toUtf8();
+    QString hashed = QCryptographicHash::hash(account, QCryptographicHash::Sha1).toHex().left(16);
+    if (hashed == m_account) {
+        return;
+    }
+    m_account = hashed;
+    load();
+}
+
+bool OperationJournal::isEmpty() const {
+    return m_entries.isEmpty();
+}
+
+int OperationJournal::size() const {
+    return m_entries.size();
+}
+
+QList<JournalEntry> OperationJournal::entries() const {
+    return m_entries;
+}
+
+quint64 OperationJournal::placeholderKey() {
+    const quint32 number = m_nextPlaceholder;
+    m_nextPlaceholder = number == std::numeric_limits<quint32>::max() ? 1 : number + 1;
+    return EmailCard::placeholderKey(number);
+}
+
+bool OperationJournal::append(const JournalEntry& entry) {
+    JournalEntry added = entry;
+    added.id = m_nextId++;
+    m_entries.append(added);
+    if (!save()) {
+        m_entries.removeLast();
+        return false;
+    }
+    return true;
+}
+
+bool OperationJournal::remove(const QList<quint64>& ids) {
+    const QSet<quint64> removed(ids.begin(), ids.end());
+    const int count = m_entries.size();
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [&removed](const JournalEntry& entry) {
+        return removed.contains(entry.id);
+    }), m_entries.end());
+    return m_entries.size() == count || save();
+}
+
+JournalReplay OperationJournal::replay() const {
+    QList<CardState> cards;
+    QHash<QPair<QString, quint64>, int> cardAt;
+
+    for (const JournalEntry& entry : m_entries) {
+        const QPair<QString, quint64> at(entry.mailbox, entry.uid);
+        int index = cardAt.value(at, -1);
+        if (index < 0) {
+            CardState card;
+            card.mailbox = entry.mailbox;
+            card.uid = entry.uid;
+            card.uidValidity = entry.uidValidity;
+            card.location = entry.mailbox;
+            index = cards.size();
+            cards.append(card);
+            cardAt.insert(at, index);
+        }
+
+        CardState& card = cards[index];
+        card.entries.append(entry.id);
+        switch (entry.operation) {
+        case JournalEntry::MarkRead:
+            card.read = entry.value;
+            break;
+        case JournalEntry::MarkFlagged:
+            card.flagged = entry.value;
+            break;
+        case JournalEntry::Move:
+            cardAt.remove(at);
+            card.location = entry.target;
+            card.placeholderKey = entry.targetUid;
+            cardAt.insert(qMakePair(entry.target, entry.targetUid), index);
+            break;
+        case JournalEntry::Delete:
+            cardAt.remove(at);
+            card.deleted = true;
+            break;
+        }
+    }
+
+    JournalReplay replay;
+    for (const CardState& card : cards) {
+        JournalBatch* last = nullptr;
+        if (EmailCard::isPlaceholderKey(card.uid)) {
+            // Moved before the journal began, and never settled: there is
+            // no UID to send, so the mailbox is read again instead
+            replay.resyncMailboxes.insert(card.mailbox);
+        } else if (card.deleted) {
+            last = &batchFor(replay.batches, JournalEntry::Delete, card, QString(), false);
+            last->uids.append(quint32(card.uid));
+        } else {
+            // Flags travel with a message, so they are set before it moves
+            if (card.read >= 0) {
+                last = &batchFor(replay.batches, JournalEntry::MarkRead, card, QString(), card.read);
+                last->uids.append(quint32(card.uid));
+            }
+            if (card.flagged >= 0) {
+                last = &batchFor(replay.batches, JournalEntry::MarkFlagged, card, QString(), card.flagged);
+                last->uids.append(quint32(card.uid));
+            }
+            if (card.location != card.mailbox) {
+                last = &batchFor(replay.batches, JournalEntry::Move, card, card.location, false);
+                last->uids.append(quint32(card.uid));
+                last->targetUids.append(card.placeholderKey);
+            } else if (card.placeholderKey != 0) {
+                // Moved back where it came from: the server never needs to know
+                replay.resyncMailboxes.insert(card.mailbox);
+            }
+        }
+
+        if (last) {
+            last->entries += card.entries;
+        } else {
+            replay.cancelled += card.entries;
+        }
+    }
+
+    std::stable_sort(replay.batches.begin(), replay.batches.end(),
+                     [](const JournalBatch& a, const JournalBatch& b) {
+        return a.operation < b.operation;
+    });
+    return replay;
+}
+
+bool OperationJournal::load() {
+    m_entries.clear();
+    m_nextId = 1;
+    m_nextPlaceholder = 1;
+
+    QFile file(filePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != kJournalMagic || version != kJournalVersion) {
+        return false;
+    }
+
+    qint32 count = 0;
+    in >> m_nextId >> m_nextPlaceholder >> count;
+    QList<JournalEntry> entries;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        JournalEntry entry;
+        qint32 operation = 0;
+        in >> entry.id >> operation >> entry.mailbox >> entry.uid >> entry.uidValidity >> entry.target
+           >> entry.targetUid >> entry.value;
+        entry.operation = JournalEntry::Operation(operation);
+        entries.append(entry);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "JOURNAL: discarding unreadable journal" << file.fileName();
+        m_nextId = 1;
+        m_nextPlaceholder = 1;
+        return false;
+    }
+    m_entries = entries;
+    return true;
+}
+
+bool OperationJournal::save() const {
+    if (m_entries.isEmpty()) {
+        // The placeholder counter only matters while placeholders are shown
+        return !QFileInfo::exists(filePath()) || QFile::remove(filePath());
+    }
+
+    QDir().mkpath(QFileInfo(filePath()).absolutePath());
+    QSaveFile file(filePath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+
+    out << kJournalMagic << kJournalVersion;
+    out << m_nextId << m_nextPlaceholder << qint32(m_entries.size());
+    for (const JournalEntry& entry : m_entries) {
+        out << entry.id << qint32(entry.operation) << entry.mailbox << entry.uid << entry.uidValidity
+            << entry.target << entry.targetUid << entry.value;
+    }
+
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+QString OperationJournal::filePath() const {
+    return QString("%1/%2.journal").arg(m_directory, m_account);
+}
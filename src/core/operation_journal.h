@@ -0,0 +1,91 @@
+#pragma once
+
+#include <QString>
+#include <QList>
+#include <QSet>
+
+// A card operation made while the server could not be reached. The card is
+// named as the board showed it at the time: a card moved while offline is
+// shown in its new mailbox under a placeholder (see EmailCard::key()) until
+// the move is replayed, and later operations on it refer to that.
+struct JournalEntry {
+    // In the order a replay sends them for one mailbox
+    enum Operation {
+        MarkRead,
+        MarkFlagged,
+        Move,
+        Delete
+    };
+
+    quint64 id = 0;
+    Operation operation = Move;
+    QString mailbox;
+    quint64 uid = 0;            // EmailCard::key()
+    quint32 uidValidity = 0;    // Of the mailbox when the card was seen there
+    QString target;             // Move
+    quint64 targetUid = 0;      // Move: placeholder key in the target
+    bool value = false;         // MarkRead, MarkFlagged
+};
+
+// One command of a replay: the same operation on a set of cards of one
+// mailbox
+struct JournalBatch {
+    JournalEntry::Operation operation = JournalEntry::Move;
+    QString mailbox;
+    quint32 uidValidity = 0;
+    QString target;
+    bool value = false;
+    QList<quint32> uids;
+    QList<quint64> targetUids;  // Move: the placeholders, in step with uids
+    QList<quint64> entries;     // Settled once the batch is
+};
+
+// The journal reduced to what it changes on the server
+struct JournalReplay {
+    QList<JournalBatch> batches;
+    QList<quint64> cancelled;       // Entries without a net effect
+    QSet<QString> resyncMailboxes;  // Showing placeholders no batch accounts for
+};
+
+// Durable log of the card operations made while offline, kept per account
+// and replayed once the connection is back. The file is rewritten
+// atomically on every change, so an operation that was accepted survives a
+// crash.
+class OperationJournal {
+public:
+    // Defaults to a "journal" directory next to the application settings
+    explicit OperationJournal(const QString& directory = QString());
+
+    QString directory() const;
+
+    // Switches to the journal of the account, loading what it holds
+    void setAccount(const QString& server, const QString& username);
+
+    bool isEmpty() const;
+    int size() const;
+    QList<JournalEntry> entries() const;
+
+    // The key of a new placeholder, for a card moved while offline
+    quint64 placeholderKey();
+
+    // Both return false if the journal could not be written
+    bool append(const JournalEntry& entry);
+    bool remove(const QList<quint64>& ids);
+
+    // Follows each card through the journal and batches what is left of
+    // it: moves collapse into one from where the card was to where it ended
+    // up, flag changes into the last one, and everything before a delete
+    // into the delete. Batches are ordered by JournalEntry::Operation.
+    JournalReplay replay() const;
+
+private:
+    bool load();
+    bool save() const;
+    QString filePath() const;
+
+    QString m_directory;
+    QString m_account;
+    QList<JournalEntry> m_entries;
+    quint64 m_nextId;
+    quint32 m_nextPlaceholder;
+};
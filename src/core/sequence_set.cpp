@@ -0,0 +1,69 @@
+#include "sequence_set.h"
+#include <algorithm>
+
+namespace SequenceSet {
+
+QList<quint32> parse(const QByteArray& set, bool* ok) {
+    QList<quint32> numbers;
+    if (ok) {
+        *ok = true;
+    }
+
+    for (const QByteArray& part : set.split(',')) {
+        int colon = part.indexOf(':');
+        bool firstOk = false;
+        bool lastOk = false;
+        quint32 first = part.left(colon < 0 ? part.size() : colon).toUInt(&firstOk);
+        quint32 last = colon < 0 ? first : part.mid(colon + 1).toUInt(&lastOk);
+        if (colon < 0) {
+            lastOk = firstOk;
+        }
+        if (!firstOk || !lastOk || first == 0 || last == 0) {
+            continue;
+        }
+
+        if (first > last) {
+            qSwap(first, last);
+        }
+        if (quint64(numbers.size()) + (last - first) + 1 > quint64(kMaxNumbers)) {
+            if (ok) {
+                *ok = false;
+            }
+            return QList<quint32>();
+        }
+        for (quint64 n = first; n <= last; ++n) {
+            numbers.append(quint32(n));
+        }
+    }
+
+    return numbers;
+}
+
+QByteArray format(const QList<quint32>& numbers) {
+    QList<quint32> sorted = numbers;
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    sorted.removeAll(0);
+
+    QByteArray set;
+    int i = 0;
+    while (i < sorted.size()) {
+        int last = i;
+        while (last + 1 < sorted.size() && sorted.at(last + 1) == sorted.at(last) + 1) {
+            ++last;
+        }
+
+        if (!set.isEmpty()) {
+            set += ',';
+        }
+        set += QByteArray::number(sorted.at(i));
+        if (last > i) {
+            set += ':';
+            set += QByteArray::number(sorted.at(last));
+        }
+        i = last + 1;
+    }
+    return set;
+}
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+
+// Helpers for IMAP sequence sets such as "1:4,7,10:12"
+namespace SequenceSet {
+
+// Most numbers parse() expands a set into
+constexpr int kMaxNumbers = 1000000;
+
+// Expand a set into its numbers in the order given. Ranges may be written
+// either way round; "*" has no meaning without a mailbox and is skipped.
+// A set of more than kMaxNumbers numbers, such as 1:4294967295, gives an
+// empty list and sets *ok to false.
+QList<quint32> parse(const QByteArray& set, bool* ok = nullptr);
+
+// The shortest set naming the numbers, in ascending order with runs folded
+// into ranges, e.g. {1, 2, 3, 4, 7, 10, 11, 12} gives "1:4,7,10:12".
+// Duplicates and zeroes are dropped.
+QByteArray format(const QList<quint32>& numbers);
+
+}
@@ -1,9 +1,14 @@
 #include "settings.h"
 
 Settings::Settings() 
-    : m_settings("IMAPKanban", "IMAPKanban")
-    , m_imapPort(993)
+    : m_imapPort(993)
     , m_useSSL(true)
+    , m_pipelineDepth(8)
+    , m_maxConnections(4)
+    , m_fetchHeaderFields(false)
+    , m_expungeAll(false)
+    , m_cardWindow(200)
+    , m_cacheEnabled(true)
     , m_refreshInterval(30)
 {
     load();
@@ -49,6 +54,38 @@ void Settings::setPassword(const QString& password) {
     m_password = password;
 }
 
+int Settings::pipelineDepth() const {
+    return m_pipelineDepth;
+}
+
+void Settings::setPipelineDepth(int depth) {
+    m_pipelineDepth = qMax(1, depth);
+}
+
+int Settings::maxConnections() const {
+    return m_maxConnections;
+}
+
+void Settings::setMaxConnections(int count) {
+    m_maxConnections = qMax(1, count);
+}
+
+bool Settings::fetchHeaderFields() const {
+    return m_fetchHeaderFields;
+}
+
+void Settings::setFetchHeaderFields(bool enabled) {
+    m_fetchHeaderFields = enabled;
+}
+
+bool Settings::expungeAll() const {
+    return m_expungeAll;
+}
+
+void Settings::setExpungeAll(bool enabled) {
+    m_expungeAll = enabled;
+}
+
 QStringList Settings::visibleMailboxes() const {
     return m_visibleMailboxes;
 }
@@ -57,6 +94,22 @@ void Settings::setVisibleMailboxes(const QStringList& mailboxes) {
     m_visibleMailboxes = mailboxes;
 }
 
+int Settings::cardWindow() const {
+    return m_cardWindow;
+}
+
+void Settings::setCardWindow(int cards) {
+    m_cardWindow = qMax(0, cards);
+}
+
+bool Settings::cacheEnabled() const {
+    return m_cacheEnabled;
+}
+
+void Settings::setCacheEnabled(bool enabled) {
+    m_cacheEnabled = enabled;
+}
+
 int Settings::refreshInterval() const {
     return m_refreshInterval;
 }
@@ -66,24 +119,38 @@ void Settings::setRefreshInterval(int seconds) {
 }
 
 void Settings::save() {
-    m_settings.setValue("imap/server", m_imapServer);
-    m_settings.setValue("imap/port", m_imapPort);
-    m_settings.setValue("imap/ssl", m_useSSL);
-    m_settings.setValue("imap/username", m_username);
-    m_settings.setValue("imap/password", m_password);
-    m_settings.setValue("kanban/visibleMailboxes", m_visibleMailboxes);
-    m_settings.setValue("ui/refreshInterval", m_refreshInterval);
-    m_settings.sync();
+    QSettings appSettings("IMAPKanban", "IMAPKanban");
+    appSettings.setValue("imap/server", m_imapServer);
+    appSettings.setValue("imap/port", m_imapPort);
+    appSettings.setValue("imap/ssl", m_useSSL);
+    appSettings.setValue("imap/username", m_username);
+    appSettings.setValue("imap/password", m_password);
+    appSettings.setValue("imap/pipelineDepth", m_pipelineDepth);
+    appSettings.setValue("imap/maxConnections", m_maxConnections);
+    appSettings.setValue("imap/fetchHeaderFields", m_fetchHeaderFields);
+    appSettings.setValue("imap/expungeAll", m_expungeAll);
+    appSettings.setValue("kanban/visibleMailboxes", m_visibleMailboxes);
+    appSettings.setValue("kanban/cardWindow", m_cardWindow);
+    appSettings.setValue("kanban/cache", m_cacheEnabled);
+    appSettings.setValue("ui/refreshInterval", m_refreshInterval);
+    appSettings.sync();
 }
 
 void Settings::load() {
-    m_imapServer = m_settings.value("imap/server", "").toString();
-    m_imapPort = m_settings.value("imap/port", 993).toInt();
-    m_useSSL = m_settings.value("imap/ssl", true).toBool();
-    m_username = m_settings.value("imap/username", "").toString();
-    m_password = m_settings.value("imap/password", "").toString();
-    m_visibleMailboxes = m_settings.value("kanban/visibleMailboxes", QStringList()).toStringList();
-    m_refreshInterval = m_settings.value("ui/refreshInterval", 30).toInt();
+    QSettings appSettings("IMAPKanban", "IMAPKanban");
+    m_imapServer = appSettings.value("imap/server", "").toString();
+    m_imapPort = appSettings.value("imap/port", 993).toInt();
+    m_useSSL = appSettings.value("imap/ssl", true).toBool();
+    m_username = appSettings.value("imap/username", "").toString();
+    m_password = appSettings.value("imap/password", "").toString();
+    m_pipelineDepth = qMax(1, appSettings.value("imap/pipelineDepth", 8).toInt());
+    m_maxConnections = qMax(1, appSettings.value("imap/maxConnections", 4).toInt());
+    m_fetchHeaderFields = appSettings.value("imap/fetchHeaderFields", false).toBool();
+    m_expungeAll = appSettings.value("imap/expungeAll", false).toBool();
+    m_visibleMailboxes = appSettings.value("kanban/visibleMailboxes", QStringList()).toStringList();
+    m_cardWindow = qMax(0, appSettings.value("kanban/cardWindow", 200).toInt());
+    m_cacheEnabled = appSettings.value("kanban/cache", true).toBool();
+    m_refreshInterval = appSettings.value("ui/refreshInterval", 30).toInt();
 }
 
 void Settings::loadFromFile(const QString& path) {
@@ -93,7 +160,13 @@ void Settings::loadFromFile(const QString& path) {
     m_useSSL = fileSettings.value("imap/ssl", true).toBool();
     m_username = fileSettings.value("imap/username", "").toString();
     m_password = fileSettings.value("imap/password", "").toString();
+    m_pipelineDepth = qMax(1, fileSettings.value("imap/pipelineDepth", 8).toInt());
+    m_maxConnections = qMax(1, fileSettings.value("imap/maxConnections", 4).toInt());
+    m_fetchHeaderFields = fileSettings.value("imap/fetchHeaderFields", false).toBool();
+    m_expungeAll = fileSettings.value("imap/expungeAll", false).toBool();
     m_visibleMailboxes = fileSettings.value("kanban/visibleMailboxes", QStringList()).toStringList();
+    m_cardWindow = qMax(0, fileSettings.value("kanban/cardWindow", 200).toInt());
+    m_cacheEnabled = fileSettings.value("kanban/cache", true).toBool();
     m_refreshInterval = fileSettings.value("ui/refreshInterval", 30).toInt();
 }
 
@@ -104,7 +177,13 @@ void Settings::saveToFile(const QString& path) const {
     fileSettings.setValue("imap/ssl", m_useSSL);
     fileSettings.setValue("imap/username", m_username);
     fileSettings.setValue("imap/password", m_password);
+    fileSettings.setValue("imap/pipelineDepth", m_pipelineDepth);
+    fileSettings.setValue("imap/maxConnections", m_maxConnections);
+    fileSettings.setValue("imap/fetchHeaderFields", m_fetchHeaderFields);
+    fileSettings.setValue("imap/expungeAll", m_expungeAll);
     fileSettings.setValue("kanban/visibleMailboxes", m_visibleMailboxes);
+    fileSettings.setValue("kanban/cardWindow", m_cardWindow);
+    fileSettings.setValue("kanban/cache", m_cacheEnabled);
     fileSettings.setValue("ui/refreshInterval", m_refreshInterval);
     fileSettings.sync();
 }
\ No newline at end of file
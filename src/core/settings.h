@@ -4,6 +4,7 @@
 #include <QStringList>
 #include <QSettings>
 
+// Plain values, so copies can be handed to the IMAP worker thread
 class Settings {
 public:
     Settings();
@@ -28,9 +29,37 @@ public:
     QString password() const;
     void setPassword(const QString& password);
     
+    // Maximum number of commands sent before their tagged replies arrive
+    int pipelineDepth() const;
+    void setPipelineDepth(int depth);
+
+    // Upper bound on concurrent IMAP sessions, including the interactive one
+    int maxConnections() const;
+    void setMaxConnections(int count);
+
+    // Fetch card headers with BODY.PEEK[HEADER.FIELDS (...)] instead of
+    // ENVELOPE, for servers whose ENVELOPE data is unreliable
+    bool fetchHeaderFields() const;
+    void setFetchHeaderFields(bool enabled);
+
+    // Deleting a card on a server without UIDPLUS: off leaves the message
+    // flagged \Deleted (hidden from the board); on sends a plain EXPUNGE,
+    // which removes every message flagged \Deleted in the mailbox
+    bool expungeAll() const;
+    void setExpungeAll(bool enabled);
+    
     // Kanban settings
     QStringList visibleMailboxes() const;
     void setVisibleMailboxes(const QStringList& mailboxes);
+
+    // Newest cards loaded per column; older ones are fetched on demand in
+    // pages of the same size. 0 loads every card.
+    int cardWindow() const;
+    void setCardWindow(int cards);
+
+    // Keep card metadata on disk between sessions (see CardCache)
+    bool cacheEnabled() const;
+    void setCacheEnabled(bool enabled);
     
     // UI settings
     int refreshInterval() const;
@@ -41,13 +70,17 @@ public:
     void load();
     
 private:
-    QSettings m_settings;
-    
     QString m_imapServer;
     int m_imapPort;
     bool m_useSSL;
     QString m_username;
     QString m_password;
+    int m_pipelineDepth;
+    int m_maxConnections;
+    bool m_fetchHeaderFields;
+    bool m_expungeAll;
     QStringList m_visibleMailboxes;
+    int m_cardWindow;
+    bool m_cacheEnabled;
     int m_refreshInterval;
 };
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "string_pool.h"
+#include <QHash>
+#include <QReadWriteLock>
+#include <unordered_set>
+
+namespace {
+
+struct StringHash {
+    size_t operator()(const QString& string) const {
+        return qHash(string);
+    }
+};
+
+// Nodes of std::unordered_set keep their address when the table grows,
+// which InternedString relies on
+struct Pool {
+    QReadWriteLock lock;
+    std::unordered_set<QString, StringHash> strings;
+    const QString empty;
+};
+
+Pool& pool() {
+    static Pool instance;
+    return instance;
+}
+
+const QString* lookup(const QString& string) {
+    Pool& p = pool();
+    if (string.isEmpty()) {
+        return &p.empty;
+    }
+
+    {
+        QReadLocker locker(&p.lock);
+        auto it = p.strings.find(string);
+        if (it != p.strings.end()) {
+            return &*it;
+        }
+    }
+
+    QWriteLocker locker(&p.lock);
+    return &*p.strings.insert(string).first;
+}
+
+} // namespace
+
+InternedString::InternedString()
+    : m_string(&pool().empty)
+{
+}
+
+InternedString::InternedString(const QString& string)
+    : m_string(lookup(string))
+{
+}
+
+InternedString::InternedString(const QString* string)
+    : m_string(string)
+{
+}
+
+const QString& InternedString::toString() const {
+    return *m_string;
+}
+
+bool InternedString::isEmpty() const {
+    return m_string->isEmpty();
+}
+
+bool InternedString::operator==(const InternedString& other) const {
+    return m_string == other.m_string;
+}
+
+bool InternedString::operator!=(const InternedString& other) const {
+    return m_string != other.m_string;
+}
+
+size_t qHash(const InternedString& string, size_t seed) {
+    return qHash(quintptr(string.m_string), seed);
+}
+
+InternedString StringPool::intern(const QString& string) {
+    return InternedString(lookup(string));
+}
+
+QString StringPool::internString(const QString& string) {
+    return *lookup(string);
+}
+
+QStringList StringPool::internStrings(const QStringList& strings) {
+    QStringList interned;
+    interned.reserve(strings.size());
+    for (const QString& string : strings) {
+        interned.append(*lookup(string));
+    }
+    return interned;
+}
+
+int StringPool::size() {
+    Pool& p = pool();
+    QReadLocker locker(&p.lock);
+    return int(p.strings.size());
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+// A string stored once per process. Copies are a pointer, and two interned
+// strings are equal exactly when they point at the same pool entry, so
+// comparisons in sorts and filters do not touch the characters.
+class InternedString {
+public:
+    InternedString();   // The empty string
+    explicit InternedString(const QString& string);
+
+    const QString& toString() const;
+    bool isEmpty() const;
+
+    bool operator==(const InternedString& other) const;
+    bool operator!=(const InternedString& other) const;
+
+private:
+    friend class StringPool;
+    friend size_t qHash(const InternedString& string, size_t seed);
+
+    explicit InternedString(const QString* string);
+
+    const QString* m_string;    // Never null
+};
+
+size_t qHash(const InternedString& string, size_t seed = 0);
+
+// The process-wide table behind InternedString, for the values cards share:
+// senders, recipients, flags and keywords. It is safe to use from any
+// thread. Entries live until the process exits, so it is not meant for
+// unique values such as subjects.
+class StringPool {
+public:
+    static InternedString intern(const QString& string);
+
+    // The pooled copy of a string, sharing its allocation with every other
+    // value interned the same way
+    static QString internString(const QString& string);
+    static QStringList internStrings(const QStringList& strings);
+
+    static int size();
+};
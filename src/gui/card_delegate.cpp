@@ -0,0 +1,122 @@
+#include "card_delegate.h"
+#include "card_list_model.h"
+#include <QPainter>
+#include <QPainterPath>
+
+namespace {
+
+const int kCardHeight = 80;
+const int kCardMargin = 3;      // Between neighbouring cards
+const int kCardPadding = 8;     // Inside a card
+
+} // namespace
+
+CardDelegate::CardDelegate(QObject* parent)
+    : QStyledItemDelegate(parent)
+{
+}
+
+void CardDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    const bool read = index.data(CardListModel::ReadRole).toBool();
+    const bool flagged = index.data(CardListModel::FlaggedRole).toBool();
+    const bool selected = option.state & QStyle::State_Selected;
+    const bool hovered = option.state & QStyle::State_MouseOver;
+
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+
+    // Card background; unread cards are tinted
+    const QRectF card = QRectF(option.rect).adjusted(kCardMargin, kCardMargin, -kCardMargin, -kCardMargin);
+    QColor background = read ? QColor(Qt::white) : QColor(0xf0, 0xf8, 0xff);
+    if (hovered) {
+        background = read ? QColor(0xf5, 0xf5, 0xf5) : QColor(0xe6, 0xf3, 0xff);
+    }
+    QPainterPath path;
+    path.addRoundedRect(card, 4, 4);
+    painter->fillPath(path, background);
+    painter->setPen(selected ? QPen(QColor(0, 120, 215), 2) : QPen(hovered ? QColor(0xbb, 0xbb, 0xbb)
+                                                                           : QColor(0xdd, 0xdd, 0xdd)));
+    painter->drawPath(path);
+
+    const QRect content = card.toRect().adjusted(kCardPadding, kCardPadding - 2, -kCardPadding, -kCardPadding + 2);
+
+    // Subject
+    QString subject = index.data(CardListModel::SubjectRole).toString();
+    if (subject.isEmpty()) {
+        subject = "(No Subject)";
+    }
+    QFont subjectFont = option.font;
+    subjectFont.setBold(true);
+    subjectFont.setPixelSize(12);
+    QFontMetrics subjectMetrics(subjectFont);
+    painter->setFont(subjectFont);
+    painter->setPen(QColor(0x20, 0x20, 0x20));
+    QRect line(content.left(), content.top(), content.width(), subjectMetrics.height());
+    painter->drawText(line, Qt::AlignLeft | Qt::AlignVCenter,
+                      subjectMetrics.elidedText(subject, Qt::ElideRight, line.width()));
+
+    // Sender
+    QString from = index.data(CardListModel::FromRole).toString();
+    if (from.isEmpty()) {
+        from = "(Unknown Sender)";
+    }
+    QFont fromFont = option.font;
+    fromFont.setPixelSize(10);
+    QFontMetrics fromMetrics(fromFont);
+    painter->setFont(fromFont);
+    painter->setPen(QColor(0x66, 0x66, 0x66));
+    line = QRect(content.left(), line.bottom() + 4, content.width(), fromMetrics.height());
+    painter->drawText(line, Qt::AlignLeft | Qt::AlignVCenter,
+                      fromMetrics.elidedText(from, Qt::ElideRight, line.width()));
+
+    // Date and status along the bottom edge
+    QFont smallFont = option.font;
+    smallFont.setPixelSize(9);
+    painter->setFont(smallFont);
+    line = QRect(content.left(), content.bottom() - QFontMetrics(smallFont).height(),
+                 content.width(), QFontMetrics(smallFont).height());
+    painter->setPen(QColor(0x88, 0x88, 0x88));
+    painter->drawText(line, Qt::AlignLeft | Qt::AlignVCenter,
+                      formatDate(index.data(CardListModel::DateRole).toDateTime()));
+
+    QStringList statusItems;
+    if (!read) {
+        statusItems << "●"; // Unread indicator
+    }
+    if (flagged) {
+        statusItems << "🚩"; // Flag indicator
+    }
+    painter->setPen(QColor(0, 120, 215));
+    painter->drawText(line, Qt::AlignRight | Qt::AlignVCenter, statusItems.join(" "));
+
+    painter->restore();
+}
+
+QSize CardDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    Q_UNUSED(index)
+    return QSize(option.rect.width(), kCardHeight);
+}
+
+QString CardDelegate::formatDate(const QDateTime& date) {
+    if (!date.isValid()) {
+        return "";
+    }
+    
+    QDateTime now = QDateTime::currentDateTime();
+    qint64 secondsAgo = date.secsTo(now);
+    
+    if (secondsAgo < 60) {
+        return "now";
+    } else if (secondsAgo < 3600) {
+        int minutes = secondsAgo / 60;
+        return QString("%1m ago").arg(minutes);
+    } else if (secondsAgo < 86400) {
+        int hours = secondsAgo / 3600;
+        return QString("%1h ago").arg(hours);
+    } else if (secondsAgo < 604800) {
+        int days = secondsAgo / 86400;
+        return QString("%1d ago").arg(days);
+    } else {
+        return date.toString("MMM dd");
+    }
+}
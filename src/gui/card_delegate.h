@@ -0,0 +1,18 @@
+#pragma once
+
+#include <QStyledItemDelegate>
+#include <QDateTime>
+
+// Paints a card of a CardListModel: subject, sender, date and status. Rows
+// have a fixed height, so views only lay out and paint the visible cards.
+class CardDelegate : public QStyledItemDelegate {
+    Q_OBJECT
+
+public:
+    explicit CardDelegate(QObject* parent = nullptr);
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+    static QString formatDate(const QDateTime& date);
+};
@@ -31,6 +31,10 @@ void CardDialog::setCard(const EmailCard& card) {
     m_flaggedCheckBox->setChecked(card.isFlagged());
 }
 
+void CardDialog::setConversationSize(int messages) {
+    m_conversationLabel->setText(messages > 1 ? QString("%1 messages").arg(messages) : QString("This message only"));
+}
+
 void CardDialog::setupUI() {
     setModal(true);
     resize(600, 500);
@@ -55,6 +59,9 @@ void CardDialog::setupUI() {
     
     m_uidLabel = new QLabel;
     basicLayout->addRow("UID:", m_uidLabel);
+
+    m_conversationLabel = new QLabel;
+    basicLayout->addRow("Conversation:", m_conversationLabel);
     
     mainLayout->addWidget(basicGroup);
     
@@ -15,6 +15,8 @@ public:
     
     EmailCard card() const;
     void setCard(const EmailCard& card);
+    // Messages in the card's conversation, shown when more than one
+    void setConversationSize(int messages);
 
 private slots:
     void onAccepted();
@@ -31,6 +33,7 @@ private:
     QTextEdit* m_bodyEdit;
     QLabel* m_dateLabel;
     QLabel* m_uidLabel;
+    QLabel* m_conversationLabel;
     QCheckBox* m_readCheckBox;
     QCheckBox* m_flaggedCheckBox;
 };
\ No newline at end of file
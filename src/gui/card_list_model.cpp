@@ -0,0 +1,121 @@
+#include "card_list_model.h"
+
+CardListModel::CardListModel(KanbanModel* model, const QString& mailbox, QObject* parent)
+    : QAbstractListModel(parent)
+    , m_model(model)
+    , m_mailbox(mailbox)
+    , m_cards(model->mailboxList(mailbox).cards())
+{
+    connect(m_model, &KanbanModel::cardsRemoved, this, &CardListModel::onCardsRemoved);
+    connect(m_model, &KanbanModel::cardsMoved, this, &CardListModel::onCardsMoved);
+    connect(m_model, &KanbanModel::cardsInserted, this, &CardListModel::onCardsInserted);
+    connect(m_model, &KanbanModel::cardsChanged, this, &CardListModel::onCardsChanged);
+    connect(m_model, &KanbanModel::mailboxReset, this, &CardListModel::onMailboxReset);
+}
+
+QString CardListModel::mailbox() const {
+    return m_mailbox;
+}
+
+EmailCard CardListModel::card(int row) const {
+    return m_cards.value(row);
+}
+
+int CardListModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : int(m_cards.size());
+}
+
+QVariant CardListModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= m_cards.size()) {
+        return QVariant();
+    }
+
+    const EmailCard& card = m_cards.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+    case SubjectRole:
+        return card.subject();
+    case Qt::ToolTipRole:
+        return card.summary();
+    case CardRole:
+        return QVariant::fromValue(card);
+    case UidRole:
+        return card.uid();
+    case FromRole:
+        return card.from();
+    case DateRole:
+        return card.date();
+    case ReadRole:
+        return card.isRead();
+    case FlaggedRole:
+        return card.isFlagged();
+    default:
+        return QVariant();
+    }
+}
+
+void CardListModel::onCardsRemoved(const QString& mailbox, int first, int last) {
+    if (mailbox != m_mailbox || first < 0 || last >= m_cards.size()) {
+        return;
+    }
+    beginRemoveRows(QModelIndex(), first, last);
+    m_cards.remove(first, last - first + 1);
+    endRemoveRows();
+}
+
+void CardListModel::onCardsMoved(const QString& mailbox, int first, int last, int destination) {
+    if (mailbox != m_mailbox || first < 0 || last >= m_cards.size()) {
+        return;
+    }
+    if (!beginMoveRows(QModelIndex(), first, last, QModelIndex(), destination)) {
+        return;
+    }
+    const QList<EmailCard> moved = m_cards.mid(first, last - first + 1);
+    m_cards.remove(first, moved.size());
+    int to = destination > first ? destination - int(moved.size()) : destination;
+    for (int i = 0; i < moved.size(); ++i) {
+        m_cards.insert(to + i, moved.at(i));
+    }
+    endMoveRows();
+}
+
+void CardListModel::onCardsInserted(const QString& mailbox, int first, int last) {
+    if (mailbox != m_mailbox) {
+        return;
+    }
+    // Inserted rows are numbered in the final list, which the model holds
+    const QList<EmailCard> cards = m_model->mailboxList(m_mailbox).cards();
+    if (first < 0 || first > m_cards.size() || last >= cards.size()) {
+        onMailboxReset(mailbox);
+        return;
+    }
+    beginInsertRows(QModelIndex(), first, last);
+    for (int row = first; row <= last; ++row) {
+        m_cards.insert(row, cards.at(row));
+    }
+    endInsertRows();
+}
+
+void CardListModel::onCardsChanged(const QString& mailbox, int first, int last) {
+    if (mailbox != m_mailbox) {
+        return;
+    }
+    const QList<EmailCard> cards = m_model->mailboxList(m_mailbox).cards();
+    if (first < 0 || last >= m_cards.size() || last >= cards.size()) {
+        onMailboxReset(mailbox);
+        return;
+    }
+    for (int row = first; row <= last; ++row) {
+        m_cards[row] = cards.at(row);
+    }
+    emit dataChanged(index(first), index(last));
+}
+
+void CardListModel::onMailboxReset(const QString& mailbox) {
+    if (mailbox != m_mailbox) {
+        return;
+    }
+    beginResetModel();
+    m_cards = m_model->mailboxList(m_mailbox).cards();
+    endResetModel();
+}
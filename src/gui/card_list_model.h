@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../core/kanban_model.h"
+#include <QAbstractListModel>
+#include <QList>
+
+// One column of the board as an item model: the cards of one mailbox in
+// KanbanModel's order, kept current from its row-level change signals.
+class CardListModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    enum Roles {
+        CardRole = Qt::UserRole + 1,    // EmailCard
+        UidRole,
+        SubjectRole,
+        FromRole,
+        DateRole,
+        ReadRole,
+        FlaggedRole
+    };
+
+    CardListModel(KanbanModel* model, const QString& mailbox, QObject* parent = nullptr);
+
+    QString mailbox() const;
+    EmailCard card(int row) const;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+private slots:
+    void onCardsRemoved(const QString& mailbox, int first, int last);
+    void onCardsMoved(const QString& mailbox, int first, int last, int destination);
+    void onCardsInserted(const QString& mailbox, int first, int last);
+    void onCardsChanged(const QString& mailbox, int first, int last);
+    void onMailboxReset(const QString& mailbox);
+
+private:
+    KanbanModel* m_model;
+    QString m_mailbox;
+    QList<EmailCard> m_cards;
+};
+
+Q_DECLARE_METATYPE(EmailCard)
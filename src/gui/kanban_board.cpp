@@ -1,13 +1,22 @@
 #include "kanban_board.h"
+#include "card_delegate.h"
 #include <QScrollBar>
 #include <QApplication>
+#include <algorithm>
+
+namespace {
+
+// Older cards are requested this close (in pixels) to the end of a column
+const int kLoadOlderMarginPx = 200;
+
+} // namespace
 
 // MailboxColumn implementation
 
-MailboxColumn::MailboxColumn(const QString& mailboxName, QWidget* parent)
+MailboxColumn::MailboxColumn(KanbanModel* model, const QString& mailboxName, QWidget* parent)
     : QFrame(parent)
     , m_mailboxName(mailboxName)
-    , m_selectedCard(nullptr)
+    , m_cardModel(new CardListModel(model, mailboxName, this))
 {
     setupUI();
 }
@@ -21,77 +30,57 @@ void MailboxColumn::setMailboxName(const QString& name) {
     m_titleLabel->setText(name);
 }
 
-void MailboxColumn::addCard(CardWidget* card) {
-    if (!card || m_cards.contains(card)) {
-        return;
-    }
-    
-    m_cards.append(card);
-    m_cardsLayout->addWidget(card);
-    
-    connect(card, &CardWidget::selected, this, &MailboxColumn::onCardSelected);
-    connect(card, &CardWidget::doubleClicked, this, &MailboxColumn::onCardDoubleClicked);
-    
-    updateCardCount();
+int MailboxColumn::cardCount() const {
+    return m_cardModel->rowCount();
 }
 
-void MailboxColumn::removeCard(CardWidget* card) {
-    if (!card || !m_cards.contains(card)) {
-        return;
-    }
-    
-    m_cards.removeAll(card);
-    m_cardsLayout->removeWidget(card);
-    card->setParent(nullptr);
-    
-    if (m_selectedCard == card) {
-        m_selectedCard = nullptr;
-    }
-    
-    updateCardCount();
+EmailCard MailboxColumn::selectedCard() const {
+    const QModelIndex current = m_listView->currentIndex();
+    return current.isValid() ? m_cardModel->card(current.row()) : EmailCard();
 }
 
-void MailboxColumn::clearCards() {
-    for (CardWidget* card : m_cards) {
-        m_cardsLayout->removeWidget(card);
-        card->deleteLater();
+QStringList MailboxColumn::selectedUids() const {
+    QModelIndexList rows = m_listView->selectionModel()->selectedRows();
+    std::sort(rows.begin(), rows.end());
+
+    QStringList uids;
+    for (const QModelIndex& row : rows) {
+        uids.append(m_cardModel->card(row.row()).uid());
     }
-    m_cards.clear();
-    m_selectedCard = nullptr;
-    updateCardCount();
+    return uids;
 }
 
-QList<CardWidget*> MailboxColumn::cards() const {
-    return m_cards;
+void MailboxColumn::clearSelection() {
+    m_listView->selectionModel()->clear();
 }
 
-CardWidget* MailboxColumn::selectedCard() const {
-    return m_selectedCard;
+void MailboxColumn::updateCardCount() {
+    m_countLabel->setText(QString("(%1)").arg(cardCount()));
 }
 
-void MailboxColumn::updateCardCount() {
-    m_countLabel->setText(QString("(%1)").arg(m_cards.size()));
+void MailboxColumn::setCounts(int messages, int unread) {
+    if (unread > 0) {
+        m_countLabel->setText(QString("(%1, %2 unread)").arg(messages).arg(unread));
+    } else {
+        m_countLabel->setText(QString("(%1)").arg(messages));
+    }
 }
 
-void MailboxColumn::onCardSelected() {
-    CardWidget* card = qobject_cast<CardWidget*>(sender());
-    if (!card) {
-        return;
+void MailboxColumn::onCurrentChanged(const QModelIndex& current) {
+    if (current.isValid()) {
+        emit cardSelected(m_cardModel->card(current.row()));
     }
-    
-    // Deselect previous card
-    if (m_selectedCard && m_selectedCard != card) {
-        m_selectedCard->setSelected(false);
+}
+
+void MailboxColumn::onDoubleClicked(const QModelIndex& index) {
+    if (index.isValid()) {
+        emit cardDoubleClicked(m_cardModel->card(index.row()));
     }
-    
-    m_selectedCard = card;
-    emit cardSelected(card);
 }
 
-void MailboxColumn::onCardDoubleClicked() {
-    CardWidget* card = qobject_cast<CardWidget*>(sender());
-    if (card) {
-        emit cardDoubleClicked(card);
+void MailboxColumn::onScrolled(int value) {
+    if (value >= m_listView->verticalScrollBar()->maximum() - kLoadOlderMarginPx) {
+        emit olderCardsRequested(m_mailboxName);
     }
 }
 
@@ -121,20 +110,25 @@ void MailboxColumn::setupUI() {
     
     layout->addWidget(headerWidget);
     
-    // Cards area
-    m_scrollArea = new QScrollArea;
-    m_scrollArea->setWidgetResizable(true);
-    m_scrollArea->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    m_scrollArea->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-    
-    m_cardsWidget = new QWidget;
-    m_cardsLayout = new QVBoxLayout(m_cardsWidget);
-    m_cardsLayout->setSpacing(5);
-    m_cardsLayout->setContentsMargins(0, 0, 0, 0);
-    m_cardsLayout->addStretch();
-    
-    m_scrollArea->setWidget(m_cardsWidget);
-    layout->addWidget(m_scrollArea);
+    // Cards. Rows share one height, so the view lays out and paints only
+    // the cards in sight however long the column is.
+    m_listView = new QListView;
+    m_listView->setModel(m_cardModel);
+    m_listView->setItemDelegate(new CardDelegate(m_listView));
+    m_listView->setUniformItemSizes(true);
+    // Ctrl and Shift pick several cards for one bulk action
+    m_listView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    m_listView->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    m_listView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    m_listView->setMouseTracking(true);
+    m_listView->setFrameShape(QFrame::NoFrame);
+    m_listView->setCursor(Qt::PointingHandCursor);
+    layout->addWidget(m_listView);
+
+    connect(m_listView->selectionModel(), &QItemSelectionModel::currentChanged,
+            this, &MailboxColumn::onCurrentChanged);
+    connect(m_listView, &QListView::doubleClicked, this, &MailboxColumn::onDoubleClicked);
+    connect(m_listView->verticalScrollBar(), &QScrollBar::valueChanged, this, &MailboxColumn::onScrolled);
 }
 
 // KanbanBoard implementation
@@ -142,7 +136,6 @@ void MailboxColumn::setupUI() {
 KanbanBoard::KanbanBoard(KanbanModel* model, QWidget* parent)
     : QWidget(parent)
     , m_model(model)
-    , m_selectedCard(nullptr)
 {
     setupUI();
     
@@ -159,29 +152,43 @@ KanbanBoard::KanbanBoard(KanbanModel* model, QWidget* parent)
 }
 
 EmailCard KanbanBoard::selectedCard() const {
-    if (m_selectedCard) {
-        return m_selectedCard->card();
+    // Looked up again, so the card is current and invalid once it is gone
+    if (m_selectedUid.isEmpty()) {
+        return EmailCard();
     }
-    return EmailCard();
+    return m_model->card(m_selectedUid, m_selectedMailbox);
 }
 
 QString KanbanBoard::selectedMailbox() const {
     return m_selectedMailbox;
 }
 
+QStringList KanbanBoard::selectedUids() const {
+    for (MailboxColumn* column : m_columns) {
+        if (column->mailboxName() == m_selectedMailbox) {
+            return column->selectedUids();
+        }
+    }
+    return QStringList();
+}
+
 void KanbanBoard::onConnected() {
     updateColumns();
 }
 
 void KanbanBoard::onDisconnected() {
+    // Cards kept for working offline stay on the board
+    if (m_model->hasCards()) {
+        return;
+    }
+
     // Clear all columns
     for (MailboxColumn* column : m_columns) {
-        column->clearCards();
         m_columnsLayout->removeWidget(column);
         column->deleteLater();
     }
     m_columns.clear();
-    m_selectedCard = nullptr;
+    m_selectedUid.clear();
     m_selectedMailbox.clear();
 }
 
@@ -190,48 +197,35 @@ void KanbanBoard::onMailboxesChanged() {
 }
 
 void KanbanBoard::onMailboxUpdated(const QString& mailbox) {
-    updateColumn(mailbox);
+    // The column's list model has already applied the row changes
+    MailboxColumn* column = findColumn(mailbox);
+    if (column) {
+        updateColumnCounts(column);
+    }
 }
 
-void KanbanBoard::onCardSelected(CardWidget* card) {
-    // Deselect cards in other columns
-    for (MailboxColumn* column : m_columns) {
-        if (column->selectedCard() != card) {
-            for (CardWidget* otherCard : column->cards()) {
-                if (otherCard != card) {
-                    otherCard->setSelected(false);
-                }
-            }
-        }
+void KanbanBoard::onCardSelected(const EmailCard& card) {
+    MailboxColumn* selectedColumn = qobject_cast<MailboxColumn*>(sender());
+    if (!selectedColumn) {
+        return;
     }
-    
-    m_selectedCard = card;
-    
-    // Find which mailbox this card belongs to
+
+    // Deselect cards in other columns
     for (MailboxColumn* column : m_columns) {
-        if (column->cards().contains(card)) {
-            m_selectedMailbox = column->mailboxName();
-            break;
+        if (column != selectedColumn) {
+            column->clearSelection();
         }
     }
     
-    if (card) {
-        emit cardSelected(card->card(), m_selectedMailbox);
-    }
+    m_selectedUid = card.uid();
+    m_selectedMailbox = selectedColumn->mailboxName();
+    emit cardSelected(card, m_selectedMailbox);
 }
 
-void KanbanBoard::onCardDoubleClicked(CardWidget* card) {
-    if (card) {
-        // Find which mailbox this card belongs to
-        QString mailbox;
-        for (MailboxColumn* column : m_columns) {
-            if (column->cards().contains(card)) {
-                mailbox = column->mailboxName();
-                break;
-            }
-        }
-        
-        emit cardDoubleClicked(card->card(), mailbox);
+void KanbanBoard::onCardDoubleClicked(const EmailCard& card) {
+    MailboxColumn* column = qobject_cast<MailboxColumn*>(sender());
+    if (column) {
+        emit cardDoubleClicked(card, column->mailboxName());
     }
 }
 
@@ -255,7 +249,8 @@ void KanbanBoard::setupUI() {
 }
 
 void KanbanBoard::updateColumns() {
-    if (!m_model->isConnected()) {
+    // Cached cards are shown while the connection is still being set up
+    if (!m_model->isConnected() && !m_model->hasCards()) {
         return;
     }
     
@@ -265,44 +260,45 @@ void KanbanBoard::updateColumns() {
     for (int i = m_columns.size() - 1; i >= 0; --i) {
         MailboxColumn* column = m_columns[i];
         if (!visibleMailboxes.contains(column->mailboxName())) {
+            if (column->mailboxName() == m_selectedMailbox) {
+                m_selectedUid.clear();
+                m_selectedMailbox.clear();
+            }
             m_columns.removeAt(i);
             m_columnsLayout->removeWidget(column);
             column->deleteLater();
         }
     }
     
-    // Add new columns
+    // Add new columns; each loads its cards from the model
     for (const QString& mailbox : visibleMailboxes) {
         if (!findColumn(mailbox)) {
-            MailboxColumn* column = new MailboxColumn(mailbox);
+            MailboxColumn* column = new MailboxColumn(m_model, mailbox);
             connect(column, &MailboxColumn::cardSelected, this, &KanbanBoard::onCardSelected);
             connect(column, &MailboxColumn::cardDoubleClicked, this, &KanbanBoard::onCardDoubleClicked);
+            connect(column, &MailboxColumn::olderCardsRequested, this, &KanbanBoard::onOlderCardsRequested);
             
             m_columns.append(column);
             m_columnsLayout->insertWidget(m_columnsLayout->count() - 1, column);
-            
-            // Load cards for this mailbox
-            updateColumn(mailbox);
+            updateColumnCounts(column);
         }
     }
 }
 
-void KanbanBoard::updateColumn(const QString& mailbox) {
-    MailboxColumn* column = findColumn(mailbox);
-    if (!column) {
-        return;
+void KanbanBoard::updateColumnCounts(MailboxColumn* column) {
+    column->updateCardCount();
+
+    // Until the first refresh completes, or while only the newest cards are
+    // loaded, show the mailbox totals LIST-STATUS reported
+    const MailboxInfo info = m_model->mailboxInfo(column->mailboxName());
+    if ((column->cardCount() == 0 || m_model->hasOlderCards(column->mailboxName())) && info.hasStatus) {
+        column->setCounts(int(info.messages), int(info.unseen));
     }
-    
-    // Clear existing cards
-    column->clearCards();
-    
-    // Add new cards
-    MailboxList list = m_model->mailboxList(mailbox);
-    const QList<EmailCard> cards = list.cards();
-    
-    for (const EmailCard& card : cards) {
-        CardWidget* cardWidget = new CardWidget(card);
-        column->addCard(cardWidget);
+}
+
+void KanbanBoard::onOlderCardsRequested(const QString& mailbox) {
+    if (m_model->hasOlderCards(mailbox)) {
+        m_model->fetchOlderCards(mailbox);
     }
 }
 
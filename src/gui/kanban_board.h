@@ -1,40 +1,45 @@
 #pragma once
 
 #include "../core/kanban_model.h"
-#include "card_widget.h"
+#include "card_list_model.h"
 #include <QWidget>
 #include <QScrollArea>
 #include <QHBoxLayout>
 #include <QVBoxLayout>
 #include <QLabel>
 #include <QFrame>
+#include <QListView>
 #include <QList>
 
 class MailboxColumn : public QFrame {
     Q_OBJECT
 
 public:
-    explicit MailboxColumn(const QString& mailboxName, QWidget* parent = nullptr);
+    MailboxColumn(KanbanModel* model, const QString& mailboxName, QWidget* parent = nullptr);
     
     QString mailboxName() const;
     void setMailboxName(const QString& name);
     
-    void addCard(CardWidget* card);
-    void removeCard(CardWidget* card);
-    void clearCards();
-    
-    QList<CardWidget*> cards() const;
-    CardWidget* selectedCard() const;
+    int cardCount() const;
+    EmailCard selectedCard() const;
+    // Every selected card, in row order
+    QStringList selectedUids() const;
+    void clearSelection();
     
     void updateCardCount();
+    // Shows server-side counts while the cards themselves are not loaded
+    void setCounts(int messages, int unread);
 
 signals:
-    void cardSelected(CardWidget* card);
-    void cardDoubleClicked(CardWidget* card);
+    void cardSelected(const EmailCard& card);
+    void cardDoubleClicked(const EmailCard& card);
+    // Scrolled close to the bottom: the next page of older cards is wanted
+    void olderCardsRequested(const QString& mailbox);
 
 private slots:
-    void onCardSelected();
-    void onCardDoubleClicked();
+    void onCurrentChanged(const QModelIndex& current);
+    void onDoubleClicked(const QModelIndex& index);
+    void onScrolled(int value);
 
 private:
     void setupUI();
@@ -42,11 +47,8 @@ private:
     QString m_mailboxName;
     QLabel* m_titleLabel;
     QLabel* m_countLabel;
-    QVBoxLayout* m_cardsLayout;
-    QWidget* m_cardsWidget;
-    QScrollArea* m_scrollArea;
-    QList<CardWidget*> m_cards;
-    CardWidget* m_selectedCard;
+    QListView* m_listView;
+    CardListModel* m_cardModel;
 };
 
 class KanbanBoard : public QWidget {
@@ -57,6 +59,8 @@ public:
     
     EmailCard selectedCard() const;
     QString selectedMailbox() const;
+    // Cards are selected within one column at a time, in selectedMailbox()
+    QStringList selectedUids() const;
 
 signals:
     void cardSelected(const EmailCard& card, const QString& mailbox);
@@ -67,13 +71,14 @@ private slots:
     void onDisconnected();
     void onMailboxesChanged();
     void onMailboxUpdated(const QString& mailbox);
-    void onCardSelected(CardWidget* card);
-    void onCardDoubleClicked(CardWidget* card);
+    void onCardSelected(const EmailCard& card);
+    void onCardDoubleClicked(const EmailCard& card);
+    void onOlderCardsRequested(const QString& mailbox);
 
 private:
     void setupUI();
     void updateColumns();
-    void updateColumn(const QString& mailbox);
+    void updateColumnCounts(MailboxColumn* column);
     MailboxColumn* findColumn(const QString& mailbox);
     
     KanbanModel* m_model;
@@ -83,6 +88,6 @@ private:
     QHBoxLayout* m_columnsLayout;
     
     QList<MailboxColumn*> m_columns;
-    CardWidget* m_selectedCard;
+    QString m_selectedUid;
     QString m_selectedMailbox;
-};
\ No newline at end of file
+};
@@ -33,6 +33,11 @@ MainWindow::MainWindow(QWidget* parent)
     connect(m_model, &KanbanModel::disconnected, this, &MainWindow::onDisconnected);
     connect(m_model, &KanbanModel::error, this, &MainWindow::onError);
     connect(m_model, &KanbanModel::mailboxUpdated, this, &MainWindow::onMailboxUpdated);
+    connect(m_model, &KanbanModel::operationConflict, this, &MainWindow::onOperationConflict);
+    connect(m_kanbanBoard, &KanbanBoard::cardSelected, this, &MainWindow::onCardSelected);
+    
+    // Keep the board current: push updates for the active column, polling otherwise
+    m_model->setAutoRefresh(true);
     
     updateConnectionStatus();
     updateWindowTitle();
@@ -169,10 +174,14 @@ void MainWindow::updateConnectionStatus() {
         m_connectionStatusLabel->setText("Connected");
         m_connectionStatusLabel->setStyleSheet("color: green;");
     } else {
-        m_connectionStatusLabel->setText("Disconnected");
+        const int pending = m_model->pendingOperations();
+        m_connectionStatusLabel->setText(pending > 0 ? QString("Offline (%1 pending)").arg(pending) : "Disconnected");
         m_connectionStatusLabel->setStyleSheet("color: red;");
-        
-        // Disable card-specific actions
+    }
+
+    // Cards left on the board can still be worked on; the operations are
+    // journaled until the connection is back
+    if (!m_model->hasCards()) {
         m_editCardAction->setEnabled(false);
         m_deleteCardAction->setEnabled(false);
         m_moveCardAction->setEnabled(false);
@@ -200,6 +209,19 @@ void MainWindow::onConnected() {
     statusBar()->showMessage("Connected to IMAP server", 3000);
 }
 
+void MainWindow::onCardSelected(const EmailCard& card, const QString& mailbox) {
+    m_model->setActiveMailbox(mailbox);
+
+    const bool valid = card.isValid();
+    m_editCardAction->setEnabled(valid);
+    m_deleteCardAction->setEnabled(valid);
+    m_moveCardAction->setEnabled(valid);
+    m_markReadAction->setEnabled(valid);
+    m_markUnreadAction->setEnabled(valid);
+    m_flagAction->setEnabled(valid);
+    m_unflagAction->setEnabled(valid);
+}
+
 void MainWindow::onDisconnected() {
     updateConnectionStatus();
     updateWindowTitle();
@@ -211,9 +233,17 @@ void MainWindow::onError(const QString& message) {
     statusBar()->showMessage("Error: " + message, 5000);
 }
 
+void MainWindow::onOperationConflict(const QString& uid, const QString& mailbox, const QString& reason) {
+    statusBar()->showMessage(QString("Offline change to card %1 in '%2' was not applied: %3")
+                             .arg(uid, mailbox, reason), 10000);
+}
+
 void MainWindow::onMailboxUpdated(const QString& mailbox) {
     Q_UNUSED(mailbox)
     
+    // Offline changes add to the pending count
+    updateConnectionStatus();
+    
     // Update status bar counts
     QStringList visibleMailboxes = m_model->visibleMailboxes();
     int totalCards = 0;
@@ -266,6 +296,7 @@ void MainWindow::editCard() {
     CardDialog dialog(this);
     dialog.setWindowTitle("Edit Card");
     dialog.setCard(card);
+    dialog.setConversationSize(m_model->conversation(card.uid(), m_kanbanBoard->selectedMailbox()).size());
     
     if (dialog.exec() == QDialog::Accepted) {
         // In a real implementation, we would update the email
@@ -275,20 +306,21 @@ void MainWindow::editCard() {
 }
 
 void MainWindow::deleteCard() {
-    EmailCard card = m_kanbanBoard->selectedCard();
-    QString mailbox = m_kanbanBoard->selectedMailbox();
-    
-    if (!card.isValid() || mailbox.isEmpty()) {
+    const QHash<QString, QStringList> cards = selectedCards();
+    if (cards.isEmpty()) {
         QMessageBox::information(this, "Delete Card", "Please select a card to delete.");
         return;
     }
     
-    int ret = QMessageBox::question(this, "Delete Card", 
-        QString("Are you sure you want to delete the card '%1'?").arg(card.subject()),
+    const QStringList uids = cards.constBegin().value();
+    QString question = uids.size() == 1
+        ? QString("Are you sure you want to delete the card '%1'?").arg(m_kanbanBoard->selectedCard().subject())
+        : QString("Are you sure you want to delete these %1 cards?").arg(uids.size());
+    int ret = QMessageBox::question(this, "Delete Card", question,
         QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
     
     if (ret == QMessageBox::Yes) {
-        if (!m_model->deleteCard(card.uid(), mailbox)) {
+        if (!m_model->deleteCards(cards)) {
             QMessageBox::warning(this, "Delete Card", 
                 QString("Failed to delete card: %1").arg(m_model->lastError()));
         }
@@ -296,14 +328,13 @@ void MainWindow::deleteCard() {
 }
 
 void MainWindow::moveCard() {
-    EmailCard card = m_kanbanBoard->selectedCard();
-    QString fromMailbox = m_kanbanBoard->selectedMailbox();
-    
-    if (!card.isValid() || fromMailbox.isEmpty()) {
+    const QHash<QString, QStringList> cards = selectedCards();
+    if (cards.isEmpty()) {
         QMessageBox::information(this, "Move Card", "Please select a card to move.");
         return;
     }
     
+    const QString fromMailbox = cards.constBegin().key();
     QStringList mailboxes = m_model->visibleMailboxes();
     mailboxes.removeAll(fromMailbox);
     
@@ -312,13 +343,15 @@ void MainWindow::moveCard() {
         return;
     }
     
+    const QStringList uids = cards.constBegin().value();
+    QString label = uids.size() == 1
+        ? QString("Move '%1' to:").arg(m_kanbanBoard->selectedCard().subject())
+        : QString("Move %1 cards to:").arg(uids.size());
     bool ok;
-    QString toMailbox = QInputDialog::getItem(this, "Move Card", 
-        QString("Move '%1' to:").arg(card.subject()), 
-        mailboxes, 0, false, &ok);
+    QString toMailbox = QInputDialog::getItem(this, "Move Card", label, mailboxes, 0, false, &ok);
     
     if (ok && !toMailbox.isEmpty()) {
-        if (!m_model->moveCard(card.uid(), fromMailbox, toMailbox)) {
+        if (!m_model->moveCards(cards, toMailbox)) {
             QMessageBox::warning(this, "Move Card", 
                 QString("Failed to move card: %1").arg(m_model->lastError()));
         }
@@ -326,47 +359,31 @@ void MainWindow::moveCard() {
 }
 
 void MainWindow::markAsRead() {
-    EmailCard card = m_kanbanBoard->selectedCard();
-    QString mailbox = m_kanbanBoard->selectedMailbox();
-    
-    if (!card.isValid() || mailbox.isEmpty()) {
-        return;
+    const QHash<QString, QStringList> cards = selectedCards();
+    if (!cards.isEmpty()) {
+        m_model->markCardsAsRead(cards, true);
     }
-    
-    m_model->markCardAsRead(card.uid(), mailbox, true);
 }
 
 void MainWindow::markAsUnread() {
-    EmailCard card = m_kanbanBoard->selectedCard();
-    QString mailbox = m_kanbanBoard->selectedMailbox();
-    
-    if (!card.isValid() || mailbox.isEmpty()) {
-        return;
+    const QHash<QString, QStringList> cards = selectedCards();
+    if (!cards.isEmpty()) {
+        m_model->markCardsAsRead(cards, false);
     }
-    
-    m_model->markCardAsRead(card.uid(), mailbox, false);
 }
 
 void MainWindow::flagCard() {
-    EmailCard card = m_kanbanBoard->selectedCard();
-    QString mailbox = m_kanbanBoard->selectedMailbox();
-    
-    if (!card.isValid() || mailbox.isEmpty()) {
-        return;
+    const QHash<QString, QStringList> cards = selectedCards();
+    if (!cards.isEmpty()) {
+        m_model->markCardsAsFlagged(cards, true);
     }
-    
-    m_model->markCardAsFlagged(card.uid(), mailbox, true);
 }
 
 void MainWindow::unflagCard() {
-    EmailCard card = m_kanbanBoard->selectedCard();
-    QString mailbox = m_kanbanBoard->selectedMailbox();
-    
-    if (!card.isValid() || mailbox.isEmpty()) {
-        return;
+    const QHash<QString, QStringList> cards = selectedCards();
+    if (!cards.isEmpty()) {
+        m_model->markCardsAsFlagged(cards, false);
     }
-    
-    m_model->markCardAsFlagged(card.uid(), mailbox, false);
 }
 
 void MainWindow::refresh() {
@@ -417,4 +434,17 @@ void MainWindow::about() {
 
 void MainWindow::quit() {
     close();
-}
\ No newline at end of file
+}
+
+QHash<QString, QStringList> MainWindow::selectedCards() const {
+    QHash<QString, QStringList> cards;
+    const QString mailbox = m_kanbanBoard->selectedMailbox();
+    QStringList uids = m_kanbanBoard->selectedUids();
+    if (uids.isEmpty() && m_kanbanBoard->selectedCard().isValid()) {
+        uids.append(m_kanbanBoard->selectedCard().uid());
+    }
+    if (!mailbox.isEmpty() && !uids.isEmpty()) {
+        cards.insert(mailbox, uids);
+    }
+    return cards;
+}
@@ -25,6 +25,8 @@ private slots:
     void onDisconnected();
     void onError(const QString& message);
     void onMailboxUpdated(const QString& mailbox);
+    void onCardSelected(const EmailCard& card, const QString& mailbox);
+    void onOperationConflict(const QString& uid, const QString& mailbox, const QString& reason);
     
     // Menu actions
     void newCard();
@@ -49,6 +51,8 @@ private:
     void setupKeyboardShortcuts();
     void updateConnectionStatus();
     void updateWindowTitle();
+    // The selected cards keyed by their mailbox, for the bulk model calls
+    QHash<QString, QStringList> selectedCards() const;
     
     KanbanModel* m_model;
     KanbanBoard* m_kanbanBoard;
@@ -236,10 +236,12 @@ void SettingsDialog::onRefreshMailboxes() {
             "Please connect to the IMAP server first.");
         return;
     }
-    // Force model to reload mailboxes from server
+    // Force model to reload mailboxes from server; the list arrives asynchronously
+    connect(m_model, &KanbanModel::mailboxesChanged, this, [this]() {
+        updateMailboxList();
+        QMessageBox::information(this, "Refresh Mailboxes", "Mailbox list refreshed.");
+    }, Qt::SingleShotConnection);
     m_model->reloadMailboxes();
-    updateMailboxList();
-    QMessageBox::information(this, "Refresh Mailboxes", "Mailbox list refreshed.");
 }
 
 void SettingsDialog::onAccepted() {
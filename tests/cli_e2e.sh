@@ -91,6 +91,80 @@ if [ -n "$CARD_UID" ]; then
   echo "Move command completed"
 fi
 
+# Cards that are not loaded go to the server by UID: one outside the card
+# window, one in a column that is not shown
+WINDOW_INI="$HERE/tests/imap_test_window.ini"
+sed -e 's/^visibleMailboxes=.*/visibleMailboxes=TODO,DOING,DONE/' \
+    -e 's/^\[kanban\]$/[kanban]\ncardWindow=1/' "$CONF_INI" > "$WINDOW_INI"
+
+echo "Moving a card outside the card window..."
+"$CLI_BIN" --config "$CONF_INI" show-cards -m DONE | tee /tmp/imap_done.txt
+OLD_UID=$(grep -oP "^UID: \K[0-9]+" /tmp/imap_done.txt | sort -n | head -n1 || true)
+if [ -n "$OLD_UID" ] && [ "$(grep -c "^UID: " /tmp/imap_done.txt)" -gt 1 ]; then
+  "$CLI_BIN" --config "$WINDOW_INI" move-card -u "$OLD_UID" -f DONE -t DOING
+  "$CLI_BIN" --config "$CONF_INI" show-cards -m DONE | tee /tmp/imap_done.txt
+  if grep -q "^UID: $OLD_UID\$" /tmp/imap_done.txt; then
+    echo "Card $OLD_UID outside the window was not moved" >&2
+    exit 3
+  fi
+fi
+
+echo "Moving a card out of a hidden column..."
+"$CLI_BIN" --config "$CONF_INI" show-cards -m BACKLOG | tee /tmp/imap_backlog.txt
+HIDDEN_UID=$(grep -oP "^UID: \K[0-9]+" /tmp/imap_backlog.txt | head -n1 || true)
+if [ -n "$HIDDEN_UID" ]; then
+  "$CLI_BIN" --config "$WINDOW_INI" move-card -u "$HIDDEN_UID" -f BACKLOG -t TODO
+  "$CLI_BIN" --config "$CONF_INI" show-cards -m BACKLOG | tee /tmp/imap_backlog.txt
+  if grep -q "^UID: $HIDDEN_UID\$" /tmp/imap_backlog.txt; then
+    echo "Card $HIDDEN_UID in a hidden column was not moved" >&2
+    exit 3
+  fi
+fi
+
+echo "Moving a range of cards with move-cards..."
+"$CLI_BIN" --config "$CONF_INI" show-cards -m DOING | tee /tmp/imap_doing.txt
+FIRST_UID=$(grep -oP "^UID: \K[0-9]+" /tmp/imap_doing.txt | sort -n | head -n1 || true)
+LAST_UID=$(grep -oP "^UID: \K[0-9]+" /tmp/imap_doing.txt | sort -n | tail -n1 || true)
+if [ -n "$FIRST_UID" ]; then
+  # The range reaches past the last card; the server skips UIDs it does not have
+  "$CLI_BIN" --config "$CONF_INI" move-cards -u "$FIRST_UID-$((LAST_UID + 5))" -f DOING -t TODO \
+    | tee /tmp/imap_move_cards.txt
+  if ! grep -q "moved from 'DOING' to 'TODO'" /tmp/imap_move_cards.txt; then
+    echo "move-cards did not report the move" >&2
+    exit 3
+  fi
+  "$CLI_BIN" --config "$CONF_INI" show-cards -m DOING | tee /tmp/imap_doing.txt
+  if grep -q "^UID: " /tmp/imap_doing.txt; then
+    echo "Cards left in DOING after move-cards" >&2
+    exit 3
+  fi
+fi
+
+# Paging: with one card per window and no cache, --limit, --offset and
+# --since have to fetch older pages, and must show what a full load shows
+PAGING_INI="$HERE/tests/imap_test_paging.ini"
+sed -e 's/^\[kanban\]$/[kanban]\ncache=false/' "$WINDOW_INI" > "$PAGING_INI"
+
+check_paging() {
+  "$CLI_BIN" --config "$CONF_INI" show-cards -m TODO "$@" | grep "^UID: " > /tmp/imap_full.txt || true
+  "$CLI_BIN" --config "$PAGING_INI" show-cards -m TODO "$@" | grep "^UID: " > /tmp/imap_paged.txt || true
+  if ! diff -u /tmp/imap_full.txt /tmp/imap_paged.txt; then
+    echo "show-cards $* differs when paged" >&2
+    exit 3
+  fi
+}
+
+echo "Paging through TODO with --limit, --offset and --since..."
+check_paging --limit 2
+check_paging --limit 2 --offset 1
+check_paging --offset 3
+check_paging --since 2024-08-13
+check_paging --since 2024-08-13 --limit 1 --offset 1
+if [ "$(wc -l < /tmp/imap_full.txt)" -gt 1 ]; then
+  echo "Expected at most one card with --limit 1" >&2
+  exit 3
+fi
+
 # Tear down docker
 echo "Tearing down docker containers..."
 pushd "$DOCKER_DIR" >/dev/null
@@ -0,0 +1,181 @@
+// CommandScheduler ordering, coalescing and cancellation, with one
+// background connection to a local server so that jobs have to wait.
+
+#include "core/command_scheduler.h"
+#include "core/imap_connection_pool.h"
+#include "core/settings.h"
+#include "fake_imap_server.h"
+#include <QtTest>
+
+class CommandSchedulerTest : public QObject {
+    Q_OBJECT
+
+private:
+    CommandScheduler* scheduler() const {
+        return m_pool->scheduler();
+    }
+
+    // Records when it starts and holds its connection until finish()
+    CommandScheduler::Job job(const QString& name) {
+        return [this, name](ImapClient* client, const std::function<void()>& done) {
+            m_started.append(name);
+            m_clients.insert(name, client);
+            if (client) {
+                m_done.insert(name, done);
+            }
+        };
+    }
+
+    std::function<void()> merged() {
+        return [this]() {
+            ++m_merged;
+        };
+    }
+
+    void finish(const QString& name) {
+        m_done.take(name)();
+    }
+
+    // Takes the only background connection
+    bool startBlocker() {
+        scheduler()->submit(CommandScheduler::BackgroundPrefetch, "A", QString(), job("blocker"));
+        return QTest::qWaitFor([this]() { return m_done.contains("blocker"); });
+    }
+
+    FakeImapServer m_server;
+    ImapConnectionPool* m_pool = nullptr;
+    QStringList m_started;
+    QHash<QString, ImapClient*> m_clients;
+    QHash<QString, std::function<void()>> m_done;
+    int m_merged = 0;
+
+private slots:
+    void initTestCase() {
+        QVERIFY(m_server.listen());
+        m_server.addMailbox("A", 3);
+    }
+
+    void init() {
+        m_started.clear();
+        m_clients.clear();
+        m_done.clear();
+        m_merged = 0;
+
+        Settings settings;
+        settings.setImapServer("127.0.0.1");
+        settings.setImapPort(m_server.port());
+        settings.setUseSSL(false);
+        settings.setUsername("user");
+        settings.setPassword("pass");
+        settings.setMaxConnections(2);     // One background connection
+
+        m_pool = new ImapConnectionPool(this);
+        ImapClient* interactive = m_pool->interactive();
+        connect(interactive, &ImapClient::connected, interactive, [interactive]() {
+            interactive->authenticate("user", "pass");
+        });
+        m_pool->open(settings);
+        QTRY_VERIFY(interactive->isAuthenticated());
+    }
+
+    void cleanup() {
+        m_done.clear();
+        delete m_pool;
+        m_pool = nullptr;
+    }
+
+    void interactiveDoesNotWait() {
+        QVERIFY(startBlocker());
+        scheduler()->submit(CommandScheduler::VisibleRefresh, "A", QString(), job("refresh"));
+        scheduler()->submit(CommandScheduler::Interactive, "A", QString(), job("move"));
+        QCOMPARE(m_started, QStringList({"blocker", "move"}));
+        QCOMPARE(m_clients.value("move"), m_pool->interactive());
+        QCOMPARE(scheduler()->queueDepth(), 1);
+    }
+
+    void higherPriorityFirst() {
+        QVERIFY(startBlocker());
+        scheduler()->submit(CommandScheduler::BackgroundPrefetch, "A", QString(), job("page"));
+        scheduler()->submit(CommandScheduler::VisibleRefresh, "A", QString(), job("refresh"));
+        QCOMPARE(scheduler()->queueDepth(), 2);
+
+        finish("blocker");
+        QTRY_COMPARE(m_started.size(), 2);
+        QCOMPARE(m_started.last(), QString("refresh"));
+        QVERIFY(m_clients.value("refresh") != m_pool->interactive());
+
+        // No more at a time than there are background connections
+        QTest::qWait(50);
+        QCOMPARE(m_started.size(), 2);
+        finish("refresh");
+        QTRY_COMPARE(m_started.last(), QString("page"));
+
+        const CommandScheduler::Metrics metrics = scheduler()->metrics();
+        QCOMPARE(metrics.maxQueueDepth[CommandScheduler::BackgroundPrefetch], 1);
+        QCOMPARE(metrics.completed[CommandScheduler::VisibleRefresh], 1);
+    }
+
+    void mergedJobFinishesWithTheOther() {
+        QVERIFY(startBlocker());
+        scheduler()->submit(CommandScheduler::VisibleRefresh, "A", "sync:A", job("first"), merged());
+        scheduler()->submit(CommandScheduler::VisibleRefresh, "A", "sync:A", job("second"), merged());
+        QCOMPARE(scheduler()->queueDepth(), 1);
+        QCOMPARE(scheduler()->metrics().coalesced, 1);
+
+        finish("blocker");
+        QTRY_VERIFY(m_done.contains("first"));
+        QCOMPARE(m_merged, 0);
+        finish("first");
+        QCOMPARE(m_merged, 1);
+        QVERIFY(!m_started.contains("second"));
+    }
+
+    void mergeRaisesPriority() {
+        QVERIFY(startBlocker());
+        scheduler()->submit(CommandScheduler::BackgroundPrefetch, "A", QString(), job("page"));
+        scheduler()->submit(CommandScheduler::BackgroundPrefetch, "A", "threads:A", job("threads"));
+        scheduler()->submit(CommandScheduler::VisibleRefresh, "A", "threads:A", job("merged"));
+
+        finish("blocker");
+        QTRY_COMPARE(m_started.size(), 2);
+        QCOMPARE(m_started.last(), QString("threads"));
+    }
+
+    void mergeIntoInteractiveStartsAtOnce() {
+        QVERIFY(startBlocker());
+        scheduler()->submit(CommandScheduler::VisibleRefresh, "A", "sync:A", job("sync"));
+        scheduler()->submit(CommandScheduler::Interactive, "A", "sync:A", job("merged"), merged());
+        QCOMPARE(scheduler()->queueDepth(), 0);
+        QCOMPARE(m_started, QStringList({"blocker", "sync"}));
+        QCOMPARE(m_clients.value("sync"), m_pool->interactive());
+
+        finish("sync");
+        QCOMPARE(m_merged, 1);
+        QCOMPARE(scheduler()->metrics().completed[CommandScheduler::Interactive], 1);
+    }
+
+    void cancelAllReleasesWaitingJobs() {
+        QVERIFY(startBlocker());
+        scheduler()->submit(CommandScheduler::VisibleRefresh, "A", "sync:A", job("sync"));
+        scheduler()->submit(CommandScheduler::VisibleRefresh, "A", "sync:A", job("merged"), merged());
+        scheduler()->cancelAll();
+        QCOMPARE(scheduler()->queueDepth(), 0);
+        QVERIFY(m_started.contains("sync"));
+        QCOMPARE(m_clients.value("sync"), nullptr);
+        QCOMPARE(m_merged, 1);
+    }
+
+    void withoutConnection() {
+        delete m_pool;
+        m_pool = new ImapConnectionPool(this);
+        scheduler()->submit(CommandScheduler::Interactive, "A", QString(), job("move"));
+        scheduler()->submit(CommandScheduler::VisibleRefresh, "A", QString(), job("refresh"));
+        QCOMPARE(m_started, QStringList({"move", "refresh"}));
+        QCOMPARE(m_clients.value("move"), nullptr);
+        QCOMPARE(m_clients.value("refresh"), nullptr);
+        QCOMPARE(scheduler()->queueDepth(), 0);
+    }
+};
+
+QTEST_GUILESS_MAIN(CommandSchedulerTest)
+#include "command_scheduler_test.moc"
@@ -0,0 +1,243 @@
+// The row-level card signals of KanbanModel. The board comes from the card
+// cache and the server is unreachable, so every change is applied at once
+// (and journaled) without a server answer to wait for. Also what the cache
+// is written with while a sync is under way.
+
+#include "core/kanban_model.h"
+#include "core/card_cache.h"
+#include "fake_imap_server.h"
+#include <QDir>
+#include <QSemaphore>
+#include <QStandardPaths>
+#include <QTcpServer>
+#include <QThread>
+#include <QTimeZone>
+#include <QtTest>
+
+namespace {
+
+const int kTodoCards = 40;
+
+QDateTime day(int offset) {
+    return QDateTime(QDate(2024, 1, 1), QTime(12, 0), QTimeZone(0)).addDays(offset);
+}
+
+// UIDs as text, as the model takes them
+QStringList uids(int first, int last) {
+    QStringList uids;
+    for (int uid = first; uid <= last; ++uid) {
+        uids.append(QString::number(uid));
+    }
+    return uids;
+}
+
+// Answers on a thread of its own, so that a sync can finish while the
+// test's thread, where the model applies it, is busy
+class ServerThread : public QThread {
+public:
+    ~ServerThread() override {
+        quit();
+        wait();
+    }
+
+    quint16 port = 0;
+    QSemaphore listening;
+
+protected:
+    void run() override {
+        FakeImapServer server;
+        server.addMailbox("TODO", 5);
+        server.listen();
+        port = server.port();
+        listening.release();
+        exec();
+    }
+};
+
+} // namespace
+
+class KanbanModelTest : public QObject {
+    Q_OBJECT
+
+private:
+    // Newest first: TODO card n is on row kTodoCards - n
+    void seedCache() {
+        CardCache cache;
+        cache.setAccount("127.0.0.1", "user");
+        MailboxSyncState state;
+        state.uidValidity = 7;
+
+        QList<EmailCard> todo;
+        for (int uid = 1; uid <= kTodoCards; ++uid) {
+            todo.append(EmailCard(QString::number(uid), QString("Task %1").arg(uid), "sender@example.com", day(uid)));
+        }
+        QVERIFY(cache.store("TODO", todo, false, state));
+        const QList<EmailCard> done = {
+            EmailCard("100", "Newest", "sender@example.com", day(100)),
+            EmailCard("101", "Oldest", "sender@example.com", day(-10)),
+        };
+        QVERIFY(cache.store("DONE", done, false, state));
+    }
+
+    KanbanModel* createModel(quint16 port, const QStringList& visible) {
+        KanbanModel* model = new KanbanModel(this);
+        Settings& settings = model->settings();
+        settings.setImapServer("127.0.0.1");
+        settings.setImapPort(port);
+        settings.setUseSSL(false);
+        settings.setUsername("user");
+        settings.setPassword("pass");
+        settings.setCacheEnabled(true);
+        settings.setVisibleMailboxes(visible);
+        return model;
+    }
+
+    void record(const QString& event, const QString& mailbox, int first = -1, int last = -1, int to = -1) {
+        QString entry = event + " " + mailbox;
+        for (int row : {first, last, to}) {
+            if (row >= 0) {
+                entry += " " + QString::number(row);
+            }
+        }
+        m_events.append(entry);
+    }
+
+    QString m_configDir;
+    quint16 m_port = 0;
+    KanbanModel* m_model = nullptr;
+    QStringList m_events;
+
+private slots:
+    void initTestCase() {
+        QStandardPaths::setTestModeEnabled(true);
+        m_configDir = QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation) + "/IMAPKanban";
+    }
+
+    void init() {
+        QDir(m_configDir).removeRecursively();
+
+        // A port nothing listens on
+        QTcpServer closed;
+        QVERIFY(closed.listen(QHostAddress::LocalHost));
+        m_port = closed.serverPort();
+        closed.close();
+        seedCache();
+
+        m_model = createModel(m_port, {"TODO", "DONE"});
+        QVERIFY(m_model->connectToServer());
+        QCOMPARE(m_model->mailboxList("TODO").cardCount(), kTodoCards);
+        QVERIFY(!m_model->isConnected());
+
+        m_events.clear();
+        connect(m_model, &KanbanModel::cardsRemoved, this, [this](const QString& mailbox, int first, int last) {
+            record("removed", mailbox, first, last);
+        });
+        connect(m_model, &KanbanModel::cardsMoved, this,
+                [this](const QString& mailbox, int first, int last, int destination) {
+            record("moved", mailbox, first, last, destination);
+        });
+        connect(m_model, &KanbanModel::cardsInserted, this, [this](const QString& mailbox, int first, int last) {
+            record("inserted", mailbox, first, last);
+        });
+        connect(m_model, &KanbanModel::cardsChanged, this, [this](const QString& mailbox, int first, int last) {
+            record("changed", mailbox, first, last);
+        });
+        connect(m_model, &KanbanModel::mailboxReset, this, [this](const QString& mailbox) {
+            record("reset", mailbox);
+        });
+        connect(m_model, &KanbanModel::mailboxUpdated, this, [this](const QString& mailbox) {
+            record("updated", mailbox);
+        });
+    }
+
+    void cleanup() {
+        delete m_model;
+        m_model = nullptr;
+    }
+
+    void flagChangeIsOneRow() {
+        QVERIFY(m_model->markCardAsRead("38", "TODO"));
+        QCOMPARE(m_events, QStringList({"changed TODO 2 2", "updated TODO"}));
+        QVERIFY(m_model->card("38", "TODO").isRead());
+        QCOMPARE(m_model->mailboxList("TODO").row("38"), 2);
+    }
+
+    void unchangedCardEmitsNothing() {
+        QVERIFY(m_model->markCardAsFlagged("38", "TODO"));
+        m_events.clear();
+        QVERIFY(m_model->markCardAsFlagged("38", "TODO"));
+        QVERIFY(m_events.isEmpty());
+    }
+
+    void moveRemovesAndInserts() {
+        QVERIFY(m_model->moveCard("37", "TODO", "DONE"));
+        // Between the newest and the oldest DONE card, by date
+        QCOMPARE(m_events, QStringList({"removed TODO 3 3", "updated TODO", "inserted DONE 1 1", "updated DONE"}));
+        QCOMPARE(m_model->mailboxList("TODO").cardCount(), kTodoCards - 1);
+        QCOMPARE(m_model->mailboxList("DONE").cards().at(1).subject(), QString("Task 37"));
+    }
+
+    void deleteRemovesRow() {
+        QVERIFY(m_model->deleteCards({{"TODO", {"40", "1"}}}));
+        // Rows count from the state after the previous removal
+        QCOMPARE(m_events, QStringList({"removed TODO 0 0", "removed TODO 38 38", "updated TODO"}));
+    }
+
+    void largeBatchIsDiffedIntoRanges() {
+        // More cards than are reported one by one
+        QVERIFY(m_model->markCardsAsRead({{"TODO", uids(1, 33)}}));
+        QCOMPARE(m_events, QStringList({"changed TODO 7 39", "updated TODO"}));
+    }
+
+    void largeRemovalRunsFromTheEnd() {
+        QStringList removed = uids(1, kTodoCards);
+        removed.removeAll("40");
+        removed.removeAll("20");
+        QVERIFY(m_model->deleteCards({{"TODO", removed}}));
+        QCOMPARE(m_events, QStringList({"removed TODO 21 39", "removed TODO 1 19", "updated TODO"}));
+        QCOMPARE(m_model->mailboxList("TODO").cards().at(1).uid(), QString("20"));
+    }
+
+    void cacheKeepsStateOfAppliedChanges() {
+        delete m_model;
+        m_model = nullptr;
+        ServerThread server;
+        server.start();
+        server.listening.acquire();
+
+        // The cache knows one of the five cards, up to UID 1
+        CardCache cache;
+        cache.setAccount("127.0.0.1", "user");
+        MailboxSyncState cached;
+        cached.uidValidity = 1;
+        cached.uidNext = 2;
+        QVERIFY(cache.store("TODO", {EmailCard("1", "Cached", "sender@example.com", day(1))}, false, cached));
+
+        m_model = createModel(server.port, {"TODO"});
+        QSignalSpy connected(m_model, &KanbanModel::connected);
+        QVERIFY(m_model->connectToServer());
+        QCOMPARE(m_model->mailboxList("TODO").cardCount(), 1);
+        cache.invalidate("TODO");
+
+        // The first refresh has been sent; its result arrives while this
+        // thread is blocked, and the cache is written before it is applied
+        QTRY_COMPARE(connected.count(), 1);
+        QTest::qSleep(1000);
+        QCOMPARE(m_model->mailboxList("TODO").cardCount(), 1);
+        emit m_model->mailboxUpdated("TODO");
+        QVERIFY(QMetaObject::invokeMethod(m_model, "writeCache", Qt::DirectConnection));
+
+        MailboxList list;
+        MailboxSyncState state;
+        QTRY_VERIFY(cache.load("TODO", list, state));
+        QCOMPARE(list.cardCount(), 1);
+        QCOMPARE(state.uidNext, quint32(2));
+
+        QTRY_COMPARE(m_model->mailboxList("TODO").cardCount(), 5);
+        delete m_model;
+        m_model = nullptr;
+    }
+};
+
+QTEST_GUILESS_MAIN(KanbanModelTest)
+#include "kanban_model_test.moc"
@@ -0,0 +1,154 @@
+// Sequence numbers and UIDs in MessageSequence through EXISTS, EXPUNGE,
+// VANISHED and FETCH, including the rebuild once expunges pile up.
+
+#include "core/message_sequence.h"
+#include <QtTest>
+#include <vector>
+
+class MessageSequenceTest : public QObject {
+    Q_OBJECT
+
+private:
+    // Every lookup agrees with the mailbox as a plain list of UIDs
+    static bool matches(const MessageSequence& sequence, const std::vector<quint32>& uids) {
+        if (sequence.count() != uids.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < uids.size(); ++i) {
+            const quint32 msn = quint32(i + 1);
+            if (sequence.uid(msn) != uids[i] || sequence.msn(uids[i]) != msn) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private slots:
+    void lookups() {
+        MessageSequence sequence;
+        sequence.reset(4);
+        QVERIFY(!sequence.isComplete());
+        QCOMPARE(sequence.uid(1), quint32(0));
+        QVERIFY(sequence.setUnknownUids({40, 10, 30, 20}));
+        QVERIFY(sequence.isComplete());
+        QCOMPARE(sequence.knownUid(), quint32(40));
+        QVERIFY(matches(sequence, {10, 20, 30, 40}));
+        QCOMPARE(sequence.msn(25), quint32(0));
+        QCOMPARE(sequence.uid(5), quint32(0));
+        QCOMPARE(sequence.uid(0), quint32(0));
+    }
+
+    void expungeRenumbers() {
+        MessageSequence sequence;
+        sequence.reset(5);
+        QVERIFY(sequence.setUnknownUids({10, 20, 30, 40, 50}));
+
+        QCOMPARE(sequence.expunge(2), quint32(20));
+        QVERIFY(matches(sequence, {10, 30, 40, 50}));
+        QCOMPARE(sequence.msn(20), quint32(0));
+
+        // Each EXPUNGE counts from the state after the one before
+        QCOMPARE(sequence.expunge(4), quint32(50));
+        QCOMPARE(sequence.expunge(1), quint32(10));
+        QVERIFY(matches(sequence, {30, 40}));
+        QCOMPARE(sequence.expunge(3), quint32(0));
+    }
+
+    void vanishedByUid() {
+        MessageSequence sequence;
+        sequence.reset(3);
+        QVERIFY(sequence.setUnknownUids({7, 8, 9}));
+        QVERIFY(sequence.remove(8));
+        QVERIFY(!sequence.remove(8));
+        QVERIFY(!sequence.remove(100));
+        QVERIFY(matches(sequence, {7, 9}));
+    }
+
+    void newMessagesAndFetchedUids() {
+        MessageSequence sequence;
+        sequence.reset(2);
+        QVERIFY(sequence.setUnknownUids({3, 6}));
+        QVERIFY(sequence.setExists(4));
+        QVERIFY(!sequence.setExists(3));
+        QCOMPARE(sequence.count(), quint32(4));
+        QCOMPARE(sequence.knownUid(), quint32(6));
+
+        // UIDs must keep ascending with the sequence numbers
+        QVERIFY(!sequence.setUid(3, 5));
+        QVERIFY(sequence.setUid(3, 11));
+        QVERIFY(sequence.setUid(3, 11));
+        QVERIFY(!sequence.setUid(3, 12));
+        QCOMPARE(sequence.knownUid(), quint32(11));
+        QVERIFY(!sequence.isComplete());
+
+        QVERIFY(sequence.setUid(4, 15));
+        QVERIFY(matches(sequence, {3, 6, 11, 15}));
+    }
+
+    void expungeOfUnknownUid() {
+        MessageSequence sequence;
+        sequence.reset(3);
+        QVERIFY(sequence.setUid(1, 5));
+        QCOMPARE(sequence.expunge(2), quint32(0));
+        QCOMPARE(sequence.count(), quint32(2));
+        // UID SEARCH 6:* answers for the one message still unknown
+        QVERIFY(sequence.setUnknownUids({5, 9}));
+        QVERIFY(matches(sequence, {5, 9}));
+    }
+
+    void mismatchedSearchChangesNothing() {
+        MessageSequence sequence;
+        sequence.reset(3);
+        QVERIFY(sequence.setUid(1, 4));
+        QVERIFY(!sequence.setUnknownUids({8}));
+        QVERIFY(!sequence.setUnknownUids({8, 9, 10}));
+        QCOMPARE(sequence.knownUid(), quint32(4));
+        QCOMPARE(sequence.uid(2), quint32(0));
+        QVERIFY(sequence.setUnknownUids({8, 9}));
+        QVERIFY(matches(sequence, {4, 8, 9}));
+    }
+
+    void compactionKeepsLookups() {
+        // Enough expunges to drop the expunged slots several times over,
+        // mixed with new messages, checked against a plain list
+        MessageSequence sequence;
+        std::vector<quint32> uids;
+        quint32 nextUid = 1;
+        sequence.reset(0);
+        quint32 seed = 12345;
+        auto random = [&seed](quint32 bound) {
+            seed = seed * 1103515245 + 12345;
+            return (seed >> 16) % bound;
+        };
+
+        for (int round = 0; round < 40; ++round) {
+            const quint32 added = 50 + random(100);
+            QVERIFY(sequence.setExists(sequence.count() + added));
+            QList<quint32> fresh;
+            for (quint32 i = 0; i < added; ++i) {
+                fresh.append(nextUid);
+                uids.push_back(nextUid);
+                nextUid += 1 + random(3);
+            }
+            QVERIFY(sequence.setUnknownUids(fresh));
+
+            const quint32 expunged = random(quint32(uids.size()));
+            for (quint32 i = 0; i < expunged; ++i) {
+                if (random(2) == 0) {
+                    const quint32 msn = 1 + random(quint32(uids.size()));
+                    QCOMPARE(sequence.expunge(msn), uids[msn - 1]);
+                    uids.erase(uids.begin() + (msn - 1));
+                } else {
+                    const size_t index = random(quint32(uids.size()));
+                    QVERIFY(sequence.remove(uids[index]));
+                    uids.erase(uids.begin() + index);
+                }
+            }
+            QVERIFY(matches(sequence, uids));
+            QVERIFY(sequence.isComplete());
+        }
+    }
+};
+
+QTEST_GUILESS_MAIN(MessageSequenceTest)
+#include "message_sequence_test.moc"
@@ -0,0 +1,236 @@
+// OperationJournal: entries surviving a restart, and replay() reducing them
+// to the batches a reconnect sends.
+
+#include "core/operation_journal.h"
+#include "core/email_card.h"
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+class OperationJournalTest : public QObject {
+    Q_OBJECT
+
+private:
+    static JournalEntry entry(JournalEntry::Operation operation, const QString& mailbox, quint64 uid,
+                              const QString& target = QString(), quint64 targetUid = 0, bool value = false) {
+        JournalEntry entry;
+        entry.operation = operation;
+        entry.mailbox = mailbox;
+        entry.uid = uid;
+        entry.uidValidity = 7;
+        entry.target = target;
+        entry.targetUid = targetUid;
+        entry.value = value;
+        return entry;
+    }
+
+    static QList<quint64> ids(const OperationJournal& journal) {
+        QList<quint64> ids;
+        for (const JournalEntry& entry : journal.entries()) {
+            ids.append(entry.id);
+        }
+        return ids;
+    }
+
+    QTemporaryDir m_directory;
+
+private slots:
+    void init() {
+        // A fresh account per test, in the same directory
+        QDir(m_directory.path()).removeRecursively();
+        QDir().mkpath(m_directory.path());
+    }
+
+    void entriesSurviveRestart() {
+        OperationJournal journal(m_directory.path());
+        journal.setAccount("imap.example.com", "alice");
+        QVERIFY(journal.isEmpty());
+        QVERIFY(journal.append(entry(JournalEntry::MarkRead, "TODO", 5, QString(), 0, true)));
+        const quint64 placeholder = journal.placeholderKey();
+        QVERIFY(journal.append(entry(JournalEntry::Move, "TODO", 6, "DONE", placeholder)));
+
+        OperationJournal restarted(m_directory.path());
+        restarted.setAccount("imap.example.com", "alice");
+        QCOMPARE(restarted.size(), 2);
+        const JournalEntry move = restarted.entries().at(1);
+        QCOMPARE(move.operation, JournalEntry::Move);
+        QCOMPARE(move.mailbox, QString("TODO"));
+        QCOMPARE(move.uid, quint64(6));
+        QCOMPARE(move.uidValidity, quint32(7));
+        QCOMPARE(move.target, QString("DONE"));
+        QCOMPARE(move.targetUid, placeholder);
+        QVERIFY(restarted.entries().at(0).value);
+
+        // Neither ids nor placeholders are handed out twice
+        QVERIFY(restarted.placeholderKey() != placeholder);
+        QVERIFY(restarted.append(entry(JournalEntry::Delete, "DONE", 9)));
+        QVERIFY(restarted.entries().at(2).id > move.id);
+
+        OperationJournal other(m_directory.path());
+        other.setAccount("imap.example.com", "bob");
+        QVERIFY(other.isEmpty());
+    }
+
+    void removeSettledEntries() {
+        OperationJournal journal(m_directory.path());
+        journal.setAccount("imap.example.com", "alice");
+        QVERIFY(journal.append(entry(JournalEntry::Delete, "TODO", 1)));
+        QVERIFY(journal.append(entry(JournalEntry::Delete, "TODO", 2)));
+        QVERIFY(journal.remove({ids(journal).first()}));
+        QCOMPARE(journal.size(), 1);
+        QCOMPARE(journal.entries().first().uid, quint64(2));
+
+        QVERIFY(journal.remove(ids(journal)));
+        OperationJournal restarted(m_directory.path());
+        restarted.setAccount("imap.example.com", "alice");
+        QVERIFY(restarted.isEmpty());
+    }
+
+    void unreadableJournalIsDiscarded() {
+        {
+            OperationJournal journal(m_directory.path());
+            journal.setAccount("imap.example.com", "alice");
+            QVERIFY(journal.append(entry(JournalEntry::Delete, "TODO", 1)));
+        }
+        const QStringList files = QDir(m_directory.path()).entryList(QDir::Files);
+        QCOMPARE(files.size(), 1);
+        QFile file(m_directory.path() + "/" + files.first());
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        file.write("not a journal");
+        file.close();
+
+        OperationJournal journal(m_directory.path());
+        journal.setAccount("imap.example.com", "alice");
+        QVERIFY(journal.isEmpty());
+    }
+
+    void placeholdersAreOutsideTheUidRange() {
+        OperationJournal journal(m_directory.path());
+        const quint64 first = journal.placeholderKey();
+        const quint64 second = journal.placeholderKey();
+        QVERIFY(first != second);
+        QVERIFY(first > 0xffffffffu);
+        QVERIFY(EmailCard::isPlaceholderKey(first));
+        QVERIFY(!EmailCard::isPlaceholderKey(0xffffffffu));
+    }
+
+    void movesCollapse() {
+        OperationJournal journal(m_directory.path());
+        journal.setAccount("imap.example.com", "alice");
+        const quint64 doing = journal.placeholderKey();
+        const quint64 done = journal.placeholderKey();
+        QVERIFY(journal.append(entry(JournalEntry::Move, "TODO", 5, "DOING", doing)));
+        QVERIFY(journal.append(entry(JournalEntry::Move, "DOING", doing, "DONE", done)));
+
+        const JournalReplay replay = journal.replay();
+        QCOMPARE(replay.batches.size(), 1);
+        const JournalBatch& batch = replay.batches.first();
+        QCOMPARE(batch.operation, JournalEntry::Move);
+        QCOMPARE(batch.mailbox, QString("TODO"));
+        QCOMPARE(batch.target, QString("DONE"));
+        QCOMPARE(batch.uidValidity, quint32(7));
+        QCOMPARE(batch.uids, QList<quint32>({5}));
+        QCOMPARE(batch.targetUids, QList<quint64>({done}));
+        QCOMPARE(batch.entries, ids(journal));
+        QVERIFY(replay.cancelled.isEmpty());
+        QVERIFY(replay.resyncMailboxes.isEmpty());
+    }
+
+    void moveBackCancels() {
+        OperationJournal journal(m_directory.path());
+        journal.setAccount("imap.example.com", "alice");
+        const quint64 doing = journal.placeholderKey();
+        const quint64 back = journal.placeholderKey();
+        QVERIFY(journal.append(entry(JournalEntry::Move, "TODO", 5, "DOING", doing)));
+        QVERIFY(journal.append(entry(JournalEntry::Move, "DOING", doing, "TODO", back)));
+
+        const JournalReplay replay = journal.replay();
+        QVERIFY(replay.batches.isEmpty());
+        QCOMPARE(replay.cancelled, ids(journal));
+        // The board shows the card under a placeholder until it reads TODO again
+        QCOMPARE(replay.resyncMailboxes, QSet<QString>({"TODO"}));
+    }
+
+    void lastFlagChangeWinsAndGoesFirst() {
+        OperationJournal journal(m_directory.path());
+        journal.setAccount("imap.example.com", "alice");
+        const quint64 done = journal.placeholderKey();
+        QVERIFY(journal.append(entry(JournalEntry::MarkRead, "TODO", 5, QString(), 0, true)));
+        QVERIFY(journal.append(entry(JournalEntry::Move, "TODO", 5, "DONE", done)));
+        QVERIFY(journal.append(entry(JournalEntry::MarkRead, "DONE", done, QString(), 0, false)));
+        QVERIFY(journal.append(entry(JournalEntry::MarkFlagged, "DONE", done, QString(), 0, true)));
+
+        const JournalReplay replay = journal.replay();
+        QCOMPARE(replay.batches.size(), 3);
+        // Set on the message before it moves, where its UID is known
+        QCOMPARE(replay.batches.at(0).operation, JournalEntry::MarkRead);
+        QCOMPARE(replay.batches.at(0).mailbox, QString("TODO"));
+        QVERIFY(!replay.batches.at(0).value);
+        QCOMPARE(replay.batches.at(1).operation, JournalEntry::MarkFlagged);
+        QVERIFY(replay.batches.at(1).value);
+        QCOMPARE(replay.batches.at(2).operation, JournalEntry::Move);
+        QCOMPARE(replay.batches.at(2).uids, QList<quint32>({5}));
+        // Every entry is settled with the last batch of its card
+        QCOMPARE(replay.batches.at(2).entries, ids(journal));
+        QVERIFY(replay.batches.at(0).entries.isEmpty());
+    }
+
+    void deleteTakesEverythingBefore() {
+        OperationJournal journal(m_directory.path());
+        journal.setAccount("imap.example.com", "alice");
+        const quint64 done = journal.placeholderKey();
+        QVERIFY(journal.append(entry(JournalEntry::MarkFlagged, "TODO", 5, QString(), 0, true)));
+        QVERIFY(journal.append(entry(JournalEntry::Move, "TODO", 5, "DONE", done)));
+        QVERIFY(journal.append(entry(JournalEntry::Delete, "DONE", done)));
+
+        const JournalReplay replay = journal.replay();
+        QCOMPARE(replay.batches.size(), 1);
+        QCOMPARE(replay.batches.first().operation, JournalEntry::Delete);
+        QCOMPARE(replay.batches.first().mailbox, QString("TODO"));
+        QCOMPARE(replay.batches.first().uids, QList<quint32>({5}));
+        QCOMPARE(replay.batches.first().entries, ids(journal));
+    }
+
+    void cardsShareBatches() {
+        OperationJournal journal(m_directory.path());
+        journal.setAccount("imap.example.com", "alice");
+        QVERIFY(journal.append(entry(JournalEntry::Delete, "TODO", 3)));
+        QVERIFY(journal.append(entry(JournalEntry::MarkRead, "TODO", 8, QString(), 0, true)));
+        QVERIFY(journal.append(entry(JournalEntry::Delete, "TODO", 4)));
+        QVERIFY(journal.append(entry(JournalEntry::MarkRead, "TODO", 9, QString(), 0, true)));
+        QVERIFY(journal.append(entry(JournalEntry::MarkRead, "TODO", 10, QString(), 0, false)));
+        JournalEntry otherValidity = entry(JournalEntry::Delete, "TODO", 12);
+        otherValidity.uidValidity = 8;
+        QVERIFY(journal.append(otherValidity));
+
+        const JournalReplay replay = journal.replay();
+        QCOMPARE(replay.batches.size(), 4);
+        QCOMPARE(replay.batches.at(0).operation, JournalEntry::MarkRead);
+        QVERIFY(replay.batches.at(0).value);
+        QCOMPARE(replay.batches.at(0).uids, QList<quint32>({8, 9}));
+        QCOMPARE(replay.batches.at(1).operation, JournalEntry::MarkRead);
+        QCOMPARE(replay.batches.at(1).uids, QList<quint32>({10}));
+        QCOMPARE(replay.batches.at(2).operation, JournalEntry::Delete);
+        QCOMPARE(replay.batches.at(2).uids, QList<quint32>({3, 4}));
+        // The same UID under another UIDVALIDITY is another message
+        QCOMPARE(replay.batches.at(3).uidValidity, quint32(8));
+        QCOMPARE(replay.batches.at(3).uids, QList<quint32>({12}));
+    }
+
+    void unsettledPlaceholderNeedsResync() {
+        OperationJournal journal(m_directory.path());
+        journal.setAccount("imap.example.com", "alice");
+        // A card still shown under the placeholder of a move the server made
+        QVERIFY(journal.append(entry(JournalEntry::MarkRead, "DONE", EmailCard::placeholderKey(40),
+                                     QString(), 0, true)));
+
+        const JournalReplay replay = journal.replay();
+        QVERIFY(replay.batches.isEmpty());
+        QCOMPARE(replay.cancelled, ids(journal));
+        QCOMPARE(replay.resyncMailboxes, QSet<QString>({"DONE"}));
+    }
+};
+
+QTEST_GUILESS_MAIN(OperationJournalTest)
+#include "operation_journal_test.moc"
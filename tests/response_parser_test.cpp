@@ -0,0 +1,134 @@
+// Framing and tokenizing of server responses by ImapResponseParser, in
+// particular {n} literals arriving in pieces.
+
+#include "core/imap_response_parser.h"
+#include <QtTest>
+
+class ResponseParserTest : public QObject {
+    Q_OBJECT
+
+private:
+    // Feeds the chunks one by one and collects every response completed
+    static QList<ImapResponse> parse(const QList<QByteArray>& chunks) {
+        ImapResponseParser parser;
+        QList<ImapResponse> responses;
+        for (const QByteArray& chunk : chunks) {
+            parser.feed(chunk);
+            ImapResponse response;
+            while (parser.next(response)) {
+                responses.append(response);
+            }
+        }
+        return responses;
+    }
+
+private slots:
+    void statusResponses() {
+        const QList<ImapResponse> responses = parse({"* OK [UIDVALIDITY 3857529045] UIDs valid\r\n"
+                                                     "A1 NO [ALERT] Mailbox is full\r\n"});
+        QCOMPARE(responses.size(), 2);
+
+        QCOMPARE(responses.at(0).kind, ImapResponse::Untagged);
+        QCOMPARE(responses.at(0).name, QByteArray("OK"));
+        QCOMPARE(responses.at(0).code, QByteArray("UIDVALIDITY"));
+        QCOMPARE(responses.at(0).codeArgs.at(0).toNumber(), quint64(3857529045));
+        QCOMPARE(responses.at(0).text, QByteArray("UIDs valid"));
+
+        QCOMPARE(responses.at(1).kind, ImapResponse::Tagged);
+        QCOMPARE(responses.at(1).tag, QByteArray("A1"));
+        QVERIFY(!responses.at(1).isOk());
+        QCOMPARE(responses.at(1).code, QByteArray("ALERT"));
+    }
+
+    void continuation() {
+        const QList<ImapResponse> responses = parse({"+ idling\r\n"});
+        QCOMPARE(responses.size(), 1);
+        QCOMPARE(responses.at(0).kind, ImapResponse::Continuation);
+        QCOMPARE(responses.at(0).text, QByteArray("idling"));
+    }
+
+    void fetchWithLiteral() {
+        const QList<ImapResponse> responses = parse({"* 12 FETCH (UID 34 FLAGS (\\Seen) BODY[] {5}\r\n"
+                                                     "hello)\r\n"});
+        QCOMPARE(responses.size(), 1);
+        QCOMPARE(responses.at(0).number, qint64(12));
+        QCOMPARE(responses.at(0).name, QByteArray("FETCH"));
+
+        const ImapValue& data = responses.at(0).fields.at(0);
+        QCOMPARE(data.value("UID").toNumber(), quint64(34));
+        QCOMPARE(data.value("FLAGS").at(0).data(), QByteArray("\\Seen"));
+        QVERIFY(data.value("BODY[]").isString());
+        QCOMPARE(data.value("BODY[]").data(), QByteArray("hello"));
+    }
+
+    void nonSynchronizingAndEmptyLiterals() {
+        const QList<ImapResponse> responses = parse({"* 1 FETCH (BODY[] {3+}\r\nabc)\r\n"
+                                                     "* 2 FETCH (BODY[] {0}\r\n NIL)\r\n"});
+        QCOMPARE(responses.size(), 2);
+        QCOMPARE(responses.at(0).fields.at(0).value("BODY[]").data(), QByteArray("abc"));
+        QVERIFY(responses.at(1).fields.at(0).value("BODY[]").isString());
+        QVERIFY(responses.at(1).fields.at(0).value("BODY[]").data().isEmpty());
+    }
+
+    void literalContentIsNotFramed() {
+        // CRLF and a "{3}" at the end of a line inside the literal belong to it
+        const QList<ImapResponse> responses = parse({"* 1 FETCH (BODY[] {7}\r\nx {3}\r\n)\r\n",
+                                                     "A2 OK done\r\n"});
+        QCOMPARE(responses.size(), 2);
+        QCOMPARE(responses.at(0).fields.at(0).value("BODY[]").data(), QByteArray("x {3}\r\n"));
+        QCOMPARE(responses.at(1).tag, QByteArray("A2"));
+    }
+
+    void literalLengthAfterLiteral() {
+        // The line after a literal must not take the literal's last bytes
+        // as the start of a "{12}" announcement
+        const QList<ImapResponse> responses = parse({"* 1 FETCH (BODY[] {2}\r\n", "{1", "2}\r\n",
+                                                     "A1 OK done\r\n"});
+        QCOMPARE(responses.size(), 2);
+        QCOMPARE(responses.at(0).fields.at(0).value("BODY[]").data(), QByteArray("{1"));
+        QCOMPARE(responses.at(1).tag, QByteArray("A1"));
+    }
+
+    void byteByByte() {
+        const QByteArray stream = "* 3 EXISTS\r\n"
+                                  "* 1 FETCH (UID 7 BODY[HEADER] {12}\r\nSubject: x\r\n)\r\n"
+                                  "A3 OK FETCH completed\r\n";
+        QList<QByteArray> chunks;
+        for (char c : stream) {
+            chunks.append(QByteArray(1, c));
+        }
+        const QList<ImapResponse> responses = parse(chunks);
+        QCOMPARE(responses.size(), 3);
+        QCOMPARE(responses.at(0).name, QByteArray("EXISTS"));
+        QCOMPARE(responses.at(0).number, qint64(3));
+        QCOMPARE(responses.at(1).fields.at(0).value("BODY[HEADER]").data(), QByteArray("Subject: x\r\n"));
+        QCOMPARE(responses.at(2).text, QByteArray("FETCH completed"));
+    }
+
+    void incompleteLiteralWaits() {
+        ImapResponseParser parser;
+        ImapResponse response;
+        parser.feed("* 1 FETCH (BODY[] {10}\r\n01234");
+        QVERIFY(!parser.next(response));
+        parser.feed("56789)\r\n");
+        QVERIFY(parser.next(response));
+        QCOMPARE(response.fields.at(0).value("BODY[]").data(), QByteArray("0123456789"));
+        QVERIFY(!parser.next(response));
+        QCOMPARE(parser.bufferedBytes(), qint64(0));
+    }
+
+    void clearDropsPartialResponse() {
+        ImapResponseParser parser;
+        ImapResponse response;
+        parser.feed("* 1 FETCH (BODY[] {100}\r\npartial");
+        QVERIFY(!parser.next(response));
+        parser.clear();
+        QCOMPARE(parser.bufferedBytes(), qint64(0));
+        parser.feed("A4 OK NOOP completed\r\n");
+        QVERIFY(parser.next(response));
+        QCOMPARE(response.tag, QByteArray("A4"));
+    }
+};
+
+QTEST_GUILESS_MAIN(ResponseParserTest)
+#include "response_parser_test.moc"
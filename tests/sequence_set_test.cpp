@@ -0,0 +1,62 @@
+// Parsing and formatting of IMAP sequence sets by SequenceSet.
+
+#include "core/sequence_set.h"
+#include <QtTest>
+
+class SequenceSetTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void parseNumbersAndRanges() {
+        bool ok = false;
+        QCOMPARE(SequenceSet::parse("1:4,7,10:12", &ok), QList<quint32>({1, 2, 3, 4, 7, 10, 11, 12}));
+        QVERIFY(ok);
+    }
+
+    void parseKeepsOrderAndReversedRanges() {
+        QCOMPARE(SequenceSet::parse("9,3:1,5"), QList<quint32>({9, 1, 2, 3, 5}));
+    }
+
+    void parseSkipsInvalidParts() {
+        bool ok = false;
+        QCOMPARE(SequenceSet::parse("0,2,*,4:*,x,6", &ok), QList<quint32>({2, 6}));
+        QVERIFY(ok);
+        QVERIFY(SequenceSet::parse("").isEmpty());
+    }
+
+    void parseLargestUid() {
+        QCOMPARE(SequenceSet::parse("4294967294:4294967295"), QList<quint32>({4294967294u, 4294967295u}));
+    }
+
+    void parseRefusesHugeSets() {
+        bool ok = true;
+        QVERIFY(SequenceSet::parse("1:4294967295", &ok).isEmpty());
+        QVERIFY(!ok);
+
+        // The limit counts every part
+        const QByteArray limit = "1:" + QByteArray::number(SequenceSet::kMaxNumbers);
+        QCOMPARE(SequenceSet::parse(limit, &ok).size(), SequenceSet::kMaxNumbers);
+        QVERIFY(ok);
+        QVERIFY(SequenceSet::parse(limit + ",5000000", &ok).isEmpty());
+        QVERIFY(!ok);
+    }
+
+    void formatFoldsRuns() {
+        QCOMPARE(SequenceSet::format({1, 2, 3, 4, 7, 10, 11, 12}), QByteArray("1:4,7,10:12"));
+        QCOMPARE(SequenceSet::format({5}), QByteArray("5"));
+        QCOMPARE(SequenceSet::format({}), QByteArray());
+    }
+
+    void formatSortsAndDropsDuplicatesAndZeroes() {
+        QCOMPARE(SequenceSet::format({12, 0, 3, 11, 3, 2, 10}), QByteArray("2:3,10:12"));
+        QCOMPARE(SequenceSet::format({4294967295u, 4294967294u}), QByteArray("4294967294:4294967295"));
+    }
+
+    void roundTrip() {
+        const QByteArray set = "3,5:9,20,22:23";
+        QCOMPARE(SequenceSet::format(SequenceSet::parse(set)), set);
+    }
+};
+
+QTEST_GUILESS_MAIN(SequenceSetTest)
+#include "sequence_set_test.moc"